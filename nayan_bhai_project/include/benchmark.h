@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Asks loop() to run the benchmark battery. Safe to call from any task; it is
+ * only honoured while the sequence has not been started.
+ */
+void benchmark_request();
+
+/**
+ * Returns true once per benchmark_request().
+ */
+bool benchmark_take_request();
+
+/**
+ * Records when the pause key was seen, for the pause latency measurement.
+ * Called from the keypad callback.
+ */
+void benchmark_mark_pause();
+
+/**
+ * Runs the battery on the real hardware and prints a `# bench v1` report to out:
+ * sustained step rate per axis and for all axes together, stepper_service()
+ * loop period and jitter idle and while stepping, timed DC run end error, and
+ * pause key to output latency (the operator presses B when asked). Moves every
+ * axis back and forth around its current position. Runs on the loop() task.
+ */
+void benchmark_run(Print &out);
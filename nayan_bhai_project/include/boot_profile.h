@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Records that a boot phase finished. phase must be a string literal. Safe to
+ * call from several tasks at once; marks beyond BOOT_PROFILE_MAX_MARKS are dropped.
+ */
+void boot_mark(const char *phase);
+
+/**
+ * Prints every mark with its esp_timer time and the time since the previous
+ * mark, plus the reset reason. The first mark's time covers ROM, bootloader
+ * and startup code.
+ */
+void boot_report(Print &out);
@@ -31,11 +31,16 @@ enum class ButtonId : uint8_t {
 enum class ButtonState : uint8_t {
   PRESSED,
   RELEASED,
+  HOLD,        // still down after KEY_HOLD_MS
+  LONG_PRESS,  // still down after KEY_LONG_PRESS_MS
+  CHORD,       // `other` pressed while `button` was down
 };
 
 struct ButtonEvent {
   ButtonId  button;
   ButtonState state;
+  ButtonId  other;    // CHORD only, UNKNOWN otherwise
+  uint32_t  time_ms;  // millis() at the scan that saw it
 };
 
 /**
@@ -44,10 +49,47 @@ struct ButtonEvent {
  */
 const char* button_name(ButtonId id);
 
+/**
+ * Returns a human-readable name for a button state (e.g. "PRESSED").
+ */
+const char* button_state_name(ButtonState state);
+
+/**
+ * Returns true for a CHORD of buttons a and b, pressed in either order.
+ */
+bool button_is_chord(const ButtonEvent& event, ButtonId a, ButtonId b);
+
 using ButtonEventCallback = void (*)(ButtonEvent event);
 
+// The scan task publishes events into a ring of BUTTON_EVENT_RING entries that
+// every reader consumes at its own pace; publishing takes no lock and never
+// waits on a reader, so scan timing does not depend on what readers do. A
+// reader that falls a full ring behind loses the oldest events.
+
+/**
+ * Initializes the 4x4 keypad and starts the background scan task.
+ */
+void button_matrix_init();
+
+/**
+ * Opens a reader positioned at the next event. Returns its id, or -1 when all
+ * BUTTON_MAX_READERS are taken. Readers cannot be closed.
+ */
+int8_t button_open_reader();
+
+/**
+ * Takes the reader's next event without waiting. Returns false when there is none.
+ */
+bool button_read(int8_t reader, ButtonEvent& event);
+
+/**
+ * Returns how many events the reader lost to falling behind since the previous
+ * call, and restarts the count.
+ */
+uint32_t button_take_lost(int8_t reader);
+
 /**
- * Initializes the 4x4 keypad and starts a background polling task.
- * Fires callback with ButtonEvent on every press and release.
+ * Opens a reader served by its own task on core 0 at priority, which calls
+ * callback for every event. Returns false when no reader or task is available.
  */
-void button_matrix_init(ButtonEventCallback callback);
+bool button_subscribe(ButtonEventCallback callback, const char* name, UBaseType_t priority);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Starts a low-priority task on core 0 that reads newline-terminated commands
+ * from Serial and answers on Serial. Type `help` for the command list.
+ */
+void console_init();
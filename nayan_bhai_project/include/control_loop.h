@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Arduino.h>
+
+struct ControlLoopStats {
+	uint32_t rate_hz;
+	uint32_t ticks;          // since start
+	uint32_t overruns;       // since start: ticks missed or whose work took longer than one period
+	uint32_t max_jitter_us;  // largest |wake-to-wake period - nominal period| since the last take
+	uint32_t max_work_us;    // longest tick since the last take
+};
+
+/**
+ * Starts (or retimes) the control loop: a hardware timer interrupt wakes a
+ * high-priority task on core 0 at rate_hz, which ends and pauses timed DC runs
+ * (dc_service()), runs the DC speed loop at DC_SPEED_LOOP_HZ and keeps the
+ * motion snapshot fresh while loop() is not servicing the steppers.
+ * rate_hz must lie within CONTROL_LOOP_MIN/MAX_RATE_HZ and be a multiple of
+ * DC_SPEED_LOOP_HZ; returns false otherwise or if the timer is unavailable.
+ */
+bool control_loop_start(uint32_t rate_hz);
+
+/**
+ * Returns the loop statistics and restarts the max_* measurements.
+ */
+ControlLoopStats control_loop_take_stats();
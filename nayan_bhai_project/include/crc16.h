@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF). Used to frame binary streams
+ * shared with the host tools, so it must stay dependency-free.
+ */
+inline uint16_t crc16_ccitt(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF) {
+  for (size_t i = 0; i < length; ++i) {
+    crc ^= static_cast<uint16_t>(data[i]) << 8;
+    for (uint8_t bit = 0; bit < 8; ++bit) {
+      crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+// Load current supervision for one DC motor from its driver's current-sense
+// output. Pure logic with no Arduino includes so it can be exercised on the
+// host with simulated current traces.
+//
+// Overcurrent trips on a single block average above the limit, to spare the
+// driver; a jam needs the filtered current above the jam limit for jam_ms, so
+// start-up inrush and short load peaks pass.
+
+struct CurrentMonitorConfig {
+	float filter_hz;         // corner of the first-order low-pass on the block averages
+	float overcurrent_ma;    // trips at once, 0 = off
+	float jam_ma;            // trips after jam_ms, 0 = off
+	uint32_t jam_ms;
+	uint32_t inrush_ms;      // after a run starts, no jam check
+};
+
+enum class CurrentFault : uint8_t {
+	NONE = 0,
+	OVERCURRENT = 1,
+	JAM = 2,
+};
+
+struct CurrentMonitor {
+	CurrentMonitorConfig config;
+	float current_ma;        // filtered
+	float peak_ma;           // highest block average since the run started
+	uint32_t run_us;         // time since the run started
+	uint32_t jam_us;         // time the filtered current has been over jam_ma
+	bool running;
+	CurrentFault fault;      // latched until the next run starts
+};
+
+void current_monitor_init(CurrentMonitor &monitor, const CurrentMonitorConfig &config);
+
+/**
+ * Starts supervising a run: clears the peak, the inrush timer and a latched fault.
+ */
+void current_monitor_start(CurrentMonitor &monitor);
+
+/**
+ * Ends supervision; the filter keeps following the current as it decays.
+ */
+void current_monitor_stop(CurrentMonitor &monitor);
+
+/**
+ * Feeds the average current of one block of samples taken over dt_us and
+ * returns the fault it raised, once; NONE otherwise, also while a fault is latched.
+ */
+CurrentFault current_monitor_update(CurrentMonitor &monitor, float block_ma, uint32_t dt_us);
+
+const char *current_fault_name(CurrentFault fault);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include "current_monitor.h"
+#include "dc_motor.h"
+
+// Continuous load current measurement of the DC motors with a PIN_*_IS pin.
+// ADC1 converts the IS pins round-robin at DC_CURRENT_SAMPLE_HZ into DMA
+// blocks; a task on core 0 averages each block per motor, which also averages
+// out the PWM ripple, and runs a CurrentMonitor per motor (see current_monitor.h).
+// A fault stops the motor within a block or two and raises an event.
+
+struct DcCurrentEvent {
+	DcMotorId motor;
+	CurrentFault fault;
+	float current_ma;        // filtered, when the fault was raised
+	float peak_ma;           // block average that tripped an overcurrent, or the run's peak
+};
+
+using DcCurrentCallback = void (*)(const DcCurrentEvent &event);
+
+struct DcCurrent {
+	bool sensed;             // the motor has an IS pin and sampling runs
+	float current_ma;        // filtered
+	float peak_ma;           // since the motor's run started
+	CurrentFault fault;      // latched until the motor's next run
+};
+
+/**
+ * Starts sampling the assigned IS pins. Returns false if none is assigned, a
+ * pin is not on ADC1, or the ADC is unavailable; motors then run unsupervised.
+ */
+bool current_sense_init();
+
+/**
+ * Registers a callback for faults. It runs on the sampling task after the motor
+ * has been stopped (coasting); keep it short.
+ */
+void current_sense_set_callback(DcCurrentCallback callback);
+
+/**
+ * Replaces a motor's DC_*_OVERCURRENT_MA / DC_*_JAM_MA / DC_JAM_MS limits; 0 turns a check off.
+ */
+void current_sense_set_limits(DcMotorId motor, float overcurrent_ma, float jam_ma, uint32_t jam_ms);
+
+DcCurrent current_sense_read(DcMotorId motor);
+
+/**
+ * Prints the current, peak, fault and limits of every motor.
+ */
+void current_sense_report(Print &out);
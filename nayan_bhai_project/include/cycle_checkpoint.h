@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include "defines.h"
+
+// Progress through the loop() sequence, kept across resets so a cycle can
+// resume where it stopped. Each save goes to RTC slow memory, a plain memory
+// write that survives software, panic, watchdog and (when the RTC domain stays
+// up) brownout resets. Once per cycle the latest one is copied to NVS, which
+// also survives power loss; after one, the cycle restarts from its start.
+// While a task runs, the stepper positions are mirrored into RTC memory as
+// well, so after a reset that kept it the axes' positions are known to within
+// one motion snapshot.
+//
+// Flash wear: a record takes 4 NVS entries (blob index, data header, 2 data).
+// The default 20 KB partition rotates through 4 pages of 126 entries, so each
+// sector is erased once per ~126 cycles and reaches its 100k erase cycles
+// after ~12M cycles, over a year of 3 s cycles. Saving at every task boundary
+// would take 11 records a cycle and wear it out 11 times as fast.
+
+struct CycleCheckpoint {
+	uint32_t cycle;                          // cycles completed since a cold start
+	uint8_t task;                            // task about to run, 0 = Task1
+	int32_t position[STEPPER_MOTOR_COUNT];   // stepper positions as the task starts
+	SolenoidState solenoid;
+};
+
+enum class CheckpointSource : uint8_t {
+	NONE = 0,
+	RTC = 1,
+	NVS = 2,
+};
+
+/**
+ * Loads the newest checkpoint that passes its CRC, from RTC memory or else from
+ * NVS. Returns where it came from, NONE if there is none.
+ */
+CheckpointSource cycle_checkpoint_load(CycleCheckpoint &checkpoint);
+
+/**
+ * Returns the stepper positions mirrored while the loaded checkpoint's task ran.
+ * False after a power loss or if the mirror does not belong to that checkpoint.
+ */
+bool cycle_checkpoint_live_positions(int32_t position[STEPPER_MOTOR_COUNT]);
+
+/**
+ * Records a task boundary in RTC memory and starts mirroring positions against
+ * it. A checkpoint equal to the last one is not written again.
+ */
+void cycle_checkpoint_save(const CycleCheckpoint &checkpoint);
+
+/**
+ * Copies the last saved checkpoint to NVS unless it is there already. Call it
+ * once per cycle, with the actuators at rest: the commit stalls flash access on
+ * both cores for a few milliseconds.
+ */
+void cycle_checkpoint_persist();
+
+/**
+ * Drops both copies, e.g. when the operator starts cold.
+ */
+void cycle_checkpoint_clear();
+
+/**
+ * Mirrors live stepper positions into RTC memory. The motion snapshot calls it
+ * on every publish; it does nothing until the first save.
+ */
+void cycle_checkpoint_track(const int32_t position[STEPPER_MOTOR_COUNT]);
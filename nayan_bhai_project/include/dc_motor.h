@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include "current_monitor.h"
 #include "defines.h"
 
 enum class DcMotorId : uint8_t {
@@ -14,18 +15,49 @@ struct DcTimedMove {
 	uint32_t time_ms;
 	uint8_t speed;
 	Direction direction;
+	DcStopMode stop_mode;  // how the run ends; DEFAULT (zero-initialized) = the motor's mode
 };
 
+struct DcStatus {
+	bool running;
+	bool enabled;      // driver EN pin level (shared by the two 300 RPM motors)
+	uint8_t duty;      // applied PWM duty, 0 when stopped
+	Direction direction;
+	bool braking;      // stopped with both low sides on
+	float current_ma;  // filtered load current, 0 without current sense (see current_sense.h)
+	float peak_ma;     // highest since the run started
+	CurrentFault fault;  // what stopped the last run early, latched until the next run
+};
+
+struct DcThermal {
+	float load;          // modelled temperature rise, 1.0 = continuous rating
+	uint8_t duty_limit;  // highest duty on the outputs at this load
+};
+
+/**
+ * Drives the EN and PWM pins low as plain GPIOs. Cheap and safe to call before
+ * dc_motor_init(), e.g. right after reset.
+ */
+void dc_motor_safe_state();
+
 /**
  * Initializes both DC motor groups.
  */
 void dc_motor_init();
 
 /**
- * Services timed DC commands. Call this frequently from loop().
+ * Services timed DC commands: ends runs at their deadline and holds them while
+ * g_paused is set. The control loop calls it every tick; the blocking functions
+ * also call it while they wait.
  */
 void dc_service();
 
+/**
+ * Runs one closed-loop speed update for every encoder-equipped motor.
+ * Called by the control loop at DC_SPEED_LOOP_HZ.
+ */
+void dc_closed_loop_service();
+
 /**
  * 3000 RPM group control (non-blocking).
  */
@@ -47,12 +79,109 @@ void dc2_300_run_ms(uint32_t time_ms, uint8_t speed, Direction direction);
 void dc2_300_run_ms_blocking(uint32_t time_ms, uint8_t speed, Direction direction);
 void dc2_300_stop();
 
+/**
+ * Starts one timed DC run (non-blocking). The control loop ends it on time.
+ */
+void dc_run_ms(const DcTimedMove &move);
+
 /**
  * Starts multiple timed DC runs together and blocks until all are complete.
  */
 void dc_run_ms_batch_blocking(const DcTimedMove *moves, uint8_t move_count);
 
 /**
- * Stops both DC motor groups.
+ * Stops both DC motor groups, each in its configured stop mode.
  */
 void dc_stop_all();
+
+/**
+ * Stops one motor in mode (DEFAULT = its configured mode).
+ */
+void dc_stop(DcMotorId motor, DcStopMode mode);
+
+/**
+ * Sets how a motor stops when a run ends or it is stopped with DcStopMode::DEFAULT.
+ * Starts as DC_3000_STOP_MODE / DC_300_STOP_MODE. The two 300 RPM motors share
+ * one EN pin, so one of them can only coast while the other is also off.
+ */
+void dc_set_stop_mode(DcMotorId motor, DcStopMode mode);
+
+/**
+ * Returns true if the motor has an encoder attached (PIN_DC_*_ENC_A/B set).
+ */
+bool dc_has_encoder(DcMotorId motor);
+
+/**
+ * Holds the motor at rpm with the fixed-rate PID speed loop (non-blocking).
+ * Returns false if the motor has no encoder.
+ */
+bool dc_run_rpm(DcMotorId motor, float rpm, Direction direction);
+
+/**
+ * Runs until the encoder has advanced `counts`, at up to rpm, slowing down to
+ * arrive on the count instead of ending on a timer (non-blocking).
+ * Returns false if the motor has no encoder.
+ */
+bool dc_run_counts(DcMotorId motor, int32_t counts, float rpm, Direction direction);
+
+/**
+ * Blocking dc_run_counts(), resumes the remaining counts after a pause.
+ */
+void dc_run_counts_blocking(DcMotorId motor, int32_t counts, float rpm, Direction direction);
+
+/**
+ * Returns the measured speed in RPM along the commanded direction (0 without encoder).
+ */
+float dc_get_rpm(DcMotorId motor);
+
+/**
+ * Returns the raw encoder count (0 without encoder).
+ */
+int32_t dc_get_encoder_count(DcMotorId motor);
+
+/**
+ * Returns true while a run is active or held by pause.
+ */
+bool dc_is_busy(DcMotorId motor);
+
+/**
+ * Returns the output state of one DC motor.
+ */
+DcStatus dc_get_status(DcMotorId motor);
+
+/**
+ * Returns the thermal model's state. Runs are derated to duty_limit from
+ * DC_THERMAL_DERATE_START on, down to the continuous duty at load 1.0.
+ */
+DcThermal dc_get_thermal(DcMotorId motor);
+
+/**
+ * Returns how long the motor can run at duty from now before derating starts,
+ * in ms; UINT32_MAX if duty never derates it.
+ */
+uint32_t dc_budget_ms(DcMotorId motor, uint8_t duty);
+
+/**
+ * Returns move at full duty for time_ms scaled by speed / DC_PWM_MAX, if the
+ * budget covers it, else move unchanged. The scaling assumes speed follows duty,
+ * true enough for a lightly loaded motor; the travel of a heavily loaded one changes.
+ */
+DcTimedMove dc_boost_move(const DcTimedMove &move);
+
+/**
+ * Prints each motor's load, duty limit and full-duty budget.
+ */
+void dc_thermal_report(Print &out);
+
+/**
+ * Predicts how long a timed DC run takes, in microseconds.
+ * Runs end on the first dc_service() pass after the millis() deadline, so the
+ * measured duration is within 1 ms below this value plus one control loop period.
+ * Saturates at UINT32_MAX for runs longer than that many microseconds.
+ */
+uint32_t dc_estimate_run_us(const DcTimedMove &move);
+
+/**
+ * Predicts how long dc_run_ms_batch_blocking() takes (its longest run), in microseconds.
+ */
+uint32_t dc_estimate_batch_us(const DcTimedMove *moves, uint8_t move_count);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+// Fixed-rate PID speed loop for an encoder-equipped DC motor, plus the
+// approach profile for runs terminated on an encoder count. Pure logic with no
+// Arduino includes so it can be exercised on the host with simulated counts.
+//
+// Speeds are RPM magnitudes along the commanded direction; encoder counts are
+// expected to increase for direction = +1 (CW) and decrease for -1 (CCW).
+//
+// One period holds only a few counts of a coarse encoder (48 counts/rev at
+// 3000 RPM and 500 Hz is under 5), so speed is measured over the shortest
+// window of past periods that spans window_counts, capped at window_periods.
+// tools/speed_loop_sim checks settling and the approach against a motor model.
+
+constexpr uint8_t DC_SPEED_HISTORY = 32;  // periods of counts kept, bounds window_periods
+
+struct DcSpeedLoopConfig {
+	float counts_per_rev;    // encoder counts (x4) per output shaft revolution
+	float kp;                // duty per RPM of error
+	float ki;                // duty per RPM*second of accumulated error
+	float kd;                // duty per RPM/second, on the measurement
+	float kff;               // feed-forward duty per commanded RPM
+	float max_duty;          // output clamp
+	float decel_rpm_per_s;   // approach deceleration for count-terminated runs
+	float min_rpm;           // creep speed for the last counts of an approach
+	float period_s;          // fixed loop period
+	int32_t window_counts;   // counts a speed measurement spans, resolution 1 / window_counts
+	uint8_t window_periods;  // longest measurement window, 1..DC_SPEED_HISTORY
+};
+
+struct DcSpeedLoop {
+	DcSpeedLoopConfig config;
+	float target_rpm;
+	float command_rpm;       // target after the approach profile
+	float measured_rpm;
+	float integral;
+	int32_t history[DC_SPEED_HISTORY];  // counts of past periods, newest at history_head - 1
+	uint8_t history_head;
+	uint8_t history_fill;
+	int32_t target_count;    // absolute, count mode only
+	int8_t direction;
+	bool count_mode;
+};
+
+struct DcSpeedLoopOutput {
+	float duty;
+	bool done;               // count mode: target count reached
+};
+
+void dc_speed_loop_init(DcSpeedLoop &loop, const DcSpeedLoopConfig &config);
+
+/**
+ * Starts holding rpm from the current encoder count.
+ */
+void dc_speed_loop_start(DcSpeedLoop &loop, int32_t count, float rpm, int8_t direction);
+
+/**
+ * Starts a run of `counts` encoder counts at up to rpm, slowing down along
+ * decel_rpm_per_s so the motor arrives at the target count at min_rpm.
+ */
+void dc_speed_loop_start_counts(DcSpeedLoop &loop, int32_t count, int32_t counts, float rpm, int8_t direction);
+
+/**
+ * Runs one loop period with the latest encoder count and returns the duty to apply.
+ */
+DcSpeedLoopOutput dc_speed_loop_update(DcSpeedLoop &loop, int32_t count);
+
+/**
+ * Counts left in count mode (0 once reached or overshot).
+ */
+int32_t dc_speed_loop_remaining(const DcSpeedLoop &loop, int32_t count);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// I²t thermal model of one DC motor and its driver. Pure logic with no Arduino
+// includes so it can be exercised on the host.
+//
+// The winding is one first-order thermal mass. Heat input is (I / continuous_ma)²,
+// so `load`, the temperature rise, settles at 1.0 under the continuous rated
+// current and at q under a steady heat input q. I comes from the measured current
+// where the driver's IS pin is sensed, else from the commanded duty scaled to
+// full_duty_ma. While load stays below derate_start any duty is allowed; from
+// there to 1.0 the allowed duty falls to the one the motor can hold forever.
+
+struct DcThermalConfig {
+	float continuous_ma;   // current the motor can carry indefinitely
+	float full_duty_ma;    // estimated current at full duty, for unsensed motors
+	float tau_s;           // winding thermal time constant
+	float derate_start;    // load where derating starts, below 1.0
+};
+
+struct DcThermalModel {
+	DcThermalConfig config;
+	float load;            // temperature rise, 1.0 = continuous rating
+	float heat_sum;        // heat input integrated since the last step, per-unit * us
+	uint32_t sum_us;
+};
+
+void dc_thermal_init(DcThermalModel &model, const DcThermalConfig &config, float load);
+
+/**
+ * Per-unit heat input of a run at duty (of max_duty) or of a measured current.
+ */
+float dc_thermal_heat_from_duty(const DcThermalModel &model, uint8_t duty, uint8_t max_duty);
+float dc_thermal_heat_from_current(const DcThermalModel &model, float current_ma);
+
+/**
+ * Adds heat input held for dt_us. Cheap enough for every service pass.
+ */
+void dc_thermal_accumulate(DcThermalModel &model, float heat, uint32_t dt_us);
+
+/**
+ * Advances load over the accumulated time with the average heat input. Exact
+ * for any step length, so it can run at a slower fixed period.
+ */
+void dc_thermal_step(DcThermalModel &model);
+
+/**
+ * Highest duty allowed at the present load: max_duty below derate_start, the
+ * continuous duty from 1.0 on.
+ */
+uint8_t dc_thermal_duty_limit(const DcThermalModel &model, uint8_t max_duty);
+
+/**
+ * How long a run at duty can go before load reaches derate_start, in ms.
+ * UINT32_MAX if it never does, 0 if derating has already started.
+ */
+uint32_t dc_thermal_budget_ms(const DcThermalModel &model, uint8_t duty, uint8_t max_duty);
@@ -12,6 +12,14 @@ constexpr gpio_num_t PIN_S_M3_STEP = GPIO_NUM_6;
 constexpr gpio_num_t PIN_S_M3_DIR = GPIO_NUM_7;
 constexpr gpio_num_t PIN_S_M_EN = GPIO_NUM_40;
 
+// Optional stepper encoders (quadrature, counted by PCNT). GPIO_NUM_NC = axis runs open loop.
+constexpr gpio_num_t PIN_S_M1_ENC_A = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_S_M1_ENC_B = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_S_M2_ENC_A = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_S_M2_ENC_B = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_S_M3_ENC_A = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_S_M3_ENC_B = GPIO_NUM_NC;
+
 // DC 3000 RPM (two BTS7960 drivers in parallel control)
 constexpr gpio_num_t PIN_DC_3000_RPWM = GPIO_NUM_10;
 constexpr gpio_num_t PIN_DC_3000_LPWM = GPIO_NUM_11;
@@ -24,6 +32,20 @@ constexpr gpio_num_t PIN_DC2_300_RPWM = GPIO_NUM_38;
 constexpr gpio_num_t PIN_DC2_300_LPWM = GPIO_NUM_47;
 constexpr gpio_num_t PIN_DC_300_EN = GPIO_NUM_41;
 
+// Optional DC encoders (quadrature, counted by PCNT). GPIO_NUM_NC = open-loop PWM only.
+constexpr gpio_num_t PIN_DC_3000_ENC_A = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_DC_3000_ENC_B = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_DC1_300_ENC_A = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_DC1_300_ENC_B = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_DC2_300_ENC_A = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_DC2_300_ENC_B = GPIO_NUM_NC;
+
+// Optional BTS7960 current sense, R_IS and L_IS of a module tied together into one
+// ADC1 pin (GPIO1..10) with DC_IS_RESISTOR_OHM to GND. GPIO_NUM_NC = not sensed.
+constexpr gpio_num_t PIN_DC_3000_IS = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_DC1_300_IS = GPIO_NUM_NC;
+constexpr gpio_num_t PIN_DC2_300_IS = GPIO_NUM_NC;
+
 // 4x4 button matrix (8 wires total)
 // Rows
 constexpr gpio_num_t PIN_BTN_R0 = GPIO_NUM_12;
@@ -36,29 +58,185 @@ constexpr gpio_num_t PIN_BTN_C1 = GPIO_NUM_17;
 constexpr gpio_num_t PIN_BTN_C2 = GPIO_NUM_18;
 constexpr gpio_num_t PIN_BTN_C3 = GPIO_NUM_21;
 
+// Parallel step stream bus (LCD_CAM i80, used with STEPPER_STREAM_AXES > 0 only).
+// Data bit n carries STEP of stream axis n and bit width/2 + n its DIR; the bus is
+// 8 bits wide for up to four stream axes and 16 above. The N8R2 DevKitC has too few
+// free GPIOs left next to the wiring above, so assign these for the target board.
+constexpr gpio_num_t PIN_STEP_STREAM_DATA[16] = {
+  GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC,
+  GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC, GPIO_NUM_NC,
+};
+constexpr gpio_num_t PIN_STEP_STREAM_WR = GPIO_NUM_NC; // Bus clock, required by the peripheral, leave unconnected
+constexpr gpio_num_t PIN_STEP_STREAM_DC = GPIO_NUM_NC; // Required by the peripheral, leave unconnected
+
+// Station link UART (see station_link.h). UART0's pins are free with USB CDC as Serial.
+constexpr gpio_num_t PIN_LINK_TX = GPIO_NUM_43;
+constexpr gpio_num_t PIN_LINK_RX = GPIO_NUM_44;
+
 // Solenoid relay
 constexpr gpio_num_t PIN_SOLENOID_RLY = GPIO_NUM_39;
 
 // Onboard WS2812 RGB LED
-constexpr uint8_t PIN_RGB_LED = 48;          // GPIO 48 on ESP32-S3-DevKitC-1
+constexpr gpio_num_t PIN_RGB_LED = GPIO_NUM_48; // GPIO 48 on ESP32-S3-DevKitC-1
 constexpr uint8_t RGB_LED_BRIGHTNESS = 64;   // 0-255 (25% = comfortable indoor brightness)
 
 // -------------------- Shared constants --------------------
-constexpr uint8_t STEPPER_MOTOR_COUNT = 3;
+// Axes past the three DM542 ones are generated by the parallel step stream; set
+// their number with the build flag -DSTEPPER_STREAM_AXES=n (0..8).
+#ifndef STEPPER_STREAM_AXES
+#define STEPPER_STREAM_AXES 0
+#endif
+constexpr uint8_t STEPPER_GPIO_AXES = 3; // Axes stepped by AccelStepper on their own pins
+constexpr uint8_t STEPPER_MOTOR_COUNT = STEPPER_GPIO_AXES + STEPPER_STREAM_AXES;
+static_assert(STEPPER_STREAM_AXES <= 8, "the 16-bit step stream bus carries up to eight STEP/DIR pairs");
 
 // Stepper defaults
 constexpr float STEPPER_DEFAULT_MAX_SPEED = 1200.0f; // In steps per second
 constexpr float STEPPER_DEFAULT_ACCEL = 800.0f; // In steps per second squared
 constexpr float STEPPER_DEFAULT_DECEL = 800.0f; // In steps per second squared
+constexpr bool STEPPER_USE_PROFILE_TABLE = false; // Run matching moves with stepper_profile_table.h
+
+// Parallel step stream
+constexpr uint32_t STEP_STREAM_SAMPLE_HZ = 2000000; // Bus words per second, the i80 pclk (1.25 MHz minimum)
+constexpr uint16_t STEP_STREAM_PULSE_SAMPLES = 10; // Words a STEP pulse stays high (5 us), caps steps at 100 kHz
+constexpr uint16_t STEP_STREAM_BUFFER_SAMPLES = 4000; // Bus words per DMA buffer (2 ms)
+constexpr uint8_t STEP_STREAM_BUFFERS = 4; // Buffers queued ahead, bounds command latency
+constexpr uint16_t STEP_STREAM_DIR_SETUP_SAMPLES = 10; // Words between a DIR change and the next STEP (5 us)
+constexpr uint8_t STEP_STREAM_TASK_PRIORITY = 4; // Below the control loop
+
+// Position-triggered actions
+constexpr uint8_t STEPPER_MAX_TRIGGERS = 8; // Armed triggers across all axes
+
+// Stepper stall detection (axes with an encoder only)
+constexpr float STEPPER_ENCODER_COUNTS_PER_STEP = 1.0f; // Encoder counts (x4) per driver step
+constexpr int32_t STEPPER_FOLLOWING_ERROR_LIMIT = 20; // In steps
+constexpr uint8_t STEPPER_STALL_CONFIRM_SAMPLES = 3; // Consecutive checks over the limit
+constexpr uint32_t STEPPER_STALL_CHECK_PERIOD_US = 1000; // In microseconds
+constexpr float STEPPER_STALL_RETRY_SPEED_FACTOR = 0.5f; // Fraction of max speed for retries
+constexpr uint8_t STEPPER_STALL_MAX_RETRIES = 2;
 
 // DC PWM defaults
 constexpr uint32_t DC_PWM_FREQ_HZ = 20000; // In Hertz
 constexpr uint8_t DC_PWM_BITS = 8; // Resolution in bits
 constexpr uint8_t DC_PWM_MAX = 255; // Maximum PWM value
 
+// DC closed-loop speed control (motors with an encoder only)
+constexpr uint32_t DC_SPEED_LOOP_HZ = 500; // In Hertz
+constexpr float DC_SPEED_KD = 0.0f; // Duty per RPM/second
+constexpr int32_t DC_SPEED_WINDOW_COUNTS = 32; // Counts a speed measurement spans at least
+constexpr uint8_t DC_SPEED_WINDOW_PERIODS = 25; // Longest measurement window in loop periods
+constexpr float DC_3000_ENCODER_COUNTS_PER_REV = 48.0f; // x4 counts per output revolution
+constexpr float DC_3000_SPEED_KP = 0.3f; // Duty per RPM of error
+constexpr float DC_3000_SPEED_KI = 2.0f; // Duty per RPM*second
+constexpr float DC_3000_SPEED_KFF = 255.0f / 3000.0f; // Duty per commanded RPM
+constexpr float DC_3000_APPROACH_DECEL_RPM_PER_S = 15000.0f;
+constexpr float DC_3000_APPROACH_MIN_RPM = 200.0f;
+constexpr float DC_300_ENCODER_COUNTS_PER_REV = 600.0f; // x4 counts per output revolution
+constexpr float DC_300_SPEED_KP = 1.0f; // Duty per RPM of error
+constexpr float DC_300_SPEED_KI = 20.0f; // Duty per RPM*second
+constexpr float DC_300_SPEED_KFF = 255.0f / 300.0f; // Duty per commanded RPM
+constexpr float DC_300_APPROACH_DECEL_RPM_PER_S = 1500.0f;
+constexpr float DC_300_APPROACH_MIN_RPM = 20.0f;
+
+// DC current sense (motors with an IS pin only)
+constexpr uint32_t DC_CURRENT_SAMPLE_HZ = 20000; // ADC conversions per second across all sensed motors
+constexpr uint16_t DC_CURRENT_BLOCK_SAMPLES = 60; // Conversions per DMA block, the update period
+constexpr float DC_IS_RATIO = 8500.0f; // Load current per IS current (BTS7960 kILIS, typical)
+constexpr float DC_IS_RESISTOR_OHM = 1000.0f; // IS load resistor
+constexpr float DC_CURRENT_FILTER_HZ = 30.0f; // Low-pass corner for the reported and jam-checked current
+constexpr float DC_3000_OVERCURRENT_MA = 25000.0f; // Stop at once above this, 0 = off
+constexpr float DC_3000_JAM_MA = 12000.0f; // Stop when the filtered current stays above this, 0 = off
+constexpr float DC_300_OVERCURRENT_MA = 12000.0f;
+constexpr float DC_300_JAM_MA = 5000.0f;
+constexpr uint32_t DC_JAM_MS = 100; // In milliseconds
+constexpr uint32_t DC_INRUSH_MS = 250; // In milliseconds, no jam check after a run starts
+constexpr uint8_t DC_CURRENT_TASK_PRIORITY = 4; // Below the control loop
+
+// DC thermal model (I²t per motor, see dc_thermal.h). Placeholder ratings: take
+// them from the motor datasheets, the time constants from a heat-up run.
+constexpr float DC_3000_CONTINUOUS_MA = 3000.0f; // Rated continuous current
+constexpr float DC_3000_FULL_DUTY_MA = 6000.0f; // Running current at full duty, used when not sensed
+constexpr float DC_3000_THERMAL_TAU_S = 20.0f; // Winding thermal time constant
+constexpr float DC_300_CONTINUOUS_MA = 1000.0f;
+constexpr float DC_300_FULL_DUTY_MA = 1500.0f;
+constexpr float DC_300_THERMAL_TAU_S = 15.0f;
+constexpr float DC_THERMAL_DERATE_START = 0.8f; // Load where the allowed duty starts to fall
+constexpr float DC_THERMAL_BOOT_LOAD = 0.5f; // Assumed after reset, the model cannot know how warm the motors are
+constexpr uint32_t DC_THERMAL_PERIOD_US = 10000; // In microseconds, model step and derating update
+constexpr bool DC_BOOST_SHORT_RUNS = false; // Task8 through dc_boost_move(): full duty for proportionally less time
+
+// Control loop (hardware-timer driven task for DC timing, pause and closed loop)
+constexpr uint32_t CONTROL_LOOP_RATE_HZ = 2000; // In Hertz, 1000..10000 and a multiple of DC_SPEED_LOOP_HZ
+constexpr uint8_t CONTROL_LOOP_HW_TIMER = 0; // Hardware timer number
+constexpr uint8_t CONTROL_LOOP_TASK_PRIORITY = 5; // Above the other core 0 services
+constexpr uint32_t CONTROL_LOOP_MIN_RATE_HZ = 1000; // In Hertz
+constexpr uint32_t CONTROL_LOOP_MAX_RATE_HZ = 10000; // In Hertz
+
+// Mixed motion batches
+constexpr uint8_t MOTION_BATCH_MAX_ITEMS = 16;
+
+// Motion state snapshot
+constexpr uint32_t MOTION_SNAPSHOT_PERIOD_US = 500; // Minimum time between published snapshots
+
+// Telemetry stream
+constexpr uint16_t TELEMETRY_MAX_RATE_HZ = 1000; // In Hertz
+constexpr uint16_t TELEMETRY_BOOT_RATE_HZ = 0; // In Hertz, 0 = do not stream from boot
+
+// Event trace
+constexpr uint32_t TRACE_RING_EVENTS = 1024; // Per core, power of two
+
+// Status LED service
+constexpr uint8_t STATUS_LED_RMT_CHANNEL = 0; // RMT TX channel 0..3
+constexpr uint32_t STATUS_LED_FRAME_MS = 20; // Animation frame period in milliseconds
+constexpr uint32_t STATUS_LED_BLINK_PERIOD_MS = 500; // In milliseconds
+constexpr uint32_t STATUS_LED_BREATHE_PERIOD_MS = 2000; // In milliseconds
+constexpr uint32_t STATUS_LED_CODE_BLINK_MS = 200; // On and off time of one error-code blink
+constexpr uint32_t STATUS_LED_CODE_PAUSE_MS = 1000; // Gap between error-code repetitions
+
+// On-target benchmark (BTNC + BTND, or `bench` on the console, before START)
+constexpr uint32_t BENCH_TRIAL_MS = 200; // In milliseconds, length of one step-rate trial
+constexpr float BENCH_MIN_STEP_RATE = 1000.0f; // steps/second, search start
+constexpr float BENCH_MAX_STEP_RATE = 64000.0f; // steps/second, search ceiling
+constexpr float BENCH_RATE_TOLERANCE = 0.98f; // Achieved/commanded rate that still counts as sustained
+constexpr uint32_t BENCH_SERVICE_SAMPLE_MS = 1000; // In milliseconds, per loop period measurement
+constexpr uint8_t BENCH_DC_RUNS = 5; // Timed runs per DC motor
+constexpr uint32_t BENCH_DC_RUN_MS = 100; // In milliseconds
+constexpr uint8_t BENCH_DC_DUTY = 80; // PWM duty for the DC runs
+constexpr uint32_t BENCH_PAUSE_WAIT_MS = 10000; // In milliseconds, time given to press B
+
+// Station link: build one station with -DSTATION_LINK_ROLE=1 (serves the time
+// base) and its neighbour with 2; 0 leaves the UART unused.
+#ifndef STATION_LINK_ROLE
+#define STATION_LINK_ROLE 0
+#endif
+constexpr uint8_t LINK_UART_NUM = 1; // UART peripheral
+constexpr uint32_t LINK_BAUD = 921600; // In bits per second
+constexpr uint32_t LINK_SYNC_PERIOD_MS = 100; // In milliseconds, follower time requests
+constexpr uint32_t LINK_RESEND_MS = 50; // In milliseconds, unacknowledged batches and barriers
+constexpr uint32_t LINK_START_SPIN_US = 2000; // Busy-wait this close to a batch start instead of sleeping
+constexpr uint8_t LINK_TASK_PRIORITY = 4; // Below the control loop
+
+// Boot profiling
+constexpr uint8_t BOOT_PROFILE_MAX_MARKS = 16;
+
+// Diagnostics
+constexpr uint32_t DIAG_SAMPLE_PERIOD_MS = 1000; // In milliseconds
+constexpr uint8_t DIAG_TASK_HEADROOM = 4; // Spare task slots allocated beyond the current task count
+constexpr uint32_t DIAG_IDLE_CONTINUITY_US = 100; // Idle hook gaps up to this count as idle time
+
+// Serial console
+constexpr uint8_t CONSOLE_LINE_MAX = 64; // In characters
+
 // Key scan timing
 constexpr uint32_t KEY_SCAN_PERIOD_MS = 2; // In milliseconds
 constexpr uint32_t KEY_DEBOUNCE_MS = 20; // In milliseconds
+constexpr uint32_t KEY_HOLD_MS = 1000; // In milliseconds
+constexpr uint32_t KEY_LONG_PRESS_MS = 3000; // In milliseconds
+
+// Button events
+constexpr uint32_t BUTTON_EVENT_RING = 32; // Events kept for slow readers, power of two
+constexpr uint8_t BUTTON_MAX_READERS = 4;
+constexpr uint8_t BUTTON_TASK_PRIORITY = 4; // Scan task, core 0
 
 enum class Direction : uint8_t {
   CW = 0,
@@ -69,3 +247,18 @@ enum class SolenoidState : uint8_t {
   OFF = 0,
   ON = 1,
 };
+
+// How a BTS7960 channel stops. Braking keeps EN high with both inputs low, so
+// both low-side switches short the motor; coasting drops EN.
+enum class DcStopMode : uint8_t {
+  DEFAULT = 0,           // the motor's configured mode (dc_set_stop_mode())
+  COAST = 1,
+  BRAKE = 2,             // brake until the next command
+  BRAKE_THEN_COAST = 3,  // brake for DC_BRAKE_MS, then coast
+};
+
+// DC stop behaviour
+constexpr DcStopMode DC_3000_STOP_MODE = DcStopMode::BRAKE_THEN_COAST; // When a 3000 RPM run ends
+constexpr DcStopMode DC_300_STOP_MODE = DcStopMode::COAST; // When a 300 RPM run ends
+constexpr DcStopMode DC_PAUSE_STOP_MODE = DcStopMode::BRAKE; // While g_paused holds a run
+constexpr uint32_t DC_BRAKE_MS = 250; // In milliseconds, brake phase of BRAKE_THEN_COAST
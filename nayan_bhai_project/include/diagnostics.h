@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Starts the diagnostics sampler: a low-priority task on core 0 that every
+ * DIAG_SAMPLE_PERIOD_MS reads the FreeRTOS task list (stack high-water marks,
+ * and per-task CPU share when run-time stats are compiled in) and per-core
+ * load measured from idle hooks, including the longest stretch each core's
+ * idle task did not get to run.
+ */
+void diagnostics_start();
+
+/**
+ * Asks the sampler to print a report to Serial. Safe to call from any task;
+ * the printing happens on the sampler task.
+ */
+void diagnostics_request_report();
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Quadrature encoders counted in hardware by the ESP32-S3 PCNT peripheral.
+// The S3 has four PCNT units, so at most four encoders can be attached in total.
+
+constexpr int8_t ENCODER_NONE = -1;
+
+/**
+ * Attaches a quadrature encoder on pin_a/pin_b (x4 decoding, glitch filtered)
+ * and returns its handle, or ENCODER_NONE when a pin is GPIO_NUM_NC or no
+ * PCNT unit is left.
+ */
+int8_t encoder_attach(gpio_num_t pin_a, gpio_num_t pin_b);
+
+/**
+ * Returns the 32-bit extended count. Safe to call from any task.
+ */
+int32_t encoder_read(int8_t encoder);
+
+/**
+ * Overwrites the extended count.
+ */
+void encoder_write(int8_t encoder, int32_t count);
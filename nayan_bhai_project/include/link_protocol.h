@@ -0,0 +1,209 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Station link: a point-to-point UART protocol between two controllers on one
+// line. It distributes the clock master's time, carries timed batches one
+// station schedules on the other and exchanges completion barriers.
+// Pure logic with no Arduino includes: station_link.cpp binds it to the UART on
+// target, tools/link_sim.cpp runs two nodes over a Linux pty pair.
+//
+// Frame: LINK_FRAME_SYNC0, LINK_FRAME_SYNC1, type, length (u16), payload,
+// crc16_ccitt() over type, length and payload. All fields are little-endian.
+//
+// Time sync is NTP-style. The follower stamps a request (t1), the master stamps
+// its arrival (t2) and its reply (t3), and the follower stamps the reply's
+// arrival (t4). Every LINK_SYNC_WINDOW exchanges, the one with the shortest
+// round trip sets the offset, so requests delayed by queueing do not count.
+// A least-squares line through the last LINK_SKEW_POINTS of those offsets gives
+// the crystals' frequency difference: the longer the baseline, the less the
+// microseconds of noise on each offset weigh.
+
+constexpr uint8_t LINK_FRAME_SYNC0 = 0xA5;
+constexpr uint8_t LINK_FRAME_SYNC1 = 0x3C;
+constexpr uint16_t LINK_MAX_PAYLOAD = 256;
+constexpr uint8_t LINK_MAX_BATCH_ITEMS = 16;
+constexpr uint8_t LINK_RX_BATCHES = 4;   // scheduled batches a station holds
+constexpr uint8_t LINK_SYNC_WINDOW = 8;  // exchanges per offset update
+constexpr uint8_t LINK_SKEW_POINTS = 32; // offset updates the skew is fitted over
+constexpr uint8_t LINK_MAX_RETRIES = 5;  // batch resends before it counts as failed
+
+enum class LinkMessage : uint8_t {
+  TIME_REQUEST = 1,  // t1
+  TIME_REPLY = 2,    // t1, t2, t3
+  BATCH = 3,         // id, start (shared time), count, items
+  BATCH_ACK = 4,     // id, accepted
+  BATCH_DONE = 5,    // id
+  BARRIER = 6,       // id, reply
+};
+
+// Item kinds and the ranges of their fields on the wire, as the MotionBatchKind,
+// DcMotorId, Direction, DcStopMode and SolenoidState values station_link.cpp
+// converts to. A batch with a field outside them is rejected.
+constexpr uint8_t LINK_ITEM_STEPPER = 0;
+constexpr uint8_t LINK_ITEM_DC = 1;
+constexpr uint8_t LINK_ITEM_SOLENOID = 2;
+constexpr uint8_t LINK_DC_MOTORS = 3;
+constexpr uint8_t LINK_DIRECTIONS = 2;
+constexpr uint8_t LINK_DC_STOP_MODES = 4;
+constexpr uint8_t LINK_SOLENOID_STATES = 2;
+
+// One MotionBatchItem on the wire; station_link.cpp converts.
+struct __attribute__((packed)) LinkBatchItem {
+	uint8_t kind;              // LINK_ITEM_*
+	uint32_t start_offset_ms;
+	uint8_t motor;             // stepper motor number, or DcMotorId
+	int32_t amount;            // stepper steps, or DC run time in ms
+	uint8_t direction;         // Direction
+	uint8_t speed;             // DC duty
+	uint8_t option;            // DcStopMode, or SolenoidState
+};
+
+struct LinkBatch {
+	uint16_t id;
+	uint64_t start_us;  // shared time
+	uint8_t count;
+	LinkBatchItem items[LINK_MAX_BATCH_ITEMS];
+};
+
+using LinkWriteFn = void (*)(const uint8_t *data, size_t length, void *context);
+
+struct LinkConfig {
+	bool clock_master;        // serves the time base; the other end follows it
+	uint32_t baud;            // backs out byte airtime from receive stamps, 0 = none
+	uint32_t sync_period_us;  // follower: time between requests
+	uint32_t resend_us;       // unacknowledged batches and barriers
+	uint8_t stepper_motors;   // batches may name stepper motors 1..stepper_motors
+	LinkWriteFn write;
+	void *context;
+};
+
+struct LinkStats {
+	uint32_t frames;
+	uint32_t crc_errors;
+	uint32_t sync_updates;
+	uint32_t resends;
+};
+
+struct LinkSyncSample {
+	int64_t offset_us;  // master - follower
+	uint32_t rtt_us;
+	uint64_t local_us;
+};
+
+struct LinkNode {
+	LinkConfig config;
+	LinkStats stats;
+
+	// Frame parser
+	uint8_t rx[LINK_MAX_PAYLOAD + 7];
+	uint16_t rx_length;
+	uint16_t rx_expected;
+
+	// Time base (follower)
+	bool synced;
+	int64_t offset_us;       // shared - local at offset_local_us
+	uint64_t offset_local_us;
+	float skew;              // d(offset)/d(local)
+	uint32_t error_bound_us; // half the round trip of the sample in use
+	uint64_t request_t1;     // pending request, 0 = none
+	uint64_t last_request_us;
+	LinkSyncSample window[LINK_SYNC_WINDOW];
+	uint8_t window_count;
+	LinkSyncSample skew_points[LINK_SKEW_POINTS];  // ring of past offset updates
+	uint8_t skew_head;
+	uint8_t skew_count;
+
+	// Batches this station scheduled on the peer
+	uint16_t next_batch_id;
+	bool out_pending;        // sent, not acknowledged yet
+	uint8_t out_retries;
+	uint64_t out_sent_us;
+	uint16_t out_failed_id;  // rejected or never acknowledged
+	uint16_t out_done_id;    // latest the peer completed
+	LinkBatch out_batch;
+
+	// Batches the peer scheduled here
+	LinkBatch in_batches[LINK_RX_BATCHES];
+	uint8_t in_head;
+	uint8_t in_count;
+	uint16_t in_accepted_id;
+	uint16_t in_completed_id;
+
+	// Barriers
+	uint16_t barrier_reached;
+	uint16_t peer_barrier;
+	uint64_t barrier_sent_us;
+};
+
+/**
+ * Returns true once `value` has reached `target` in a wrapping 16-bit sequence.
+ */
+inline bool link_seq_reached(uint16_t value, uint16_t target) {
+  return static_cast<int16_t>(value - target) >= 0;
+}
+
+void link_init(LinkNode &node, const LinkConfig &config);
+
+/**
+ * Feeds received bytes; `now_us` is the local time the last of them arrived.
+ * Handles every complete frame, answering the peer through config.write.
+ */
+void link_receive(LinkNode &node, const uint8_t *data, size_t length, uint64_t now_us);
+
+/**
+ * Sends time requests (follower) and resends unacknowledged batches and barriers.
+ * Call it at least every few milliseconds.
+ */
+void link_service(LinkNode &node, uint64_t now_us);
+
+/**
+ * Converts between local and shared (clock master) time. Before the first
+ * offset update the follower's shared time is its local time.
+ */
+uint64_t link_shared_time(const LinkNode &node, uint64_t local_us);
+uint64_t link_local_time(const LinkNode &node, uint64_t shared_us);
+
+/**
+ * Returns true on the master, and on the follower once it has an offset.
+ */
+bool link_is_synced(const LinkNode &node);
+
+/**
+ * Sends a batch for the peer to start at shared time start_us and returns its
+ * id, or 0 while the previous batch is still unacknowledged or count is invalid.
+ */
+uint16_t link_send_batch(LinkNode &node, uint64_t start_us, const LinkBatchItem *items, uint8_t count,
+                         uint64_t now_us);
+
+/**
+ * Returns true once the peer reported the batch complete.
+ */
+bool link_batch_done(const LinkNode &node, uint16_t id);
+
+/**
+ * Returns true if the peer rejected the batch (its queue was full or an item out
+ * of range) or never acknowledged it.
+ */
+bool link_batch_failed(const LinkNode &node, uint16_t id);
+
+/**
+ * Returns the oldest batch the peer scheduled here without removing it.
+ */
+const LinkBatch *link_peek_batch(const LinkNode &node);
+
+/**
+ * Removes the oldest scheduled batch after running it and reports it complete.
+ */
+void link_complete_batch(LinkNode &node);
+
+/**
+ * Records that this station reached barrier id (ids count up from 1) and tells the peer.
+ */
+void link_barrier_arrive(LinkNode &node, uint16_t id, uint64_t now_us);
+
+/**
+ * Returns true once both stations reached barrier id.
+ */
+bool link_barrier_passed(const LinkNode &node, uint16_t id);
@@ -5,6 +5,10 @@
 extern bool start_button_pressed;
 extern volatile bool g_paused;
 
-// Onboard RGB LED helpers
+// Solenoid relay
+void solenoid_state(SolenoidState state);
+SolenoidState solenoid_get_state();
+
+// Onboard RGB LED helpers (solid colors through the status LED service)
 void rgb_led_init();
 void set_rgb_led(uint8_t r, uint8_t g, uint8_t b);
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include "dc_motor.h"
+#include "defines.h"
+#include "motion_profile.h"
+#include "stepper_motor.h"
+
+enum class MotionBatchKind : uint8_t {
+	STEPPER = 0,
+	DC = 1,
+	SOLENOID = 2,
+};
+
+// One actuator command of a mixed batch; only the member matching kind is used.
+struct MotionBatchItem {
+	MotionBatchKind kind;
+	uint32_t start_offset_ms;  // after the batch starts, paused time not counted
+	StepperMove stepper;
+	DcTimedMove dc;
+	SolenoidState solenoid;
+};
+
+MotionBatchItem batch_stepper(const StepperMove &move, uint32_t start_offset_ms = 0);
+MotionBatchItem batch_dc(const DcTimedMove &move, uint32_t start_offset_ms = 0);
+MotionBatchItem batch_solenoid(SolenoidState state, uint32_t start_offset_ms = 0);
+
+/**
+ * Starts steppers, DC runs and the solenoid as one group, each item at its
+ * start offset, and blocks until every item is complete. While g_paused is set
+ * the ramped steppers decelerate to a common stop (stepper_hold()) and resume
+ * their remaining steps together, each profile scaled to the slowest axis
+ * (stepper_resume()); DC runs are held by dc_service(), and pending offsets
+ * wait. Give each actuator one item at a time; at most MOTION_BATCH_MAX_ITEMS
+ * items are run.
+ */
+void motion_batch_run_blocking(const MotionBatchItem *items, uint8_t item_count);
+
+/**
+ * Predicts how long motion_batch_run_blocking() takes (latest offset + duration), in microseconds.
+ */
+uint32_t motion_batch_estimate_us(const MotionBatchItem *items, uint8_t item_count, const MotionProfile &profile);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+// Pure trapezoid math shared by the firmware and the host tools in tools/.
+// Keep this header free of Arduino/ESP-IDF includes.
+
+enum class RampShape : uint8_t {
+	NO_RAMP = 0,
+	TRIANGLE = 1,
+	TRAPEZOID = 2,
+};
+
+struct MotionProfile {
+	float max_speed;     // steps/second
+	float acceleration;  // steps/second^2
+	float deceleration;  // steps/second^2
+	bool no_ramp;        // true = instant speed changes
+};
+
+struct MoveTiming {
+	RampShape shape;
+	float peak_speed;    // steps/second actually reached
+	uint32_t accel_us;
+	uint32_t cruise_us;
+	uint32_t decel_us;
+	uint32_t total_us;
+};
+
+/**
+ * Builds a profile from stepper_set_config() arguments using the same fallback
+ * rules (non-positive values take the fallback, -1 accel/decel selects no-ramp).
+ */
+MotionProfile motion_profile_from_config(float speed, float acceleration, float deceleration,
+                                         const MotionProfile &fallback);
+
+/**
+ * Plans a point-to-point move of |steps| starting and ending at rest.
+ * Constant time; no step simulation.
+ */
+MoveTiming motion_profile_plan(const MotionProfile &profile, uint32_t steps);
+
+/**
+ * Profile as the AccelStepper engine executes it: one rate for both ramps,
+ * so deceleration follows acceleration.
+ */
+MotionProfile motion_profile_engine(const MotionProfile &profile);
+
+/**
+ * Duration of a move as AccelStepper runs it, in microseconds. This is the
+ * ideal plan of motion_profile_engine() less the engine's discretization: the
+ * first step fires immediately and each ramp ends about one c0 interval early
+ * (one more when deceleration starts before cruise). tools/estimate_sim checks
+ * it stays within 0.6% of the engine for moves of 100 steps or more.
+ */
+uint32_t motion_profile_engine_us(const MotionProfile &profile, uint32_t steps);
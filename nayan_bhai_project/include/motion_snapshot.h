@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Arduino.h>
+#include "dc_motor.h"
+#include "defines.h"
+#include "stepper_motor.h"
+
+// One consistent view of every axis and output, captured on the motion task.
+struct MotionSnapshot {
+	uint32_t timestamp_us;                            // esp_timer time of the capture
+	uint32_t stepper_timestamp_us;                    // of the stepper fields, which only loop() captures
+	uint32_t sequence;                                // increments by one per publish
+	int32_t position[STEPPER_MOTOR_COUNT];            // steps
+	float speed[STEPPER_MOTOR_COUNT];                 // steps/second, negative = CCW
+	StepperMotionState state[STEPPER_MOTOR_COUNT];
+	bool faulted[STEPPER_MOTOR_COUNT];
+	DcStatus dc[3];                                   // indexed by DcMotorId
+	SolenoidState solenoid;
+	bool paused;
+};
+
+/**
+ * Publishes the first snapshot. Call it from setup() once the steppers and DC
+ * motors are initialized and before the control loop starts, so readers have
+ * one from boot on.
+ */
+void motion_snapshot_init();
+
+/**
+ * Captures and publishes a snapshot if max_age_us has passed since the last
+ * one. stepper_service() calls it on the loop() task, which owns the steppers.
+ */
+void motion_snapshot_service(uint32_t max_age_us = MOTION_SNAPSHOT_PERIOD_US);
+
+/**
+ * Like motion_snapshot_service() but captures only the DC, solenoid and pause
+ * fields and republishes the stepper fields of the last full snapshot. The
+ * control loop calls it with a longer max_age_us so the snapshot stays fresh
+ * while loop() is not stepping, without touching the AccelStepper objects
+ * from another core.
+ */
+void motion_snapshot_service_outputs(uint32_t max_age_us);
+
+/**
+ * Copies the latest snapshot into out. Never blocks the writer; retries only
+ * if a publish lands mid-copy. Safe from any task or esp_timer callback on
+ * either core. Returns false until the first snapshot has been published.
+ */
+bool motion_snapshot_read(MotionSnapshot &out);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include "dc_motor.h"
+#include "defines.h"
+
+enum class TriggerActionKind : uint8_t {
+	DC_RUN = 0,       // dc_run_ms(dc_move)
+	SOLENOID = 1,     // solenoid_state(solenoid)
+	NOTIFY_TASK = 2,  // xTaskNotify(task, notify_bits, eSetBits)
+};
+
+struct TriggerAction {
+	TriggerActionKind kind;
+	DcTimedMove dc_move;
+	SolenoidState solenoid;
+	TaskHandle_t task;
+	uint32_t notify_bits;
+};
+
+TriggerAction trigger_dc_run(const DcTimedMove &move);
+TriggerAction trigger_solenoid(SolenoidState state);
+TriggerAction trigger_notify(TaskHandle_t task, uint32_t bits);
+
+/**
+ * Runs action once when the stepper's commanded position reaches position, checked
+ * by stepper_service() on every step instead of polling stepper_get_position().
+ * Arm it before starting the move; position is compared against the side the
+ * axis is on now. Returns false when all STEPPER_MAX_TRIGGERS slots are in use.
+ */
+bool motion_trigger_at_position(uint8_t motor_number, int32_t position, const TriggerAction &action);
+
+/**
+ * Runs action once when the stepper's next move starts decelerating, or when it
+ * ends if ramping is disabled.
+ */
+bool motion_trigger_at_decel(uint8_t motor_number, const TriggerAction &action);
+
+/**
+ * Drops every trigger armed on one stepper without running it.
+ */
+void motion_trigger_clear(uint8_t motor_number);
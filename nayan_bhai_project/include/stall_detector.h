@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// Following-error stall detection for an encoder-equipped stepper axis.
+// Pure logic with no Arduino includes so it can be exercised on the host with
+// simulated encoder counts.
+
+struct StallDetectorConfig {
+	float counts_per_step;          // encoder counts per commanded step
+	int32_t following_error_limit;  // steps
+	uint8_t confirm_samples;        // consecutive over-limit checks before a stall
+};
+
+enum class StallCheck : uint8_t {
+	OK = 0,
+	OVER_LIMIT = 1,  // beyond the limit, not yet confirmed
+	STALLED = 2,
+};
+
+struct StallDetector {
+	StallDetectorConfig config;
+	int32_t commanded_origin;   // commanded position at the last sync
+	int32_t encoder_origin;     // encoder count at the last sync
+	int32_t following_error;    // commanded - actual, steps
+	uint8_t over_limit_samples;
+};
+
+void stall_detector_init(StallDetector &detector, const StallDetectorConfig &config);
+
+/**
+ * Declares that commanded_position and encoder_count describe the same
+ * physical position, e.g. after homing or a position correction.
+ */
+void stall_detector_sync(StallDetector &detector, int32_t commanded_position, int32_t encoder_count);
+
+/**
+ * Converts an encoder count into an axis position in steps.
+ */
+int32_t stall_detector_actual_position(const StallDetector &detector, int32_t encoder_count);
+
+/**
+ * Compares the commanded position against the encoder and returns STALLED
+ * once the following error has exceeded the limit for confirm_samples
+ * consecutive checks. The counter restarts after a STALLED result.
+ */
+StallCheck stall_detector_update(StallDetector &detector, int32_t commanded_position, int32_t encoder_count);
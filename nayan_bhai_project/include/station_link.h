@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+#include "motion_batch.h"
+
+// Coordination with the neighbouring station over LINK_UART_NUM, see
+// link_protocol.h for the protocol. Shared time is the clock master's
+// esp_timer time; both stations use it to start work at the same instant.
+
+/**
+ * Brings up the UART (PIN_LINK_TX/RX, LINK_BAUD) and a task on core 0 that
+ * receives, keeps the time base and resends. clock_master serves the time;
+ * the neighbour must be started as the follower. Returns false if the UART
+ * driver cannot be installed.
+ */
+bool station_link_start(bool clock_master);
+
+/**
+ * Returns true on the master, and on the follower once it has a time offset.
+ */
+bool station_link_synced();
+
+/**
+ * Returns the shared time in microseconds.
+ */
+uint64_t station_link_time_us();
+
+/**
+ * Returns half the round trip of the exchange the current offset comes from,
+ * in microseconds, a bound on the sync error apart from asymmetric delays.
+ */
+uint32_t station_link_sync_error_us();
+
+/**
+ * Sleeps, then spins for the last LINK_START_SPIN_US, until shared time shared_us.
+ */
+void station_link_wait_until(uint64_t shared_us);
+
+/**
+ * Schedules items on the neighbour to start at shared time start_us and returns
+ * the batch id, or 0 if the link is down or the previous batch never got acknowledged.
+ */
+uint16_t station_link_schedule_batch(const MotionBatchItem *items, uint8_t item_count, uint64_t start_us);
+
+/**
+ * Waits until the neighbour reports batch id complete. Returns false if it was
+ * rejected or timeout_ms passed; time spent paused does not count.
+ */
+bool station_link_wait_batch(uint16_t id, uint32_t timeout_ms);
+
+/**
+ * Marks barrier id (counting up from 1) reached and waits until the neighbour
+ * reaches it too. Returns false after timeout_ms; time spent paused does not count.
+ */
+bool station_link_barrier(uint16_t id, uint32_t timeout_ms);
+
+/**
+ * Runs the batches the neighbour scheduled here, each at its start time, and
+ * reports them complete. Call it wherever the station is at rest and free to
+ * take them: outside the sequence, between its tasks and in its waits. The
+ * waits of this module take them on their own. Blocks until the queued
+ * batches are done.
+ */
+void station_link_service();
+
+/**
+ * Prints the link state and counters.
+ */
+void station_link_report(Print &out);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+
+enum class LedPattern : uint8_t {
+	OFF = 0,
+	SOLID,
+	BLINK,       // STATUS_LED_BLINK_PERIOD_MS, 50% duty
+	BREATHE,     // smooth fade over STATUS_LED_BREATHE_PERIOD_MS
+	ERROR_CODE,  // `code` short blinks, then a pause, repeated
+};
+
+/**
+ * Installs the RMT channel for the onboard WS2812 and starts the LED task
+ * (priority 1, core 0). The RMT peripheral clocks the bits out on its own, so
+ * neither the caller nor the LED task masks interrupts.
+ */
+void status_led_init();
+
+/**
+ * Requests a color and pattern. Never blocks: the newest request replaces one
+ * the LED task has not picked up yet. Callable from any task.
+ */
+void status_led_set(LedPattern pattern, uint8_t r, uint8_t g, uint8_t b, uint8_t code = 0);
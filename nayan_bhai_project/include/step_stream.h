@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include "defines.h"
+#include "stepper_motor.h"
+
+// Step generation for the STEPPER_STREAM_AXES axes that follow the DM542 ones.
+// A fill task on core 0 turns each axis' trapezoid into STEP/DIR bitmaps that the
+// LCD_CAM i80 bus clocks out by DMA at STEP_STREAM_SAMPLE_HZ, so CPU time grows
+// with steps emitted rather than with axes polled. Each STEP pulse spans
+// STEP_STREAM_PULSE_SAMPLES words; step_stream_fill.h does the timing.
+// stepper_* forwards motor numbers above STEPPER_GPIO_AXES here; `axis` below
+// counts from 0.
+//
+// Commands take effect at the next buffer the task fills, so they start up to
+// STEP_STREAM_BUFFERS * STEP_STREAM_BUFFER_SAMPLES samples after the call, and
+// positions are the ones written to the bus, ahead of the pins by the same amount.
+
+/**
+ * Sets up the bus, the DMA buffers and the fill task. Returns false if a bus
+ * pin is unassigned or the peripheral is unavailable; stream axes then ignore
+ * commands and stay idle. Nothing to do without stream axes.
+ */
+bool step_stream_init();
+
+/**
+ * Moves `steps` (signed) from rest along a symmetric trapezoid, or at max_speed
+ * throughout when acceleration <= 0. A command to a moving axis keeps its speed
+ * when the direction is the same and restarts from rest otherwise.
+ */
+void step_stream_move(uint8_t axis, int32_t steps, float max_speed, float acceleration);
+
+/**
+ * Moves to absolute position, blending from the current speed. A ramped axis
+ * that would have to reverse, or is too close to stop in time, ramps to rest
+ * past it and comes back.
+ */
+void step_stream_move_to(uint8_t axis, int32_t position, float max_speed, float acceleration);
+
+/**
+ * Changes the speed limit and acceleration of the running motion; a ramped axis
+ * ramps to a new limit rather than jumping.
+ */
+void step_stream_set_profile(uint8_t axis, float max_speed, float acceleration);
+
+/**
+ * Runs in direction until stopped, or for time_ms (0 = until stopped) counting
+ * both ramps: the ramp down starts so that the axis is at rest when it is up.
+ */
+void step_stream_run(uint8_t axis, Direction direction, float max_speed, float acceleration, uint32_t time_ms);
+
+/**
+ * Stops the axis, along its ramp when ramp is set and it has one, else at once.
+ */
+void step_stream_stop(uint8_t axis, bool ramp);
+
+/**
+ * Redefines the position of an axis at rest, from the next buffer on. Returns
+ * false if it moves or has a command pending.
+ */
+bool step_stream_set_position(uint8_t axis, int32_t position);
+
+int64_t step_stream_position(uint8_t axis);
+
+/**
+ * Returns the signed steps the current positioning move has left (0 otherwise).
+ */
+int32_t step_stream_remaining(uint8_t axis);
+
+/**
+ * Returns the signed speed in steps/second (negative = CCW).
+ */
+float step_stream_speed(uint8_t axis);
+
+/**
+ * Returns the motion the axis executes, including a command not yet picked up.
+ */
+StepperMotionState step_stream_state(uint8_t axis);
+
+/**
+ * Returns how often the DMA queue ran dry since the previous call (the bus then
+ * idles and motion stretches), and restarts the count.
+ */
+uint32_t step_stream_take_underruns();
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+// Step timing of the parallel step stream (step_stream.h): turns each axis'
+// commands into STEP words of a DMA buffer. Pure logic with no Arduino includes
+// so tools/step_stream_sim can check pulse widths and ramps on the host.
+//
+// A sample is one bus word. Sample times count from the start of the stream
+// and wrap; compare them as signed differences.
+
+// The values of StepperMotionState, which lives in an Arduino header.
+enum class StreamState : uint8_t {
+	IDLE = 0,
+	POSITIONING = 1,
+	TIMED_RUN = 2,
+	CONTINUOUS = 3,
+};
+
+struct StreamTiming {
+	uint32_t sample_hz;          // bus words per second
+	uint16_t buffer_samples;     // words per DMA buffer
+	uint16_t pulse_samples;      // STEP high time; the low time after it is at least as long
+	uint16_t dir_setup_samples;  // words between a DIR change and the next STEP
+	uint8_t bus_width;           // 8 or 16 bits per word
+};
+
+struct StreamCommand {
+	bool pending;
+	StreamState state;           // IDLE = stop
+	bool ramp;                   // stop along the ramp
+	bool absolute;               // POSITIONING to target, resolved against the position when picked up;
+	                             // IDLE: redefine the position of the axis at rest as target
+	bool retune;                 // only change the profile of the running motion
+	int32_t steps;               // POSITIONING; on a stop, the steps of a move it cancelled before it started
+	int32_t target;
+	int8_t direction;
+	float max_speed;
+	float acceleration;          // <= 0 = no ramp
+	uint32_t time_ms;
+};
+
+// Owned by whoever fills the buffers.
+struct StreamAxis {
+	StreamState state;
+	bool ramp;
+	bool stopping;               // ramping down to rest
+	int8_t direction;            // 1 = CW
+	int64_t position;
+	int64_t target;              // of the last positioning move
+	int32_t ramp_steps;          // steps taken up the ramp, also the steps needed to stop
+	float acceleration;
+	float interval;              // samples to the next step
+	float min_interval;          // at max speed
+	float first_interval;
+	float carry;                 // fraction of a sample next_sample is early by
+	uint32_t next_sample;
+	uint32_t end_sample;         // TIMED_RUN
+	uint16_t pulse_carry;        // words of the last STEP pulse left for the next buffer
+};
+
+struct StreamStatus {
+	StreamState state;
+	int64_t position;
+	int32_t remaining;           // signed steps of a positioning move, 0 for runs and at rest
+	float speed;                 // steps/second, negative = CCW
+};
+
+/**
+ * Applies a pending command at the buffer boundary now. A ramped axis that has
+ * to reverse, or cannot stop at an absolute target in time, ramps to rest first
+ * and the command stays pending until it is.
+ */
+void step_stream_fill_command(StreamAxis &axis, StreamCommand &command, const StreamTiming &timing, uint32_t now);
+
+/**
+ * Sets every word of buffer to the DIR bits of axes[0..count), STEP low.
+ */
+void step_stream_fill_clear(const StreamAxis *axes, uint8_t count, const StreamTiming &timing, void *buffer);
+
+/**
+ * Writes the STEP pulses of axis index that fall in the buffer starting at
+ * sample start, advancing the axis along its ramp. A pulse that crosses the end
+ * of the buffer finishes at the start of the next one.
+ */
+void step_stream_fill_axis(StreamAxis &axis, uint8_t index, const StreamTiming &timing, uint32_t start,
+                           void *buffer);
+
+StreamStatus step_stream_fill_status(const StreamAxis &axis, const StreamTiming &timing);
@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include "defines.h"
+#include "motion_profile.h"
 
 struct StepperMove {
 	uint8_t motor_number;
@@ -9,8 +10,49 @@ struct StepperMove {
 	Direction direction;
 };
 
+// One row of a per-move profile table, see stepper_set_profile_table().
+struct StepperProfileEntry {
+	uint8_t motor_number;
+	int32_t steps;
+	float max_speed;     // steps/second
+	float acceleration;  // steps/second^2
+};
+
+enum class StepperMotionState : uint8_t {
+	IDLE = 0,
+	POSITIONING = 1,
+	TIMED_RUN = 2,
+	CONTINUOUS = 3,
+};
+
+struct StepperStallEvent {
+	uint8_t motor_number;
+	int32_t commanded_position;  // steps, before correction
+	int32_t encoder_position;    // steps, the position the axis was corrected to
+	int32_t following_error;     // commanded - encoder, steps
+	uint8_t retry;               // retries already spent on this command
+	bool gave_up;                // retries exhausted, axis stopped and faulted
+};
+
+using StepperStallCallback = void (*)(const StepperStallEvent &event);
+
+enum class StepperTriggerCondition : uint8_t {
+	CROSS_POSITION = 0,  // commanded position reaches or passes `position`
+	DECEL_START = 1,     // the next move starts decelerating (or ends, without ramps)
+};
+
+using StepperTriggerCallback = void (*)(void *arg);
+
+/**
+ * Drives the stepper EN, STEP and DIR pins to their idle levels with drivers
+ * disabled. Cheap and safe to call before stepper_init(), e.g. right after reset.
+ */
+void stepper_safe_state();
+
 /**
- * Initializes stepper drivers.
+ * Initializes stepper drivers, and the parallel step stream when the build has
+ * STEPPER_STREAM_AXES (motor numbers STEPPER_GPIO_AXES + 1 and up, see step_stream.h).
+ * Stream axes take the same commands; they have no encoder, stall detection or triggers.
  */
 void stepper_init();
 
@@ -20,7 +62,9 @@ void stepper_init();
 void stepper_service();
 
 /**
- * Sets shared speed profile for all three steppers.
+ * Sets shared speed profile for all steppers. Running moves take the new speed
+ * and acceleration at once, ramping to a lower speed; switching ramping on or
+ * off applies from each motor's next command.
  * @param speed steps/second
  * @param acceleration steps/second^2, or -1 to disable ramping (instant speed changes)
  * @param deceleration steps/second^2, or -1 to disable ramping (instant speed changes)
@@ -33,7 +77,17 @@ void steppr_set_config(float speed, float acceleration, float deceleration);
 void stepper_set_config(float speed, float acceleration, float deceleration);
 
 /**
- * Runs a motor for a given time in milliseconds (non-blocking).
+ * Installs a per-move profile table, e.g. the one tools/profile_tuner generates
+ * into stepper_profile_table.h. A step run whose motor and step count match an
+ * entry runs with that entry's speed and acceleration; everything else uses the
+ * stepper_set_config() profile. The table must outlive its use; nullptr clears it.
+ */
+void stepper_set_profile_table(const StepperProfileEntry *table, uint8_t count);
+
+/**
+ * Runs a motor for a given time in milliseconds (non-blocking), ramps included:
+ * with ramping enabled it ramps up and starts down in time to be at rest when
+ * time_ms is up, so a run too short for max speed never reaches it.
  */
 void stepper_run_ms(uint8_t motor_number, uint32_t time_ms, Direction direction);
 
@@ -44,19 +98,62 @@ void stepper_run_steps(uint8_t motor_number, int32_t steps, Direction direction)
 
 /**
  * Runs a motor for a given number of steps and blocks until target is reached.
+ * If the axis gives up on a stall it keeps waiting: the stall callback is
+ * expected to set g_paused, and resuming finishes the steps that were left.
  */
 void stepper_run_steps_blocking(uint8_t motor_number, int32_t steps, Direction direction);
 
 /**
- * Starts multiple step runs together and blocks until all of them are complete.
+ * Starts multiple step runs together and blocks until all of them are complete,
+ * including after a stall give-up, as stepper_run_steps_blocking().
  */
 void stepper_run_steps_batch_blocking(const StepperMove *moves, uint8_t move_count);
 
 /**
- * Runs a motor continuously until explicitly stopped (non-blocking).
+ * Runs a motor continuously until explicitly stopped (non-blocking), ramping up
+ * to max speed from the speed it has.
  */
 void stepper_run_infinite(uint8_t motor_number, Direction direction);
 
+/**
+ * Ramps a motor to a signed speed in steps/second (negative = CCW, clamped to max
+ * speed) and holds it until stopped; 0 ramps it to rest. Calling it again on the
+ * running motor changes speed, or direction through zero, without a stop command.
+ */
+void stepper_run_velocity(uint8_t motor_number, float speed);
+
+/**
+ * Sends a motor to an absolute position, starting from rest or retargeting the
+ * move in progress without stopping: the ramp continues from the current speed,
+ * and a target too close or behind is reached by decelerating past it and coming
+ * back. Returns false for a continuous or timed run with ramping enabled, which
+ * has no positioning ramp to blend from, and for a position beyond 2^31 steps
+ * of the motor's current one; stop it first.
+ */
+bool stepper_move_to(uint8_t motor_number, int32_t position);
+
+/**
+ * Changes the max speed (steps/second) and acceleration (steps/second^2) of the
+ * motor's running move in place, ramping down to a lower speed; without ramps
+ * the new speed applies at once. The next command picks its profile as usual.
+ */
+void stepper_set_move_profile(uint8_t motor_number, float max_speed, float acceleration);
+
+/**
+ * Pause support for executors that wait on their own. Brings the motors in
+ * motor_mask (bit 0 = motor 1) to rest together along their decel ramps, servicing
+ * them until they stop, and stores the signed steps each step run had left.
+ * Speed-driven motion without a ramp stops at once.
+ */
+void stepper_hold(uint16_t motor_mask, int32_t remaining[STEPPER_MOTOR_COUNT]);
+
+/**
+ * Restarts the held step runs of motor_mask in the same pass, each for its
+ * remaining steps along a fresh ramp from rest. Faster axes run a scaled-down
+ * profile so they all take as long as the slowest one and arrive together.
+ */
+void stepper_resume(uint16_t motor_mask, const int32_t remaining[STEPPER_MOTOR_COUNT]);
+
 /**
  * Immediately stops one stepper.
  */
@@ -68,11 +165,110 @@ void stepper_stop(uint8_t motor_number);
 void stepper_all_stop();
 
 /**
- * Returns tracked current position in steps.
+ * Returns tracked current position in steps, the low 32 bits of
+ * stepper_get_position_64() for a motor that ran past them.
  */
 int32_t stepper_get_position(uint8_t motor_number);
 
+/**
+ * Returns tracked current position in steps; does not wrap on long continuous runs.
+ */
+int64_t stepper_get_position_64(uint8_t motor_number);
+
+/**
+ * Declares that a motor at rest is at position, e.g. restored from a checkpoint.
+ * Returns false while it moves.
+ */
+bool stepper_set_position(uint8_t motor_number, int32_t position);
+
+/**
+ * Returns current signed speed in steps/second (negative = CCW).
+ */
+float stepper_get_speed(uint8_t motor_number);
+
+/**
+ * Returns which kind of motion a motor is executing.
+ */
+StepperMotionState stepper_get_motion_state(uint8_t motor_number);
+
+/**
+ * Arms a one-shot trigger that runs callback(arg) from stepper_service() on the
+ * step that satisfies condition. CROSS_POSITION fires when the axis reaches
+ * position from the side it is on when armed (immediately if already there).
+ * Keep the callback short; it runs between steps. release(arg), if given, runs
+ * instead when the trigger is disarmed unfired, so the owner of arg can reclaim
+ * it. Returns false when all STEPPER_MAX_TRIGGERS slots are armed. See
+ * motion_trigger.h for ready-made actions.
+ */
+bool stepper_arm_trigger(uint8_t motor_number, StepperTriggerCondition condition, int32_t position,
+                         StepperTriggerCallback callback, void *arg, StepperTriggerCallback release = nullptr);
+
+/**
+ * Disarms every trigger of one motor without firing it and runs their release callbacks.
+ */
+void stepper_disarm_triggers(uint8_t motor_number);
+
+/**
+ * Returns the longest gap between stepper_service() calls while any axis was
+ * moving since the previous call, in microseconds, and restarts the measurement.
+ * Steps cannot be emitted more precisely than this, so it bounds step jitter.
+ */
+uint32_t stepper_take_max_service_gap_us();
+
+/**
+ * Registers a callback for stall events. It runs inside stepper_service(), keep it short.
+ * On a stall the axis position is corrected to the encoder and the command is
+ * retried at STEPPER_STALL_RETRY_SPEED_FACTOR of max speed, up to
+ * STEPPER_STALL_MAX_RETRIES times before the axis stops and is flagged faulted.
+ * A step move that gave up keeps what it had left; the next stepper_hold() of
+ * the axis returns it with the rest, so a pause and resume completes the move.
+ */
+void stepper_set_stall_callback(StepperStallCallback callback);
+
+/**
+ * Returns true if the motor has an encoder attached (PIN_S_Mx_ENC_A/B set).
+ */
+bool stepper_has_encoder(uint8_t motor_number);
+
+/**
+ * Returns the encoder-measured position in steps (commanded position without an encoder).
+ */
+int32_t stepper_get_encoder_position(uint8_t motor_number);
+
+/**
+ * Returns the last measured following error (commanded - encoder) in steps.
+ */
+int32_t stepper_get_following_error(uint8_t motor_number);
+
+/**
+ * Returns true if the last command gave up after repeated stalls. Cleared by the next command.
+ */
+bool stepper_is_faulted(uint8_t motor_number);
+
+/**
+ * Returns true while a move that gave up on a stall still has steps left for
+ * stepper_hold() to hand back.
+ */
+bool stepper_has_stalled_move(uint8_t motor_number);
+
 /**
  * Enables or disables all stepper drivers through shared EN pin.
  */
 void stepper_enable(bool enabled);
+
+/**
+ * Returns the speed profile moves currently run with (from stepper_set_config()).
+ */
+MotionProfile stepper_get_profile();
+
+/**
+ * Predicts how long stepper_run_steps() takes for |steps| under profile, in microseconds.
+ * Constant time: evaluates the trapezoid/triangle/no-ramp model the engine runs,
+ * including AccelStepper's ramp discretization. Pass stepper_get_profile() for the active config.
+ */
+uint32_t stepper_estimate_move_us(uint8_t motor_number, int32_t steps, const MotionProfile &profile);
+
+/**
+ * Predicts how long stepper_run_steps_batch_blocking() takes (its longest move), in microseconds.
+ */
+uint32_t stepper_estimate_batch_us(const StepperMove *moves, uint8_t move_count, const MotionProfile &profile);
@@ -0,0 +1,15 @@
+#pragma once
+
+// Generated by tools/profile_tuner from machine_loop.seq and machine_axes.cfg.
+// Do not edit; rerun the tuner after changing the sequence or the axis limits.
+
+#include "stepper_motor.h"
+
+const StepperProfileEntry kStepperProfileTable[] = {
+  {1, 5000, 6536.0f, 10858.0f},  // Task2, Task6: 1348.6 ms (config 1549.1 ms)
+  {2, 2500, 5338.0f, 11397.0f},  // Task3, Task7: 909.8 ms (config 1086.0 ms)
+  {3, 5000, 6536.0f, 10858.0f},  // Task7, Task9: 1348.6 ms (config 1549.1 ms)
+};
+
+constexpr uint8_t kStepperProfileTableCount =
+    static_cast<uint8_t>(sizeof(kStepperProfileTable) / sizeof(kStepperProfileTable[0]));
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include "telemetry_frame.h"
+
+/**
+ * Starts sampling all axes and outputs at rate_hz (1..TELEMETRY_MAX_RATE_HZ).
+ * Samples are packed into double-buffered TelemetryFrames and written to Serial
+ * (USB CDC) by a low-priority task on core 0; a frame is dropped rather than
+ * ever blocking the sampler. Decode on the host with tools/telemetry_decode.
+ * Returns false for an out-of-range rate.
+ */
+bool telemetry_start(uint16_t rate_hz);
+
+/**
+ * Stops sampling and flushes the partially filled frame.
+ */
+void telemetry_stop();
+
+bool telemetry_is_running();
+
+/**
+ * Frames dropped because the writer had not finished the previous one.
+ */
+uint32_t telemetry_dropped_frames();
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wire format of the telemetry stream. Shared with tools/telemetry_decode.cpp,
+// so keep it free of Arduino includes. All fields are little-endian.
+
+constexpr uint16_t TELEMETRY_FRAME_MAGIC = 0x5AA5;
+constexpr uint8_t TELEMETRY_FRAME_VERSION = 2;
+constexpr uint8_t TELEMETRY_SAMPLES_PER_FRAME = 32;
+constexpr uint8_t TELEMETRY_STEPPER_COUNT = 3;
+constexpr uint8_t TELEMETRY_DC_COUNT = 3;
+
+// Two bits per stepper in TelemetrySample::stepper_states (StepperMotionState values).
+constexpr uint8_t TELEMETRY_STEPPER_STATE_BITS = 2;
+
+// TelemetrySample::output_flags
+constexpr uint8_t TELEMETRY_FLAG_DC_CCW_SHIFT = 0;  // bit 0..2: DC direction is CCW
+constexpr uint8_t TELEMETRY_FLAG_DC_EN_SHIFT = 3;   // bit 3..5: DC driver EN is high
+constexpr uint8_t TELEMETRY_FLAG_RELAY = 1 << 6;    // solenoid relay is ON
+constexpr uint8_t TELEMETRY_FLAG_PAUSED = 1 << 7;   // g_paused was set
+
+struct __attribute__((packed)) TelemetrySample {
+	uint32_t timestamp_us;                          // esp_timer time the state was captured, wraps every ~71 min
+	int32_t position[TELEMETRY_STEPPER_COUNT];      // steps
+	int16_t speed[TELEMETRY_STEPPER_COUNT];         // steps/second, saturated
+	uint8_t stepper_states;
+	uint8_t dc_duty[TELEMETRY_DC_COUNT];            // applied PWM duty, 0 when stopped
+	uint16_t dc_current_ma[TELEMETRY_DC_COUNT];     // filtered load current, 0 when not sensed, saturated
+	uint8_t output_flags;
+};
+
+struct __attribute__((packed)) TelemetryFrameHeader {
+	uint16_t magic;
+	uint8_t version;
+	uint8_t sample_count;                           // valid entries in samples[]
+	uint32_t sequence;                              // frame counter, gaps mean lost frames
+	uint16_t rate_hz;
+	uint16_t dropped_frames;                        // frames dropped on-device since start, saturated
+};
+
+struct __attribute__((packed)) TelemetryFrame {
+	TelemetryFrameHeader header;
+	TelemetrySample samples[TELEMETRY_SAMPLES_PER_FRAME];
+	uint16_t crc;                                   // crc16_ccitt() over header and samples
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Flight-recorder event trace. Each core appends to its own ring with a
+// single atomic increment and a 16-byte store, so recording is safe from any
+// task or ISR and costs well under a microsecond. Events carry the 64-bit
+// esp_timer time, which is shared by both cores and does not wrap, so a trace
+// may span any length of time. The ring keeps the newest TRACE_RING_EVENTS
+// per core; dump it with trace_dump() and convert the text with
+// tools/trace_to_chrome for chrome://tracing or ui.perfetto.dev.
+
+enum class TraceEvent : uint8_t {
+	LOOP_CYCLE = 0,
+	STEPPER_MOVE,     // arg = target position
+	DC_RUN,           // arg = duty
+	SOLENOID_ON,
+	BUTTON,           // arg = ButtonId << 1 | pressed
+	PAUSE,
+	RESUME,
+	STALL,            // arg = following error
+	LED_SHOW,
+	COUNT,
+};
+
+// Begin/end pairs on a core's own track must nest; actuator activity that
+// overlaps across tasks goes on its own track.
+enum class TraceTrack : uint8_t {
+	CORE = 0,
+	STEPPER_1,
+	STEPPER_2,
+	STEPPER_3,
+	DC_3000,
+	DC1_300,
+	DC2_300,
+	SOLENOID,
+	COUNT,
+};
+
+void trace_start();
+void trace_stop();
+bool trace_is_running();
+
+void trace_begin(TraceEvent event, TraceTrack track = TraceTrack::CORE, int32_t arg = 0);
+void trace_end(TraceEvent event, TraceTrack track = TraceTrack::CORE, int32_t arg = 0);
+void trace_instant(TraceEvent event, TraceTrack track = TraceTrack::CORE, int32_t arg = 0);
+
+/**
+ * Writes both rings as text, oldest event first. Recording is suspended for
+ * the duration of the dump and resumes afterwards if it was running.
+ */
+void trace_dump(Print &out);
@@ -0,0 +1,261 @@
+#include "benchmark.h"
+
+#include <esp_timer.h>
+#include <math.h>
+
+#include "dc_motor.h"
+#include "defines.h"
+#include "main.h"
+#include "stepper_motor.h"
+
+namespace {
+// The battery measures the AccelStepper service loop, so it covers the GPIO axes only.
+constexpr uint8_t ALL_AXES = (1U << STEPPER_GPIO_AXES) - 1;
+
+volatile bool g_requested = false;
+volatile uint32_t g_pauseKeyUs = 0;
+volatile bool g_pauseKeySeen = false;
+bool g_forward = true;
+bool g_aborted = false;
+
+struct PeriodStats {
+  float meanUs;
+  float stddevUs;
+  uint32_t maxUs;
+};
+
+uint32_t now_us() {
+  return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+bool axes_idle(uint8_t mask) {
+  for (uint8_t motor = 1; motor <= STEPPER_GPIO_AXES; ++motor) {
+    if ((mask & (1U << (motor - 1))) && stepper_get_motion_state(motor) != StepperMotionState::IDLE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A pause during the battery stops it; the machine is left at rest.
+bool check_abort() {
+  if (g_paused && !g_aborted) {
+    g_aborted = true;
+    stepper_all_stop();
+    dc_stop_all();
+  }
+  return g_aborted;
+}
+
+// Runs the axes in mask at rate without ramps and returns the step rate they achieved.
+float run_rate_trial(uint8_t mask, float rate) {
+  stepper_set_config(rate, -1.0f, -1.0f);
+  const int32_t steps = static_cast<int32_t>(rate * static_cast<float>(BENCH_TRIAL_MS) / 1000.0f);
+  const Direction direction = g_forward ? Direction::CW : Direction::CCW;
+  g_forward = !g_forward;
+
+  const uint32_t start = now_us();
+  for (uint8_t motor = 1; motor <= STEPPER_GPIO_AXES; ++motor) {
+    if (mask & (1U << (motor - 1))) {
+      stepper_run_steps(motor, steps, direction);
+    }
+  }
+  while (!axes_idle(mask)) {
+    stepper_service();
+    if (check_abort()) {
+      return 0.0f;
+    }
+  }
+  const uint32_t elapsed = now_us() - start;
+  return (elapsed > 0) ? static_cast<float>(steps) * 1e6f / static_cast<float>(elapsed) : 0.0f;
+}
+
+// Doubles the rate until an axis falls behind, then bisects between the last
+// sustained and the first failed rate.
+float find_max_step_rate(uint8_t mask) {
+  float good = 0.0f;
+  float bad = BENCH_MAX_STEP_RATE;
+  for (float rate = BENCH_MIN_STEP_RATE; rate <= BENCH_MAX_STEP_RATE; rate *= 2.0f) {
+    if (run_rate_trial(mask, rate) >= rate * BENCH_RATE_TOLERANCE) {
+      good = rate;
+    } else {
+      bad = rate;
+      break;
+    }
+    if (g_aborted) {
+      return 0.0f;
+    }
+  }
+  for (uint8_t i = 0; i < 6 && good > 0.0f && bad - good > good * 0.02f; ++i) {
+    const float rate = 0.5f * (good + bad);
+    if (run_rate_trial(mask, rate) >= rate * BENCH_RATE_TOLERANCE) {
+      good = rate;
+    } else {
+      bad = rate;
+    }
+    if (g_aborted) {
+      return 0.0f;
+    }
+  }
+  return good;
+}
+
+// Measures the time between stepper_service() calls in a tight loop, optionally
+// with every axis stepping at rate.
+PeriodStats measure_service_period(float rate) {
+  if (rate > 0.0f) {
+    stepper_set_config(rate, -1.0f, -1.0f);
+    for (uint8_t motor = 1; motor <= STEPPER_GPIO_AXES; ++motor) {
+      stepper_run_infinite(motor, g_forward ? Direction::CW : Direction::CCW);
+    }
+  }
+
+  double sum = 0.0;
+  double sumSquares = 0.0;
+  uint32_t count = 0;
+  uint32_t maxUs = 0;
+  const uint32_t start = now_us();
+  uint32_t last = start;
+  while (now_us() - start < BENCH_SERVICE_SAMPLE_MS * 1000UL && !check_abort()) {
+    stepper_service();
+    const uint32_t now = now_us();
+    const uint32_t period = now - last;
+    last = now;
+    sum += period;
+    sumSquares += static_cast<double>(period) * period;
+    maxUs = (period > maxUs) ? period : maxUs;
+    ++count;
+  }
+
+  if (rate > 0.0f) {
+    stepper_all_stop();
+    g_forward = !g_forward;
+  }
+
+  PeriodStats stats = {0.0f, 0.0f, maxUs};
+  if (count > 0) {
+    const double mean = sum / count;
+    stats.meanUs = static_cast<float>(mean);
+    stats.stddevUs = static_cast<float>(sqrt(fmax(0.0, sumSquares / count - mean * mean)));
+  }
+  return stats;
+}
+
+// Times BENCH_DC_RUNS timed runs from start to PWM off against the commanded length.
+void measure_dc_end_error(DcMotorId motor, float &meanUs, int32_t &worstUs) {
+  int64_t sum = 0;
+  worstUs = 0;
+  for (uint8_t run = 0; run < BENCH_DC_RUNS && !check_abort(); ++run) {
+    const uint32_t start = now_us();
+    dc_run_ms({motor, BENCH_DC_RUN_MS, BENCH_DC_DUTY, Direction::CW, DcStopMode::COAST});
+    while (dc_get_status(motor).running && !check_abort()) {
+    }
+    const int32_t error = static_cast<int32_t>(now_us() - start) - static_cast<int32_t>(BENCH_DC_RUN_MS * 1000UL);
+    sum += error;
+    if (abs(error) > abs(worstUs)) {
+      worstUs = error;
+    }
+    delay(50);
+  }
+  meanUs = static_cast<float>(sum) / BENCH_DC_RUNS;
+}
+
+// Runs a DC motor and waits for the operator to press B; reports how long after
+// the key event the loop saw g_paused and the PWM went off.
+bool measure_pause_latency(Print &out, uint32_t &seenUs, uint32_t &offUs) {
+  out.println("[BENCH] press B (pause) now");
+  g_pauseKeySeen = false;
+  dc_run_ms({DcMotorId::M1_300, BENCH_PAUSE_WAIT_MS, BENCH_DC_DUTY, Direction::CW, DcStopMode::COAST});
+
+  const uint32_t start = now_us();
+  while (!g_paused) {
+    stepper_service();
+    if (now_us() - start > BENCH_PAUSE_WAIT_MS * 1000UL) {
+      dc_stop_all();
+      return false;
+    }
+  }
+  const uint32_t seen = now_us();
+  while (dc_get_status(DcMotorId::M1_300).running && now_us() - seen < 1000000UL) {
+  }
+  const uint32_t off = now_us();
+
+  dc_stop_all();
+  g_paused = false;
+  if (!g_pauseKeySeen) {
+    return false;
+  }
+  seenUs = seen - g_pauseKeyUs;
+  offUs = off - g_pauseKeyUs;
+  return true;
+}
+}  // namespace
+
+void benchmark_request() {
+  g_requested = true;
+}
+
+bool benchmark_take_request() {
+  const bool requested = g_requested;
+  g_requested = false;
+  return requested;
+}
+
+void benchmark_mark_pause() {
+  g_pauseKeyUs = now_us();
+  g_pauseKeySeen = true;
+}
+
+void benchmark_run(Print &out) {
+  const MotionProfile profile = stepper_get_profile();
+  g_aborted = false;
+  g_paused = false;
+  out.println("[BENCH] running, press B to abort");
+
+  float axisRate[STEPPER_GPIO_AXES] = {};
+  for (uint8_t motor = 1; motor <= STEPPER_GPIO_AXES && !g_aborted; ++motor) {
+    axisRate[motor - 1] = find_max_step_rate(1U << (motor - 1));
+  }
+  const float allRate = g_aborted ? 0.0f : find_max_step_rate(ALL_AXES);
+
+  const PeriodStats idle = measure_service_period(0.0f);
+  const PeriodStats moving = measure_service_period(0.5f * allRate);
+
+  float dcMean[3] = {};
+  int32_t dcWorst[3] = {};
+  for (uint8_t motor = 0; motor < 3 && !g_aborted; ++motor) {
+    measure_dc_end_error(static_cast<DcMotorId>(motor), dcMean[motor], dcWorst[motor]);
+  }
+
+  uint32_t pauseSeenUs = 0;
+  uint32_t pauseOffUs = 0;
+  const bool pauseMeasured = !g_aborted && measure_pause_latency(out, pauseSeenUs, pauseOffUs);
+
+  stepper_set_config(profile.max_speed, profile.no_ramp ? -1.0f : profile.acceleration,
+                     profile.no_ramp ? -1.0f : profile.deceleration);
+
+  out.printf("# bench v1 build %s %s cpu_mhz %lu\n", __DATE__, __TIME__,
+             static_cast<unsigned long>(getCpuFrequencyMhz()));
+  if (g_aborted) {
+    out.println("aborted 1");
+  }
+  for (uint8_t index = 0; index < STEPPER_GPIO_AXES; ++index) {
+    out.printf("step_rate_max axis %u %.0f\n", index + 1, axisRate[index]);
+  }
+  out.printf("step_rate_max all %.0f\n", allRate);
+  out.printf("service_period_us idle mean %.2f stddev %.2f max %lu\n", idle.meanUs, idle.stddevUs,
+             static_cast<unsigned long>(idle.maxUs));
+  out.printf("service_period_us moving mean %.2f stddev %.2f max %lu\n", moving.meanUs, moving.stddevUs,
+             static_cast<unsigned long>(moving.maxUs));
+  for (uint8_t motor = 0; motor < 3; ++motor) {
+    out.printf("dc_end_error_us motor %u mean %.0f worst %ld\n", motor, dcMean[motor],
+               static_cast<long>(dcWorst[motor]));
+  }
+  if (pauseMeasured) {
+    out.printf("pause_latency_us seen %lu dc_off %lu\n", static_cast<unsigned long>(pauseSeenUs),
+               static_cast<unsigned long>(pauseOffUs));
+  } else {
+    out.println("pause_latency_us none");
+  }
+  out.println("# end");
+}
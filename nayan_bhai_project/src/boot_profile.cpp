@@ -0,0 +1,60 @@
+#include "boot_profile.h"
+
+#include <esp_system.h>
+
+#include "defines.h"
+
+namespace {
+struct BootMark {
+  const char *phase;
+  uint32_t timeUs;
+  uint8_t core;
+};
+
+BootMark g_marks[BOOT_PROFILE_MAX_MARKS];
+uint32_t g_markCount = 0;
+
+const char *reset_reason_name(esp_reset_reason_t reason) {
+  switch (reason) {
+    case ESP_RST_POWERON:   return "power-on";
+    case ESP_RST_EXT:       return "external pin";
+    case ESP_RST_SW:        return "software";
+    case ESP_RST_PANIC:     return "panic";
+    case ESP_RST_INT_WDT:   return "interrupt watchdog";
+    case ESP_RST_TASK_WDT:  return "task watchdog";
+    case ESP_RST_WDT:       return "other watchdog";
+    case ESP_RST_DEEPSLEEP: return "deep sleep";
+    case ESP_RST_BROWNOUT:  return "brownout";
+    case ESP_RST_SDIO:      return "SDIO";
+    default:                return "unknown";
+  }
+}
+}  // namespace
+
+void boot_mark(const char *phase) {
+  const uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+  const uint32_t slot = __atomic_fetch_add(&g_markCount, 1, __ATOMIC_RELAXED);
+  if (slot >= BOOT_PROFILE_MAX_MARKS) {
+    return;
+  }
+  g_marks[slot].phase = phase;
+  g_marks[slot].timeUs = now;
+  g_marks[slot].core = static_cast<uint8_t>(xPortGetCoreID());
+}
+
+void boot_report(Print &out) {
+  const uint32_t count = (g_markCount < BOOT_PROFILE_MAX_MARKS) ? g_markCount : BOOT_PROFILE_MAX_MARKS;
+
+  out.printf("[BOOT] reset reason: %s\n", reset_reason_name(esp_reset_reason()));
+  uint32_t previousUs = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const BootMark &mark = g_marks[i];
+    out.printf("[BOOT] %8.2f ms  +%7.2f ms  core%u  %s\n", static_cast<float>(mark.timeUs) / 1000.0f,
+               static_cast<float>(mark.timeUs - previousUs) / 1000.0f, mark.core, mark.phase);
+    previousUs = mark.timeUs;
+  }
+  if (g_markCount > BOOT_PROFILE_MAX_MARKS) {
+    out.printf("[BOOT] %lu marks dropped (BOOT_PROFILE_MAX_MARKS)\n",
+               static_cast<unsigned long>(g_markCount - BOOT_PROFILE_MAX_MARKS));
+  }
+}
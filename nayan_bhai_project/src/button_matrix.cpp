@@ -4,6 +4,8 @@
 #include "defines.h"
 
 namespace {
+static_assert((BUTTON_EVENT_RING & (BUTTON_EVENT_RING - 1)) == 0, "BUTTON_EVENT_RING must be a power of two");
+constexpr uint8_t BUTTON_COUNT = static_cast<uint8_t>(ButtonId::UNKNOWN);
 
 // Physical keypad character map.
 // The Keypad library drives our COL pins (C0..C3) one-at-a-time LOW and reads our ROW pins (R0..R3).
@@ -37,7 +39,33 @@ byte libColPins[LIBCOLS] = {
 
 Keypad keypad = Keypad(makeKeymap(keymap), libRowPins, libColPins, LIBROWS, LIBCOLS);
 
-ButtonEventCallback g_callback = nullptr;
+// Written only by the scan task. `sequence` is the event's publish count (so
+// never 0 once written) and reads 0 while the slot is being rewritten, which
+// lets a reader tell a torn or overwritten slot from the event it expects.
+struct EventSlot {
+  uint32_t sequence;
+  ButtonEvent event;
+};
+
+// Each reader belongs to one consumer, which alone moves its cursor.
+struct Reader {
+  uint32_t cursor;  // publish count of the next event to read
+  uint32_t lost;
+  ButtonEventCallback callback;
+  TaskHandle_t task;  // to notify, set by a subscriber task once it runs
+};
+
+EventSlot g_ring[BUTTON_EVENT_RING] = {};
+uint32_t g_head = 0;  // events published
+Reader g_readers[BUTTON_MAX_READERS] = {};
+uint8_t g_readerCount = 0;
+portMUX_TYPE g_readerMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Scan task state, indexed by ButtonId.
+uint32_t g_pressedAt[BUTTON_COUNT] = {};
+uint16_t g_down = 0;
+uint16_t g_longSent = 0;
+
 TaskHandle_t buttonTaskHandle = nullptr;
 
 ButtonId char_to_button_id(char c) {
@@ -62,30 +90,90 @@ ButtonId char_to_button_id(char c) {
   }
 }
 
+// Single producer: the slot is marked, rewritten and stamped before the head
+// moves past it, then subscriber tasks are woken. Nothing here waits on a reader.
+void publish(ButtonId button, ButtonState state, ButtonId other, uint32_t now) {
+  const uint32_t head = g_head;
+  EventSlot& slot = g_ring[head & (BUTTON_EVENT_RING - 1)];
+  __atomic_store_n(&slot.sequence, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot.event = ButtonEvent{button, state, other, now};
+  __atomic_store_n(&slot.sequence, head + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&g_head, head + 1, __ATOMIC_SEQ_CST);
+
+  const uint8_t count = __atomic_load_n(&g_readerCount, __ATOMIC_ACQUIRE);
+  for (uint8_t i = 0; i < count; ++i) {
+    const TaskHandle_t task = __atomic_load_n(&g_readers[i].task, __ATOMIC_SEQ_CST);
+    if (task != nullptr) {
+      xTaskNotifyGive(task);
+    }
+  }
+}
+
+// A chord pairs the new press with the button that has been down longest.
+ButtonId longest_down(uint32_t now) {
+  ButtonId first = ButtonId::UNKNOWN;
+  uint32_t longest = 0;
+  for (uint8_t id = 0; id < BUTTON_COUNT; ++id) {
+    if ((g_down & (1U << id)) != 0 && (first == ButtonId::UNKNOWN || now - g_pressedAt[id] > longest)) {
+      first = static_cast<ButtonId>(id);
+      longest = now - g_pressedAt[id];
+    }
+  }
+  return first;
+}
+
+void handle_key(const Key& k, uint32_t now) {
+  const ButtonId id = char_to_button_id(k.kchar);
+  if (id == ButtonId::UNKNOWN) {
+    return;
+  }
+  const uint16_t bit = static_cast<uint16_t>(1U << static_cast<uint8_t>(id));
+
+  switch (k.kstate) {
+    case PRESSED: {
+      const ButtonId first = longest_down(now);
+      g_down |= bit;
+      g_pressedAt[static_cast<uint8_t>(id)] = now;
+      publish(id, ButtonState::PRESSED, ButtonId::UNKNOWN, now);
+      if (first != ButtonId::UNKNOWN) {
+        publish(first, ButtonState::CHORD, id, now);
+      }
+      break;
+    }
+    case HOLD:
+      publish(id, ButtonState::HOLD, ButtonId::UNKNOWN, now);
+      break;
+    case RELEASED:
+      g_down &= static_cast<uint16_t>(~bit);
+      g_longSent &= static_cast<uint16_t>(~bit);
+      publish(id, ButtonState::RELEASED, ButtonId::UNKNOWN, now);
+      break;
+    default:
+      break;
+  }
+}
+
 void button_scan_task(void* parameter) {
   (void)parameter;
 
   for (;;) {
-    if (keypad.getKeys() && g_callback != nullptr) {
+    const uint32_t now = millis();
+    if (keypad.getKeys()) {
       for (uint8_t i = 0; i < LIST_MAX; ++i) {
         const Key& k = keypad.key[i];
-
-        if (!k.stateChanged) {
-          continue;
-        }
-
-        // Only fire on PRESSED and RELEASED - ignore HOLD/IDLE
-        if (k.kstate != PRESSED && k.kstate != RELEASED) {
-          continue;
-        }
-
-        const ButtonId id = char_to_button_id(k.kchar);
-        if (id == ButtonId::UNKNOWN) {
-          continue;
+        if (k.stateChanged) {
+          handle_key(k, now);
         }
+      }
+    }
 
-        const ButtonState state = (k.kstate == PRESSED) ? ButtonState::PRESSED : ButtonState::RELEASED;
-        g_callback(ButtonEvent{id, state});
+    // The library has one hold time; long presses are timed here.
+    const uint16_t pending = g_down & static_cast<uint16_t>(~g_longSent);
+    for (uint8_t id = 0; pending != 0 && id < BUTTON_COUNT; ++id) {
+      if ((pending & (1U << id)) != 0 && now - g_pressedAt[id] >= KEY_LONG_PRESS_MS) {
+        g_longSent |= static_cast<uint16_t>(1U << id);
+        publish(static_cast<ButtonId>(id), ButtonState::LONG_PRESS, ButtonId::UNKNOWN, now);
       }
     }
 
@@ -93,6 +181,21 @@ void button_scan_task(void* parameter) {
   }
 }
 
+void subscriber_task(void* parameter) {
+  const int8_t reader = static_cast<int8_t>(reinterpret_cast<intptr_t>(parameter));
+  // Published before the first drain: an event the drain misses finds the
+  // handle set and notifies.
+  __atomic_store_n(&g_readers[reader].task, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+
+  for (;;) {
+    ButtonEvent event;
+    while (button_read(reader, event)) {
+      g_readers[reader].callback(event);
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
 }  // namespace
 
 // --- Public API ---
@@ -119,13 +222,97 @@ const char* button_name(ButtonId id) {
   }
 }
 
-void button_matrix_init(ButtonEventCallback callback) {
-  g_callback = callback;
+const char* button_state_name(ButtonState state) {
+  switch (state) {
+    case ButtonState::PRESSED:     return "PRESSED";
+    case ButtonState::RELEASED:    return "RELEASED";
+    case ButtonState::HOLD:        return "HOLD";
+    case ButtonState::LONG_PRESS:  return "LONG_PRESS";
+    case ButtonState::CHORD:       return "CHORD";
+    default:                       return "UNKNOWN";
+  }
+}
+
+bool button_is_chord(const ButtonEvent& event, ButtonId a, ButtonId b) {
+  return event.state == ButtonState::CHORD &&
+         ((event.button == a && event.other == b) || (event.button == b && event.other == a));
+}
+
+void button_matrix_init() {
   keypad.setDebounceTime(KEY_DEBOUNCE_MS);
-  keypad.setHoldTime(1000);
+  keypad.setHoldTime(KEY_HOLD_MS);
 
   if (buttonTaskHandle == nullptr) {
-    xTaskCreatePinnedToCore(button_scan_task, "button_task", 4096, nullptr, 4, &buttonTaskHandle, 0);
+    xTaskCreatePinnedToCore(button_scan_task, "button_task", 4096, nullptr, BUTTON_TASK_PRIORITY, &buttonTaskHandle,
+                            0);
+  }
+}
+
+int8_t button_open_reader() {
+  portENTER_CRITICAL(&g_readerMux);
+  int8_t reader = -1;
+  if (g_readerCount < BUTTON_MAX_READERS) {
+    reader = static_cast<int8_t>(g_readerCount);
+    g_readers[reader].cursor = __atomic_load_n(&g_head, __ATOMIC_ACQUIRE);
+    g_readers[reader].lost = 0;
+    __atomic_store_n(&g_readerCount, static_cast<uint8_t>(g_readerCount + 1), __ATOMIC_RELEASE);
+  }
+  portEXIT_CRITICAL(&g_readerMux);
+  return reader;
+}
+
+bool button_read(int8_t reader, ButtonEvent& event) {
+  if (reader < 0 || reader >= static_cast<int8_t>(BUTTON_MAX_READERS)) {
+    return false;
+  }
+
+  Reader& state = g_readers[reader];
+  for (;;) {
+    const uint32_t head = __atomic_load_n(&g_head, __ATOMIC_SEQ_CST);
+    if (state.cursor == head) {
+      return false;
+    }
+    if (head - state.cursor > BUTTON_EVENT_RING) {
+      // Lapped: skip to the oldest event still in the ring.
+      state.lost += head - state.cursor - BUTTON_EVENT_RING;
+      state.cursor = head - BUTTON_EVENT_RING;
+    }
+
+    const EventSlot& slot = g_ring[state.cursor & (BUTTON_EVENT_RING - 1)];
+    const uint32_t before = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+    event = slot.event;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    const uint32_t after = __atomic_load_n(&slot.sequence, __ATOMIC_RELAXED);
+    const bool intact = before == state.cursor + 1 && after == before;
+    ++state.cursor;
+    if (intact) {
+      return true;
+    }
+    // Overwritten while reading. Skipping it rather than waiting for the
+    // writer keeps a reader that preempted the scan task from spinning.
+    ++state.lost;
+  }
+}
+
+uint32_t button_take_lost(int8_t reader) {
+  if (reader < 0 || reader >= static_cast<int8_t>(BUTTON_MAX_READERS)) {
+    return 0;
+  }
+  const uint32_t lost = g_readers[reader].lost;
+  g_readers[reader].lost = 0;
+  return lost;
+}
+
+bool button_subscribe(ButtonEventCallback callback, const char* name, UBaseType_t priority) {
+  if (callback == nullptr) {
+    return false;
+  }
+  const int8_t reader = button_open_reader();
+  if (reader < 0) {
+    return false;
   }
+  g_readers[reader].callback = callback;
+  return xTaskCreatePinnedToCore(subscriber_task, name, 3072, reinterpret_cast<void*>(static_cast<intptr_t>(reader)),
+                                 priority, nullptr, 0) == pdPASS;
 }
 
@@ -0,0 +1,166 @@
+#include "console.h"
+
+#include "benchmark.h"
+#include "boot_profile.h"
+#include "current_sense.h"
+#include "dc_motor.h"
+#include "defines.h"
+#include "diagnostics.h"
+#include "station_link.h"
+#include "telemetry.h"
+#include "trace.h"
+
+namespace {
+struct ConsoleCommand {
+  const char *name;
+  const char *usage;
+  void (*handler)(const char *args);
+};
+
+void cmd_help(const char *args);
+
+void cmd_trace(const char *args) {
+  if (strcmp(args, "start") == 0) {
+    trace_start();
+    Serial.println("trace started");
+  } else if (strcmp(args, "stop") == 0) {
+    trace_stop();
+    Serial.println("trace stopped");
+  } else if (strcmp(args, "dump") == 0) {
+    // Binary telemetry frames would interleave with the text dump
+    if (telemetry_is_running()) {
+      Serial.println("stop telemetry first");
+      return;
+    }
+    trace_dump(Serial);
+  } else {
+    Serial.println("usage: trace start|stop|dump");
+  }
+}
+
+void cmd_telemetry(const char *args) {
+  if (strcmp(args, "off") == 0) {
+    telemetry_stop();
+    return;
+  }
+
+  const long rate = strtol(args, nullptr, 10);
+  if (rate <= 0 || rate > TELEMETRY_MAX_RATE_HZ || !telemetry_start(static_cast<uint16_t>(rate))) {
+    Serial.printf("usage: telemetry 1..%u|off\n", TELEMETRY_MAX_RATE_HZ);
+  }
+}
+
+void cmd_boot(const char *args) {
+  (void)args;
+  boot_report(Serial);
+}
+
+void cmd_diag(const char *args) {
+  (void)args;
+  diagnostics_request_report();
+}
+
+void cmd_bench(const char *args) {
+  (void)args;
+  benchmark_request();
+}
+
+void cmd_current(const char *args) {
+  (void)args;
+  current_sense_report(Serial);
+}
+
+void cmd_thermal(const char *args) {
+  (void)args;
+  dc_thermal_report(Serial);
+}
+
+void cmd_link(const char *args) {
+  (void)args;
+  station_link_report(Serial);
+}
+
+const ConsoleCommand kCommands[] = {
+  {"help", "", cmd_help},
+  {"boot", "", cmd_boot},
+  {"diag", "", cmd_diag},
+  {"bench", "", cmd_bench},
+  {"link", "", cmd_link},
+  {"current", "", cmd_current},
+  {"thermal", "", cmd_thermal},
+  {"trace", "start|stop|dump", cmd_trace},
+  {"telemetry", "<hz>|off", cmd_telemetry},
+};
+
+void cmd_help(const char *args) {
+  (void)args;
+  for (const ConsoleCommand &command : kCommands) {
+    Serial.printf("%s %s\n", command.name, command.usage);
+  }
+}
+
+void dispatch(char *line) {
+  char *args = line;
+  while (*args != '\0' && *args != ' ') {
+    ++args;
+  }
+  if (*args == ' ') {
+    *args++ = '\0';
+    while (*args == ' ') {
+      ++args;
+    }
+  }
+
+  if (*line == '\0') {
+    return;
+  }
+
+  for (const ConsoleCommand &command : kCommands) {
+    if (strcmp(line, command.name) == 0) {
+      command.handler(args);
+      return;
+    }
+  }
+  Serial.printf("unknown command '%s' - try help\n", line);
+}
+
+void console_task(void *parameter) {
+  (void)parameter;
+
+  char line[CONSOLE_LINE_MAX + 1];
+  uint8_t length = 0;
+  bool overflow = false;
+
+  for (;;) {
+    while (Serial.available() > 0) {
+      const int c = Serial.read();
+      if (c == '\r') {
+        continue;
+      }
+      if (c != '\n') {
+        if (length < CONSOLE_LINE_MAX) {
+          line[length++] = static_cast<char>(c);
+        } else {
+          overflow = true;
+        }
+        continue;
+      }
+
+      line[length] = '\0';
+      if (overflow) {
+        Serial.println("line too long");
+      } else {
+        dispatch(line);
+      }
+      length = 0;
+      overflow = false;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(20));
+  }
+}
+}  // namespace
+
+void console_init() {
+  xTaskCreatePinnedToCore(console_task, "console", 4096, nullptr, 1, nullptr, 0);
+}
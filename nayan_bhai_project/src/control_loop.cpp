@@ -0,0 +1,115 @@
+#include "control_loop.h"
+
+#include <esp_timer.h>
+
+#include "dc_motor.h"
+#include "defines.h"
+#include "motion_snapshot.h"
+
+namespace {
+hw_timer_t *g_timer = nullptr;
+TaskHandle_t g_task = nullptr;
+
+volatile uint32_t g_periodUs = 0;
+volatile uint32_t g_speedLoopDivider = 1;
+
+ControlLoopStats g_stats = {};
+portMUX_TYPE g_statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void IRAM_ATTR on_timer() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(g_task, &woken);
+  if (woken == pdTRUE) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+void record_tick(uint32_t missed, uint32_t jitterUs, uint32_t workUs, bool overrun) {
+  portENTER_CRITICAL(&g_statsMux);
+  ++g_stats.ticks;
+  g_stats.overruns += missed + (overrun ? 1 : 0);
+  if (jitterUs > g_stats.max_jitter_us) {
+    g_stats.max_jitter_us = jitterUs;
+  }
+  if (workUs > g_stats.max_work_us) {
+    g_stats.max_work_us = workUs;
+  }
+  portEXIT_CRITICAL(&g_statsMux);
+}
+
+void control_task(void *parameter) {
+  (void)parameter;
+
+  uint32_t lastWakeUs = 0;
+  uint32_t speedLoopCount = 0;
+  bool first = true;
+
+  for (;;) {
+    // More than one pending notification means earlier ticks were missed.
+    const uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    const uint32_t wakeUs = static_cast<uint32_t>(esp_timer_get_time());
+    const uint32_t periodUs = g_periodUs;
+
+    uint32_t jitterUs = 0;
+    if (!first) {
+      const int32_t error = static_cast<int32_t>(wakeUs - lastWakeUs) - static_cast<int32_t>(periodUs * pending);
+      jitterUs = static_cast<uint32_t>((error < 0) ? -error : error);
+    }
+    first = false;
+    lastWakeUs = wakeUs;
+
+    dc_service();
+    if (++speedLoopCount >= g_speedLoopDivider) {
+      speedLoopCount = 0;
+      dc_closed_loop_service();
+    }
+    // loop() publishes while it services the steppers; fill in the DC and
+    // solenoid fields when it does not, leaving the steppers to their owner.
+    motion_snapshot_service_outputs(2 * MOTION_SNAPSHOT_PERIOD_US);
+
+    const uint32_t workUs = static_cast<uint32_t>(esp_timer_get_time()) - wakeUs;
+    record_tick(pending - 1, jitterUs, workUs, workUs > periodUs);
+  }
+}
+}  // namespace
+
+bool control_loop_start(uint32_t rate_hz) {
+  if (rate_hz < CONTROL_LOOP_MIN_RATE_HZ || rate_hz > CONTROL_LOOP_MAX_RATE_HZ || rate_hz % DC_SPEED_LOOP_HZ != 0) {
+    return false;
+  }
+
+  g_periodUs = 1000000UL / rate_hz;
+  g_speedLoopDivider = rate_hz / DC_SPEED_LOOP_HZ;
+  portENTER_CRITICAL(&g_statsMux);
+  g_stats.rate_hz = rate_hz;
+  portEXIT_CRITICAL(&g_statsMux);
+
+  if (g_task == nullptr &&
+      xTaskCreatePinnedToCore(control_task, "control", 3072, nullptr, CONTROL_LOOP_TASK_PRIORITY, &g_task, 0) !=
+          pdPASS) {
+    g_task = nullptr;
+    return false;
+  }
+
+  if (g_timer == nullptr) {
+    // 80 MHz APB / 80 = 1 us per count.
+    g_timer = timerBegin(CONTROL_LOOP_HW_TIMER, 80, true);
+    if (g_timer == nullptr) {
+      return false;
+    }
+    timerAttachInterrupt(g_timer, on_timer, false);  // level: the S3 has no edge-triggered timer interrupts
+  }
+
+  timerAlarmWrite(g_timer, g_periodUs, true);
+  timerAlarmEnable(g_timer);
+  return true;
+}
+
+ControlLoopStats control_loop_take_stats() {
+  portENTER_CRITICAL(&g_statsMux);
+  const ControlLoopStats stats = g_stats;
+  g_stats.max_jitter_us = 0;
+  g_stats.max_work_us = 0;
+  portEXIT_CRITICAL(&g_statsMux);
+  return stats;
+}
@@ -0,0 +1,68 @@
+#include "current_monitor.h"
+
+#include <math.h>
+
+void current_monitor_init(CurrentMonitor &monitor, const CurrentMonitorConfig &config) {
+  monitor.config = config;
+  monitor.current_ma = 0.0f;
+  monitor.peak_ma = 0.0f;
+  monitor.run_us = 0;
+  monitor.jam_us = 0;
+  monitor.running = false;
+  monitor.fault = CurrentFault::NONE;
+}
+
+void current_monitor_start(CurrentMonitor &monitor) {
+  monitor.peak_ma = 0.0f;
+  monitor.run_us = 0;
+  monitor.jam_us = 0;
+  monitor.running = true;
+  monitor.fault = CurrentFault::NONE;
+}
+
+void current_monitor_stop(CurrentMonitor &monitor) {
+  monitor.running = false;
+  monitor.jam_us = 0;
+}
+
+CurrentFault current_monitor_update(CurrentMonitor &monitor, float block_ma, uint32_t dt_us) {
+  const CurrentMonitorConfig &config = monitor.config;
+  const float dt = static_cast<float>(dt_us) * 1e-6f;
+  // Exact discretization of the RC low-pass for this block length, so uneven
+  // blocks keep the same corner.
+  const float alpha = (config.filter_hz > 0.0f) ? 1.0f - expf(-2.0f * static_cast<float>(M_PI) * config.filter_hz * dt)
+                                                : 1.0f;
+  monitor.current_ma += alpha * (block_ma - monitor.current_ma);
+
+  if (!monitor.running || monitor.fault != CurrentFault::NONE) {
+    return CurrentFault::NONE;
+  }
+
+  monitor.peak_ma = (block_ma > monitor.peak_ma) ? block_ma : monitor.peak_ma;
+  monitor.run_us += dt_us;
+
+  if (config.overcurrent_ma > 0.0f && block_ma > config.overcurrent_ma) {
+    monitor.fault = CurrentFault::OVERCURRENT;
+    return monitor.fault;
+  }
+
+  const bool overJam = config.jam_ma > 0.0f && monitor.run_us > config.inrush_ms * 1000UL &&
+                       monitor.current_ma > config.jam_ma;
+  monitor.jam_us = overJam ? monitor.jam_us + dt_us : 0;
+  if (overJam && monitor.jam_us >= config.jam_ms * 1000UL) {
+    monitor.fault = CurrentFault::JAM;
+    return monitor.fault;
+  }
+  return CurrentFault::NONE;
+}
+
+const char *current_fault_name(CurrentFault fault) {
+  switch (fault) {
+    case CurrentFault::OVERCURRENT:
+      return "overcurrent";
+    case CurrentFault::JAM:
+      return "jam";
+    default:
+      return "none";
+  }
+}
@@ -0,0 +1,228 @@
+#include "current_sense.h"
+
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include <esp_timer.h>
+
+#include "defines.h"
+
+namespace {
+constexpr uint8_t DC_COUNT = 3;
+constexpr uint8_t ADC1_CHANNELS = 10;
+constexpr uint32_t BLOCK_BYTES = DC_CURRENT_BLOCK_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES;
+
+const gpio_num_t kPins[DC_COUNT] = {PIN_DC_3000_IS, PIN_DC1_300_IS, PIN_DC2_300_IS};
+
+// The monitors belong to the sampling task; g_mux covers their config, which
+// current_sense_set_limits() changes, and the published readings.
+CurrentMonitor g_monitors[DC_COUNT];
+DcCurrent g_published[DC_COUNT] = {};
+bool g_wasRunning[DC_COUNT] = {};
+int8_t g_channelMotor[ADC1_CHANNELS];
+portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+DcCurrentCallback g_callback = nullptr;
+TaskHandle_t g_task = nullptr;
+esp_adc_cal_characteristics_t g_calibration;
+
+// ESP32-S3: ADC1 channel n is on GPIO n + 1.
+int8_t adc1_channel(gpio_num_t pin) {
+  const int number = static_cast<int>(pin);
+  return (number >= 1 && number <= ADC1_CHANNELS) ? static_cast<int8_t>(number - 1) : -1;
+}
+
+float raw_to_ma(uint32_t raw) {
+  const float millivolts = static_cast<float>(esp_adc_cal_raw_to_voltage(raw, &g_calibration));
+  return millivolts * DC_IS_RATIO / DC_IS_RESISTOR_OHM;
+}
+
+CurrentMonitorConfig default_config(uint8_t motor) {
+  const bool is3000 = motor == static_cast<uint8_t>(DcMotorId::M3000);
+  const CurrentMonitorConfig config = {
+      DC_CURRENT_FILTER_HZ,
+      is3000 ? DC_3000_OVERCURRENT_MA : DC_300_OVERCURRENT_MA,
+      is3000 ? DC_3000_JAM_MA : DC_300_JAM_MA,
+      DC_JAM_MS,
+      DC_INRUSH_MS,
+  };
+  return config;
+}
+
+// Runs one block through a motor's monitor and returns the fault it raised.
+CurrentFault update_motor(uint8_t motor, float blockMa, uint32_t dtUs, DcCurrentEvent &event) {
+  const bool running = dc_get_status(static_cast<DcMotorId>(motor)).running;
+
+  portENTER_CRITICAL(&g_mux);
+  CurrentMonitor &monitor = g_monitors[motor];
+  if (running && !g_wasRunning[motor]) {
+    current_monitor_start(monitor);
+  } else if (!running && g_wasRunning[motor]) {
+    current_monitor_stop(monitor);
+  }
+  g_wasRunning[motor] = running;
+
+  const CurrentFault fault = current_monitor_update(monitor, blockMa, dtUs);
+  DcCurrent &published = g_published[motor];
+  published.current_ma = monitor.current_ma;
+  published.peak_ma = monitor.peak_ma;
+  published.fault = monitor.fault;
+  event = DcCurrentEvent{static_cast<DcMotorId>(motor), fault, monitor.current_ma, monitor.peak_ma};
+  portEXIT_CRITICAL(&g_mux);
+  return fault;
+}
+
+void sense_task(void *parameter) {
+  (void)parameter;
+
+  uint8_t buffer[BLOCK_BYTES];
+  int64_t last = esp_timer_get_time();
+  for (;;) {
+    uint32_t length = 0;
+    // ESP_ERR_INVALID_STATE reports blocks lost to a full pool but still returns data.
+    const esp_err_t result = adc_digi_read_bytes(buffer, sizeof(buffer), &length, ADC_MAX_DELAY);
+    if ((result != ESP_OK && result != ESP_ERR_INVALID_STATE) || length == 0) {
+      continue;
+    }
+    const int64_t now = esp_timer_get_time();
+    const uint32_t dtUs = static_cast<uint32_t>(now - last);
+    last = now;
+
+    uint32_t sums[DC_COUNT] = {};
+    uint16_t counts[DC_COUNT] = {};
+    for (uint32_t offset = 0; offset + SOC_ADC_DIGI_RESULT_BYTES <= length; offset += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t &sample = *reinterpret_cast<const adc_digi_output_data_t *>(&buffer[offset]);
+      const uint8_t channel = sample.type2.channel;
+      if (sample.type2.unit != 0 || channel >= ADC1_CHANNELS || g_channelMotor[channel] < 0) {
+        continue;
+      }
+      sums[g_channelMotor[channel]] += sample.type2.data;
+      ++counts[g_channelMotor[channel]];
+    }
+
+    for (uint8_t motor = 0; motor < DC_COUNT; ++motor) {
+      if (counts[motor] == 0) {
+        continue;
+      }
+      DcCurrentEvent event;
+      const float blockMa = raw_to_ma(sums[motor] / counts[motor]);
+      if (update_motor(motor, blockMa, dtUs, event) == CurrentFault::NONE) {
+        continue;
+      }
+      // Coasting drops the bridge at once; on the shared 300 RPM EN pin it
+      // brakes while the partner runs, which also ends the current.
+      dc_stop(event.motor, DcStopMode::COAST);
+      if (g_callback != nullptr) {
+        g_callback(event);
+      }
+    }
+  }
+}
+}  // namespace
+
+bool current_sense_init() {
+  if (g_task != nullptr) {
+    return true;
+  }
+
+  adc_digi_pattern_config_t pattern[DC_COUNT] = {};
+  uint8_t patternCount = 0;
+  uint32_t channelMask = 0;
+  for (int8_t &motor : g_channelMotor) {
+    motor = -1;
+  }
+  for (uint8_t motor = 0; motor < DC_COUNT; ++motor) {
+    current_monitor_init(g_monitors[motor], default_config(motor));
+    if (kPins[motor] == GPIO_NUM_NC) {
+      continue;
+    }
+    const int8_t channel = adc1_channel(kPins[motor]);
+    if (channel < 0) {
+      return false;
+    }
+    g_channelMotor[channel] = static_cast<int8_t>(motor);
+    channelMask |= 1UL << channel;
+    pattern[patternCount].atten = ADC_ATTEN_DB_11;
+    pattern[patternCount].channel = static_cast<uint8_t>(channel);
+    pattern[patternCount].unit = 0;
+    pattern[patternCount].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    ++patternCount;
+  }
+  if (patternCount == 0) {
+    return false;
+  }
+
+  adc_digi_init_config_t initConfig = {};
+  initConfig.max_store_buf_size = BLOCK_BYTES * 4;
+  initConfig.conv_num_each_intr = BLOCK_BYTES;
+  initConfig.adc1_chan_mask = channelMask;
+  initConfig.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&initConfig) != ESP_OK) {
+    return false;
+  }
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = false;
+  config.pattern_num = patternCount;
+  config.adc_pattern = pattern;
+  config.sample_freq_hz = DC_CURRENT_SAMPLE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&config) != ESP_OK) {
+    adc_digi_deinitialize();
+    return false;
+  }
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &g_calibration);
+
+  for (uint8_t motor = 0; motor < DC_COUNT; ++motor) {
+    g_published[motor].sensed = kPins[motor] != GPIO_NUM_NC;
+  }
+  adc_digi_start();
+  xTaskCreatePinnedToCore(sense_task, "current_sense", 3072, nullptr, DC_CURRENT_TASK_PRIORITY, &g_task, 0);
+  return true;
+}
+
+void current_sense_set_callback(DcCurrentCallback callback) {
+  g_callback = callback;
+}
+
+void current_sense_set_limits(DcMotorId motor, float overcurrent_ma, float jam_ma, uint32_t jam_ms) {
+  const uint8_t index = static_cast<uint8_t>(motor);
+  if (index >= DC_COUNT) {
+    return;
+  }
+  portENTER_CRITICAL(&g_mux);
+  CurrentMonitorConfig &config = g_monitors[index].config;
+  config.overcurrent_ma = overcurrent_ma;
+  config.jam_ma = jam_ma;
+  config.jam_ms = jam_ms;
+  portEXIT_CRITICAL(&g_mux);
+}
+
+DcCurrent current_sense_read(DcMotorId motor) {
+  const uint8_t index = static_cast<uint8_t>(motor);
+  if (index >= DC_COUNT) {
+    return DcCurrent{false, 0.0f, 0.0f, CurrentFault::NONE};
+  }
+  portENTER_CRITICAL(&g_mux);
+  const DcCurrent current = g_published[index];
+  portEXIT_CRITICAL(&g_mux);
+  return current;
+}
+
+void current_sense_report(Print &out) {
+  static const char *const kNames[DC_COUNT] = {"dc_3000", "dc1_300", "dc2_300"};
+  for (uint8_t motor = 0; motor < DC_COUNT; ++motor) {
+    portENTER_CRITICAL(&g_mux);
+    const DcCurrent current = g_published[motor];
+    const CurrentMonitorConfig config = g_monitors[motor].config;
+    portEXIT_CRITICAL(&g_mux);
+
+    if (!current.sensed) {
+      out.printf("%s not sensed\n", kNames[motor]);
+      continue;
+    }
+    out.printf("%s %.0f mA, peak %.0f mA, fault %s, limits %.0f mA / jam %.0f mA for %lu ms\n", kNames[motor],
+               current.current_ma, current.peak_ma, current_fault_name(current.fault), config.overcurrent_ma,
+               config.jam_ma, static_cast<unsigned long>(config.jam_ms));
+  }
+}
@@ -0,0 +1,167 @@
+#include "cycle_checkpoint.h"
+
+#include <esp_attr.h>
+#include <nvs.h>
+
+#include "crc16.h"
+
+namespace {
+constexpr uint32_t RECORD_MAGIC = 0x43594B31;  // "CYK1", bump with the layout
+constexpr char NVS_NAMESPACE[] = "cycle";
+constexpr char NVS_KEY[] = "checkpoint";
+
+struct StoredCheckpoint {
+  uint32_t magic;
+  uint32_t sequence;  // per save; the newer of the RTC and NVS copies wins
+  CycleCheckpoint checkpoint;
+  uint16_t crc;       // crc16_ccitt() over everything before it
+};
+
+// Rewritten every snapshot, so a checksum that costs a few XORs instead of a CRC.
+struct LivePositions {
+  uint32_t sequence;  // of the record the positions belong to
+  int32_t position[STEPPER_MOTOR_COUNT];
+  uint32_t check;
+};
+
+RTC_NOINIT_ATTR StoredCheckpoint g_rtcRecord;
+RTC_NOINIT_ATTR LivePositions g_rtcLive;
+
+StoredCheckpoint g_last = {};  // last saved or loaded, 0 sequence = none
+uint32_t g_persisted = 0;      // sequence of the record in NVS
+bool g_tracking = false;
+nvs_handle_t g_nvs = 0;
+bool g_nvsOpen = false;
+portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+uint16_t record_crc(const StoredCheckpoint &record) {
+  return crc16_ccitt(reinterpret_cast<const uint8_t *>(&record), offsetof(StoredCheckpoint, crc));
+}
+
+bool record_valid(const StoredCheckpoint &record) {
+  return record.magic == RECORD_MAGIC && record.sequence != 0 && record.crc == record_crc(record);
+}
+
+uint32_t live_check(const LivePositions &live) {
+  uint32_t check = RECORD_MAGIC ^ live.sequence;
+  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+    check = ((check << 7) | (check >> 25)) ^ static_cast<uint32_t>(live.position[index]);
+  }
+  return check;
+}
+
+// Field by field: the padding of a caller's checkpoint is not ours to compare.
+bool same_checkpoint(const CycleCheckpoint &a, const CycleCheckpoint &b) {
+  return a.cycle == b.cycle && a.task == b.task && a.solenoid == b.solenoid &&
+         memcmp(a.position, b.position, sizeof(a.position)) == 0;
+}
+
+bool open_nvs() {
+  if (!g_nvsOpen) {
+    g_nvsOpen = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &g_nvs) == ESP_OK;
+  }
+  return g_nvsOpen;
+}
+
+bool load_nvs(StoredCheckpoint &record) {
+  size_t length = sizeof(record);
+  return open_nvs() && nvs_get_blob(g_nvs, NVS_KEY, &record, &length) == ESP_OK && length == sizeof(record) &&
+         record_valid(record);
+}
+}  // namespace
+
+CheckpointSource cycle_checkpoint_load(CycleCheckpoint &checkpoint) {
+  StoredCheckpoint rtc;
+  memcpy(&rtc, &g_rtcRecord, sizeof(rtc));
+  StoredCheckpoint nvs;
+  const bool rtcValid = record_valid(rtc);
+  const bool nvsValid = load_nvs(nvs);
+
+  CheckpointSource source = CheckpointSource::NONE;
+  if (rtcValid && (!nvsValid || rtc.sequence >= nvs.sequence)) {
+    g_last = rtc;
+    source = CheckpointSource::RTC;
+  } else if (nvsValid) {
+    g_last = nvs;
+    source = CheckpointSource::NVS;
+  }
+  g_persisted = nvsValid ? nvs.sequence : 0;
+  if (source != CheckpointSource::NONE) {
+    checkpoint = g_last.checkpoint;
+  }
+  return source;
+}
+
+bool cycle_checkpoint_live_positions(int32_t position[STEPPER_MOTOR_COUNT]) {
+  portENTER_CRITICAL(&g_mux);
+  const LivePositions live = g_rtcLive;
+  portEXIT_CRITICAL(&g_mux);
+
+  if (g_last.sequence == 0 || live.sequence != g_last.sequence || live.check != live_check(live)) {
+    return false;
+  }
+  memcpy(position, live.position, sizeof(live.position));
+  return true;
+}
+
+void cycle_checkpoint_save(const CycleCheckpoint &checkpoint) {
+  StoredCheckpoint record;
+  memset(&record, 0, sizeof(record));  // padding takes part in the CRC
+  record.magic = RECORD_MAGIC;
+  if (g_last.sequence != 0 && same_checkpoint(checkpoint, g_last.checkpoint)) {
+    return;
+  }
+  // Member by member, so the padding stays zero for the CRC.
+  record.checkpoint.cycle = checkpoint.cycle;
+  record.checkpoint.task = checkpoint.task;
+  memcpy(record.checkpoint.position, checkpoint.position, sizeof(record.checkpoint.position));
+  record.checkpoint.solenoid = checkpoint.solenoid;
+  record.sequence = g_last.sequence + 1;
+  record.crc = record_crc(record);
+
+  // The mirror restarts from the boundary's positions before the record that
+  // validates it lands, so a reset in between finds either the old pair or the new one.
+  LivePositions live;
+  live.sequence = record.sequence;
+  memcpy(live.position, checkpoint.position, sizeof(live.position));
+  live.check = live_check(live);
+  portENTER_CRITICAL(&g_mux);
+  g_rtcLive = live;
+  memcpy(&g_rtcRecord, &record, sizeof(record));
+  g_last = record;
+  g_tracking = true;
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void cycle_checkpoint_persist() {
+  if (g_last.sequence == 0 || g_last.sequence == g_persisted) {
+    return;
+  }
+  if (open_nvs() && nvs_set_blob(g_nvs, NVS_KEY, &g_last, sizeof(g_last)) == ESP_OK &&
+      nvs_commit(g_nvs) == ESP_OK) {
+    g_persisted = g_last.sequence;
+  }
+}
+
+void cycle_checkpoint_clear() {
+  portENTER_CRITICAL(&g_mux);
+  g_tracking = false;
+  memset(&g_rtcRecord, 0, sizeof(g_rtcRecord));
+  memset(&g_rtcLive, 0, sizeof(g_rtcLive));
+  g_last = StoredCheckpoint();
+  g_persisted = 0;
+  portEXIT_CRITICAL(&g_mux);
+
+  if (open_nvs() && nvs_erase_key(g_nvs, NVS_KEY) == ESP_OK) {
+    nvs_commit(g_nvs);
+  }
+}
+
+void cycle_checkpoint_track(const int32_t position[STEPPER_MOTOR_COUNT]) {
+  portENTER_CRITICAL(&g_mux);
+  if (g_tracking) {
+    memcpy(g_rtcLive.position, position, sizeof(g_rtcLive.position));
+    g_rtcLive.check = live_check(g_rtcLive);
+  }
+  portEXIT_CRITICAL(&g_mux);
+}
@@ -1,6 +1,12 @@
 #include "dc_motor.h"
 #include "main.h"
 
+#include "current_sense.h"
+#include "dc_speed_loop.h"
+#include "dc_thermal.h"
+#include "encoder.h"
+#include "trace.h"
+
 namespace {
 constexpr uint8_t CH_DC3000_R = 0;
 constexpr uint8_t CH_DC3000_L = 1;
@@ -19,26 +25,65 @@ struct DcRuntime {
   gpio_num_t pinLpwm;
   uint8_t chRpwm;
   uint8_t chLpwm;
+  bool closedLoop;
+  int8_t encoder;
+  DcSpeedLoop speedLoop;
+  bool held;                // timed run suspended by g_paused, outputs off
+  uint32_t heldRemainingMs;
+  DcStopMode stopMode;      // used when a stop asks for DEFAULT
+  DcStopMode runStopMode;   // how the current timed run ends
+  bool braking;             // stopped with EN high and both low sides on
+  bool brakeTimed;          // coast once brakeEndMs passes
+  uint32_t brakeEndMs;
+  DcThermalModel thermal;
+  uint8_t dutyLimit;        // from the thermal model, caps speed at the outputs
 };
 
 DcRuntime dc3000 = {
     false, false, 0, 0, Direction::CW,
   PIN_DC_3000_RPWM, PIN_DC_3000_LPWM,
     CH_DC3000_R, CH_DC3000_L,
+  false, ENCODER_NONE, {}, false, 0,
+  DC_3000_STOP_MODE, DcStopMode::DEFAULT, false, false, 0,
+  {}, DC_PWM_MAX,
 };
 
 DcRuntime dc1_300 = {
     false, false, 0, 0, Direction::CW,
   PIN_DC1_300_RPWM, PIN_DC1_300_LPWM,
   CH_DC1_300_R, CH_DC1_300_L,
+  false, ENCODER_NONE, {}, false, 0,
+  DC_300_STOP_MODE, DcStopMode::DEFAULT, false, false, 0,
+  {}, DC_PWM_MAX,
 };
 
 DcRuntime dc2_300 = {
   false, false, 0, 0, Direction::CW,
   PIN_DC2_300_RPWM, PIN_DC2_300_LPWM,
   CH_DC2_300_R, CH_DC2_300_L,
+  false, ENCODER_NONE, {}, false, 0,
+  DC_300_STOP_MODE, DcStopMode::DEFAULT, false, false, 0,
+  {}, DC_PWM_MAX,
 };
 
+bool g_en3000 = false;
+bool g_en300 = false;
+uint32_t g_thermalLastUs = 0;
+volatile uint32_t g_thermalStepUs = 0;
+
+// Guards DcRuntime state and PWM outputs shared by the API callers and the control loop.
+// Every caller runs in a task and the outputs are written from inside, so a
+// mutex rather than a spinlock: ledcWrite() must not run with interrupts masked.
+SemaphoreHandle_t g_dcMutex = nullptr;
+
+void lock() {
+  xSemaphoreTake(g_dcMutex, portMAX_DELAY);
+}
+
+void unlock() {
+  xSemaphoreGive(g_dcMutex);
+}
+
 uint8_t clamp_speed(uint8_t speed) {
   if (speed > DC_PWM_MAX) {
     return DC_PWM_MAX;
@@ -63,64 +108,275 @@ bool is_timed_motion_complete(const DcRuntime &motor) {
   return !motor.timedRunActive && !motor.running;
 }
 
-void set_motor_enable(const DcRuntime &motor, bool enabled) {
-  if (&motor == &dc3000) {
-    digitalWrite(static_cast<uint8_t>(PIN_DC_3000_EN), enabled ? HIGH : LOW);
-  } else {
-    digitalWrite(static_cast<uint8_t>(PIN_DC_300_EN), enabled ? HIGH : LOW);
+bool is_powered(const DcRuntime &motor) {
+  return motor.running || motor.braking;
+}
+
+// Caller holds g_dcMutex. The two 300 RPM drivers share one EN pin, so it stays
+// high while either of them runs or brakes; a coasting 300 motor whose partner
+// is powered therefore brakes instead.
+void update_enable_pins() {
+  g_en3000 = is_powered(dc3000);
+  g_en300 = is_powered(dc1_300) || is_powered(dc2_300);
+  digitalWrite(static_cast<uint8_t>(PIN_DC_3000_EN), g_en3000 ? HIGH : LOW);
+  digitalWrite(static_cast<uint8_t>(PIN_DC_300_EN), g_en300 ? HIGH : LOW);
+}
+
+DcStopMode resolve_stop_mode(const DcRuntime &motor, DcStopMode mode) {
+  return (mode == DcStopMode::DEFAULT) ? motor.stopMode : mode;
+}
+
+// Duty on the outputs: the commanded speed, derated by the thermal model.
+uint8_t applied_duty(const DcRuntime &motor) {
+  if (!motor.running) {
+    return 0;
   }
+  return motor.speed < motor.dutyLimit ? motor.speed : motor.dutyLimit;
 }
 
 void write_motor_outputs(DcRuntime &motor) {
-  if (!motor.running || motor.speed == 0) {
+  const uint8_t duty = applied_duty(motor);
+  if (duty == 0) {
     ledcWrite(motor.chRpwm, 0);
     ledcWrite(motor.chLpwm, 0);
     return;
   }
 
   if (motor.direction == Direction::CW) {
-    ledcWrite(motor.chRpwm, motor.speed);
+    ledcWrite(motor.chRpwm, duty);
     ledcWrite(motor.chLpwm, 0);
   } else {
     ledcWrite(motor.chRpwm, 0);
-    ledcWrite(motor.chLpwm, motor.speed);
+    ledcWrite(motor.chLpwm, duty);
+  }
+}
+
+TraceTrack trace_track(const DcRuntime &motor) {
+  if (&motor == &dc3000) {
+    return TraceTrack::DC_3000;
   }
+  return (&motor == &dc1_300) ? TraceTrack::DC1_300 : TraceTrack::DC2_300;
 }
 
-void stop_motor(DcRuntime &motor) {
+// Caller holds g_dcMutex; opens a DC_RUN trace span unless one is already open.
+void mark_running(DcRuntime &motor, uint8_t duty) {
+  if (!motor.running) {
+    trace_begin(TraceEvent::DC_RUN, trace_track(motor), duty);
+  }
+  motor.running = true;
+}
+
+// Caller holds g_dcMutex and has cleared motor.running. Both PWM inputs go low;
+// EN then decides between braking and coasting.
+void apply_stop(DcRuntime &motor, DcStopMode mode) {
+  motor.braking = (mode != DcStopMode::COAST);
+  motor.brakeTimed = (mode == DcStopMode::BRAKE_THEN_COAST);
+  motor.brakeEndMs = millis() + DC_BRAKE_MS;
+  write_motor_outputs(motor);
+  update_enable_pins();
+}
+
+// Caller holds g_dcMutex.
+void stop_motor_outputs(DcRuntime &motor, DcStopMode mode) {
+  if (motor.running) {
+    trace_end(TraceEvent::DC_RUN, trace_track(motor));
+  }
   motor.running = false;
   motor.timedRunActive = false;
+  motor.held = false;
+  motor.closedLoop = false;
   motor.speed = 0;
-  write_motor_outputs(motor);
-  set_motor_enable(motor, false);
+  apply_stop(motor, resolve_stop_mode(motor, mode));
+}
+
+void stop_motor(DcRuntime &motor, DcStopMode mode) {
+  lock();
+  stop_motor_outputs(motor, mode);
+  unlock();
 }
 
 void run_motor(DcRuntime &motor, uint8_t speed, Direction direction) {
-  set_motor_enable(motor, true);
-  motor.running = true;
+  lock();
+  mark_running(motor, clamp_speed(speed));
+  motor.braking = false;
+  update_enable_pins();
   motor.timedRunActive = false;
+  motor.held = false;
+  motor.closedLoop = false;
   motor.speed = clamp_speed(speed);
   motor.direction = direction;
   write_motor_outputs(motor);
+  unlock();
 }
 
-void run_motor_ms(DcRuntime &motor, uint32_t time_ms, uint8_t speed, Direction direction) {
+void run_motor_ms(DcRuntime &motor, uint32_t time_ms, uint8_t speed, Direction direction, DcStopMode stopMode) {
   if (time_ms == 0) {
-    stop_motor(motor);
+    stop_motor(motor, stopMode);
     return;
   }
 
-  set_motor_enable(motor, true);
-  motor.running = true;
+  lock();
+  mark_running(motor, clamp_speed(speed));
+  motor.braking = false;
+  update_enable_pins();
   motor.timedRunActive = true;
+  motor.held = false;
+  motor.closedLoop = false;
   motor.timedRunEndMs = millis() + time_ms;
+  motor.runStopMode = stopMode;
   motor.speed = clamp_speed(speed);
   motor.direction = direction;
   write_motor_outputs(motor);
+  unlock();
+}
+
+// Caller holds g_dcMutex. Ends a timed run at its deadline; while paused the run
+// is held in DC_PAUSE_STOP_MODE and resumes afterwards for the time it had left.
+// Closed-loop runs are paused by dc_run_counts_blocking().
+void service_timed_run(DcRuntime &motor, uint32_t now, bool paused) {
+  if (!motor.timedRunActive) {
+    // An untimed open-loop run has nothing to resume; pause just stops it.
+    if (paused && motor.running && !motor.closedLoop) {
+      stop_motor_outputs(motor, DC_PAUSE_STOP_MODE);
+    }
+    return;
+  }
+
+  if (motor.held) {
+    if (!paused) {
+      motor.held = false;
+      motor.timedRunEndMs = now + motor.heldRemainingMs;
+      mark_running(motor, motor.speed);
+      motor.braking = false;
+      update_enable_pins();
+      write_motor_outputs(motor);
+    }
+    return;
+  }
+
+  const int32_t left = static_cast<int32_t>(motor.timedRunEndMs - now);
+  if (left <= 0) {
+    stop_motor_outputs(motor, motor.runStopMode);
+  } else if (paused) {
+    trace_end(TraceEvent::DC_RUN, trace_track(motor));
+    motor.held = true;
+    motor.heldRemainingMs = static_cast<uint32_t>(left);
+    motor.running = false;
+    apply_stop(motor, DC_PAUSE_STOP_MODE);
+  }
+}
+
+// Caller holds g_dcMutex.
+void service_brake(DcRuntime &motor, uint32_t now) {
+  if (motor.braking && motor.brakeTimed && static_cast<int32_t>(now - motor.brakeEndMs) >= 0) {
+    motor.braking = false;
+    update_enable_pins();
+  }
+}
+
+// Caller holds g_dcMutex. Heats the model by the duty on the outputs since the
+// last pass; each DC_THERMAL_PERIOD_US it steps the model, with the measured
+// current instead where the motor is sensed, and updates the duty limit.
+void service_thermal(DcRuntime &motor, uint32_t dtUs, bool step, const DcCurrent &current) {
+  DcThermalModel &model = motor.thermal;
+  dc_thermal_accumulate(model, dc_thermal_heat_from_duty(model, applied_duty(motor), DC_PWM_MAX), dtUs);
+  if (!step) {
+    return;
+  }
+
+  if (current.sensed) {
+    model.heat_sum = dc_thermal_heat_from_current(model, current.current_ma) * static_cast<float>(model.sum_us);
+  }
+  dc_thermal_step(model);
+
+  const uint8_t limit = dc_thermal_duty_limit(model, DC_PWM_MAX);
+  if (limit != motor.dutyLimit) {
+    motor.dutyLimit = limit;
+    write_motor_outputs(motor);
+  }
+}
+
+void init_thermal(DcRuntime &motor, float continuousMa, float fullDutyMa, float tauS) {
+  const DcThermalConfig config = {continuousMa, fullDutyMa, tauS, DC_THERMAL_DERATE_START};
+  dc_thermal_init(motor.thermal, config, DC_THERMAL_BOOT_LOAD);
+  motor.dutyLimit = dc_thermal_duty_limit(motor.thermal, DC_PWM_MAX);
+}
+
+// Starts closed-loop control; count mode when counts > 0, otherwise hold rpm.
+bool run_motor_closed_loop(DcRuntime &motor, int32_t counts, float rpm, Direction direction) {
+  if (motor.encoder == ENCODER_NONE || rpm <= 0.0f) {
+    return false;
+  }
+
+  const int8_t sign = (direction == Direction::CW) ? 1 : -1;
+  const int32_t count = encoder_read(motor.encoder);
+
+  lock();
+  if (counts > 0) {
+    dc_speed_loop_start_counts(motor.speedLoop, count, counts, rpm, sign);
+  } else {
+    dc_speed_loop_start(motor.speedLoop, count, rpm, sign);
+  }
+  mark_running(motor, 0);
+  motor.braking = false;
+  update_enable_pins();
+  motor.timedRunActive = false;
+  motor.held = false;
+  motor.closedLoop = true;
+  motor.speed = 0;
+  motor.direction = direction;
+  write_motor_outputs(motor);
+  unlock();
+  return true;
+}
+
+void speed_loop_tick(DcRuntime &motor) {
+  if (!motor.closedLoop) {
+    return;
+  }
+
+  const int32_t count = encoder_read(motor.encoder);
+
+  lock();
+  if (motor.closedLoop && motor.running) {
+    const DcSpeedLoopOutput output = dc_speed_loop_update(motor.speedLoop, count);
+    if (output.done) {
+      stop_motor_outputs(motor, DcStopMode::DEFAULT);
+    } else {
+      motor.speed = clamp_speed(static_cast<uint8_t>(output.duty + 0.5f));
+      write_motor_outputs(motor);
+    }
+  }
+  unlock();
+}
+
+void attach_encoder(DcRuntime &motor, gpio_num_t pinA, gpio_num_t pinB, float countsPerRev, float kp, float ki,
+                    float kff, float approachDecel, float approachMinRpm) {
+  motor.encoder = encoder_attach(pinA, pinB);
+  motor.closedLoop = false;
+
+  const DcSpeedLoopConfig config = {
+      countsPerRev, kp, ki, DC_SPEED_KD, kff, static_cast<float>(DC_PWM_MAX),
+      approachDecel, approachMinRpm, 1.0f / static_cast<float>(DC_SPEED_LOOP_HZ),
+      DC_SPEED_WINDOW_COUNTS, DC_SPEED_WINDOW_PERIODS,
+  };
+  dc_speed_loop_init(motor.speedLoop, config);
 }
 }  // namespace
 
+void dc_motor_safe_state() {
+  const gpio_num_t pins[] = {
+    PIN_DC_3000_EN, PIN_DC_300_EN,
+    PIN_DC_3000_RPWM, PIN_DC_3000_LPWM, PIN_DC1_300_RPWM, PIN_DC1_300_LPWM, PIN_DC2_300_RPWM, PIN_DC2_300_LPWM,
+  };
+  for (const gpio_num_t pin : pins) {
+    pinMode(static_cast<uint8_t>(pin), OUTPUT);
+    digitalWrite(static_cast<uint8_t>(pin), LOW);
+  }
+}
+
 void dc_motor_init() {
+  g_dcMutex = xSemaphoreCreateMutex();
   pinMode(static_cast<uint8_t>(PIN_DC_3000_EN), OUTPUT);
   pinMode(static_cast<uint8_t>(PIN_DC_300_EN), OUTPUT);
 
@@ -138,26 +394,63 @@ void dc_motor_init() {
   ledcAttachPin(static_cast<uint8_t>(dc2_300.pinRpwm), dc2_300.chRpwm);
   ledcAttachPin(static_cast<uint8_t>(dc2_300.pinLpwm), dc2_300.chLpwm);
 
-  digitalWrite(static_cast<uint8_t>(PIN_DC_3000_EN), HIGH);
-  digitalWrite(static_cast<uint8_t>(PIN_DC_300_EN), HIGH);
-
-  stop_motor(dc3000);
-  stop_motor(dc1_300);
-  stop_motor(dc2_300);
+  init_thermal(dc3000, DC_3000_CONTINUOUS_MA, DC_3000_FULL_DUTY_MA, DC_3000_THERMAL_TAU_S);
+  init_thermal(dc1_300, DC_300_CONTINUOUS_MA, DC_300_FULL_DUTY_MA, DC_300_THERMAL_TAU_S);
+  init_thermal(dc2_300, DC_300_CONTINUOUS_MA, DC_300_FULL_DUTY_MA, DC_300_THERMAL_TAU_S);
+  g_thermalLastUs = micros();
+  g_thermalStepUs = g_thermalLastUs;
+
+  stop_motor(dc3000, DcStopMode::COAST);
+  stop_motor(dc1_300, DcStopMode::COAST);
+  stop_motor(dc2_300, DcStopMode::COAST);
+
+  attach_encoder(dc3000, PIN_DC_3000_ENC_A, PIN_DC_3000_ENC_B, DC_3000_ENCODER_COUNTS_PER_REV, DC_3000_SPEED_KP,
+                 DC_3000_SPEED_KI, DC_3000_SPEED_KFF, DC_3000_APPROACH_DECEL_RPM_PER_S, DC_3000_APPROACH_MIN_RPM);
+  attach_encoder(dc1_300, PIN_DC1_300_ENC_A, PIN_DC1_300_ENC_B, DC_300_ENCODER_COUNTS_PER_REV, DC_300_SPEED_KP,
+                 DC_300_SPEED_KI, DC_300_SPEED_KFF, DC_300_APPROACH_DECEL_RPM_PER_S, DC_300_APPROACH_MIN_RPM);
+  attach_encoder(dc2_300, PIN_DC2_300_ENC_A, PIN_DC2_300_ENC_B, DC_300_ENCODER_COUNTS_PER_REV, DC_300_SPEED_KP,
+                 DC_300_SPEED_KI, DC_300_SPEED_KFF, DC_300_APPROACH_DECEL_RPM_PER_S, DC_300_APPROACH_MIN_RPM);
 }
 
 void dc_service() {
   const uint32_t now = millis();
-
-  if (dc3000.timedRunActive && static_cast<int32_t>(now - dc3000.timedRunEndMs) >= 0) {
-    stop_motor(dc3000);
-  }
-  if (dc1_300.timedRunActive && static_cast<int32_t>(now - dc1_300.timedRunEndMs) >= 0) {
-    stop_motor(dc1_300);
+  const uint32_t nowUs = micros();
+  const bool paused = g_paused;
+
+  // Current sense has its own lock; read it outside g_dcMutex and only when a step is due.
+  bool step = nowUs - g_thermalStepUs >= DC_THERMAL_PERIOD_US;
+  DcCurrent currents[3] = {};
+  if (step) {
+    for (uint8_t index = 0; index < 3; ++index) {
+      currents[index] = current_sense_read(static_cast<DcMotorId>(index));
+    }
   }
-  if (dc2_300.timedRunActive && static_cast<int32_t>(now - dc2_300.timedRunEndMs) >= 0) {
-    stop_motor(dc2_300);
+
+  lock();
+  service_timed_run(dc3000, now, paused);
+  service_timed_run(dc1_300, now, paused);
+  service_timed_run(dc2_300, now, paused);
+  service_brake(dc3000, now);
+  service_brake(dc1_300, now);
+  service_brake(dc2_300, now);
+
+  // dc_service() runs from several tasks; the first one past the period steps the models.
+  const uint32_t dtUs = static_cast<int32_t>(nowUs - g_thermalLastUs) > 0 ? nowUs - g_thermalLastUs : 0;
+  g_thermalLastUs += dtUs;
+  step = step && nowUs - g_thermalStepUs >= DC_THERMAL_PERIOD_US;
+  if (step) {
+    g_thermalStepUs = nowUs;
   }
+  service_thermal(dc3000, dtUs, step, currents[0]);
+  service_thermal(dc1_300, dtUs, step, currents[1]);
+  service_thermal(dc2_300, dtUs, step, currents[2]);
+  unlock();
+}
+
+void dc_closed_loop_service() {
+  speed_loop_tick(dc3000);
+  speed_loop_tick(dc1_300);
+  speed_loop_tick(dc2_300);
 }
 
 void dc_3000_run(uint8_t speed, Direction direction) {
@@ -165,38 +458,26 @@ void dc_3000_run(uint8_t speed, Direction direction) {
 }
 
 void dc_3000_run_ms(uint32_t time_ms, uint8_t speed, Direction direction) {
-  run_motor_ms(dc3000, time_ms, speed, direction);
+  run_motor_ms(dc3000, time_ms, speed, direction, DcStopMode::DEFAULT);
 }
 
 void dc_3000_run_ms_blocking(uint32_t time_ms, uint8_t speed, Direction direction) {
   dc_3000_run_ms(time_ms, speed, direction);
 
+  // dc_service() holds the run while g_paused is set and resumes it afterwards.
   for (;;) {
-    if (g_paused) {
-      // Capture remaining run time before stopping
-      const int32_t left = static_cast<int32_t>(dc3000.timedRunEndMs - millis());
-      const uint32_t remaining_ms = (dc3000.timedRunActive && left > 0) ? static_cast<uint32_t>(left) : 0;
-      dc_3000_stop();
-      while (g_paused) delay(10);
-      if (remaining_ms > 0) {
-        dc_3000_run_ms(remaining_ms, speed, direction);
-      } else {
-        break;
-      }
-    }
-
     dc_service();
 
     if (is_timed_motion_complete(dc3000)) {
       break;
     }
 
-    delay(0);
+    delay(g_paused ? 10 : 0);
   }
 }
 
 void dc_3000_stop() {
-  stop_motor(dc3000);
+  stop_motor(dc3000, DcStopMode::DEFAULT);
 }
 
 void dc1_300_run(uint8_t speed, Direction direction) {
@@ -204,38 +485,26 @@ void dc1_300_run(uint8_t speed, Direction direction) {
 }
 
 void dc1_300_run_ms(uint32_t time_ms, uint8_t speed, Direction direction) {
-  run_motor_ms(dc1_300, time_ms, speed, direction);
+  run_motor_ms(dc1_300, time_ms, speed, direction, DcStopMode::DEFAULT);
 }
 
 void dc1_300_run_ms_blocking(uint32_t time_ms, uint8_t speed, Direction direction) {
   dc1_300_run_ms(time_ms, speed, direction);
 
+  // dc_service() holds the run while g_paused is set and resumes it afterwards.
   for (;;) {
-    if (g_paused) {
-      // Capture remaining run time before stopping
-      const int32_t left = static_cast<int32_t>(dc1_300.timedRunEndMs - millis());
-      const uint32_t remaining_ms = (dc1_300.timedRunActive && left > 0) ? static_cast<uint32_t>(left) : 0;
-      dc1_300_stop();
-      while (g_paused) delay(10);
-      if (remaining_ms > 0) {
-        dc1_300_run_ms(remaining_ms, speed, direction);
-      } else {
-        break;
-      }
-    }
-
     dc_service();
 
     if (is_timed_motion_complete(dc1_300)) {
       break;
     }
 
-    delay(0);
+    delay(g_paused ? 10 : 0);
   }
 }
 
 void dc1_300_stop() {
-  stop_motor(dc1_300);
+  stop_motor(dc1_300, DcStopMode::DEFAULT);
 }
 
 void dc2_300_run(uint8_t speed, Direction direction) {
@@ -243,38 +512,33 @@ void dc2_300_run(uint8_t speed, Direction direction) {
 }
 
 void dc2_300_run_ms(uint32_t time_ms, uint8_t speed, Direction direction) {
-  run_motor_ms(dc2_300, time_ms, speed, direction);
+  run_motor_ms(dc2_300, time_ms, speed, direction, DcStopMode::DEFAULT);
 }
 
 void dc2_300_run_ms_blocking(uint32_t time_ms, uint8_t speed, Direction direction) {
   dc2_300_run_ms(time_ms, speed, direction);
 
+  // dc_service() holds the run while g_paused is set and resumes it afterwards.
   for (;;) {
-    if (g_paused) {
-      // Capture remaining run time before stopping
-      const int32_t left = static_cast<int32_t>(dc2_300.timedRunEndMs - millis());
-      const uint32_t remaining_ms = (dc2_300.timedRunActive && left > 0) ? static_cast<uint32_t>(left) : 0;
-      dc2_300_stop();
-      while (g_paused) delay(10);
-      if (remaining_ms > 0) {
-        dc2_300_run_ms(remaining_ms, speed, direction);
-      } else {
-        break;
-      }
-    }
-
     dc_service();
 
     if (is_timed_motion_complete(dc2_300)) {
       break;
     }
 
-    delay(0);
+    delay(g_paused ? 10 : 0);
   }
 }
 
 void dc2_300_stop() {
-  stop_motor(dc2_300);
+  stop_motor(dc2_300, DcStopMode::DEFAULT);
+}
+
+void dc_run_ms(const DcTimedMove &move) {
+  DcRuntime *motor = motor_from_id(move.motor);
+  if (motor != nullptr) {
+    run_motor_ms(*motor, move.time_ms, move.speed, move.direction, move.stop_mode);
+  }
 }
 
 void dc_run_ms_batch_blocking(const DcTimedMove *moves, uint8_t move_count) {
@@ -291,36 +555,15 @@ void dc_run_ms_batch_blocking(const DcTimedMove *moves, uint8_t move_count) {
     }
 
     hasValidMove = true;
-    run_motor_ms(*motor, moves[i].time_ms, moves[i].speed, moves[i].direction);
+    run_motor_ms(*motor, moves[i].time_ms, moves[i].speed, moves[i].direction, moves[i].stop_mode);
   }
 
   if (!hasValidMove) {
     return;
   }
 
+  // dc_service() holds the runs while g_paused is set and resumes them afterwards.
   for (;;) {
-    if (g_paused) {
-      // Capture remaining time for each motor before stopping
-      uint32_t remaining_ms[3] = {};
-      for (uint8_t i = 0; i < move_count; ++i) {
-        DcRuntime *motor = motor_from_id(moves[i].motor);
-        if (motor == nullptr || !motor->timedRunActive) continue;
-        const int32_t left = static_cast<int32_t>(motor->timedRunEndMs - millis());
-        remaining_ms[static_cast<uint8_t>(moves[i].motor)] = (left > 0) ? static_cast<uint32_t>(left) : 0;
-      }
-      dc_stop_all();
-      while (g_paused) delay(10);
-      // Resume each motor with its remaining time
-      for (uint8_t i = 0; i < move_count; ++i) {
-        DcRuntime *motor = motor_from_id(moves[i].motor);
-        if (motor == nullptr) continue;
-        const uint32_t rem = remaining_ms[static_cast<uint8_t>(moves[i].motor)];
-        if (rem > 0) {
-          run_motor_ms(*motor, rem, moves[i].speed, moves[i].direction);
-        }
-      }
-    }
-
     dc_service();
 
     bool allComplete = true;
@@ -340,12 +583,197 @@ void dc_run_ms_batch_blocking(const DcTimedMove *moves, uint8_t move_count) {
       break;
     }
 
-    delay(0);
+    delay(g_paused ? 10 : 0);
   }
 }
 
 void dc_stop_all() {
-  stop_motor(dc3000);
-  stop_motor(dc1_300);
-  stop_motor(dc2_300);
+  stop_motor(dc3000, DcStopMode::DEFAULT);
+  stop_motor(dc1_300, DcStopMode::DEFAULT);
+  stop_motor(dc2_300, DcStopMode::DEFAULT);
+}
+
+void dc_stop(DcMotorId id, DcStopMode mode) {
+  DcRuntime *motor = motor_from_id(id);
+  if (motor != nullptr) {
+    stop_motor(*motor, mode);
+  }
+}
+
+void dc_set_stop_mode(DcMotorId id, DcStopMode mode) {
+  DcRuntime *motor = motor_from_id(id);
+  if (motor != nullptr && mode != DcStopMode::DEFAULT) {
+    lock();
+    motor->stopMode = mode;
+    unlock();
+  }
+}
+
+bool dc_has_encoder(DcMotorId id) {
+  const DcRuntime *motor = motor_from_id(id);
+  return motor != nullptr && motor->encoder != ENCODER_NONE;
+}
+
+bool dc_run_rpm(DcMotorId id, float rpm, Direction direction) {
+  DcRuntime *motor = motor_from_id(id);
+  return motor != nullptr && run_motor_closed_loop(*motor, 0, rpm, direction);
+}
+
+bool dc_run_counts(DcMotorId id, int32_t counts, float rpm, Direction direction) {
+  DcRuntime *motor = motor_from_id(id);
+  if (motor == nullptr || counts <= 0) {
+    return false;
+  }
+  return run_motor_closed_loop(*motor, counts, rpm, direction);
+}
+
+void dc_run_counts_blocking(DcMotorId id, int32_t counts, float rpm, Direction direction) {
+  DcRuntime *motor = motor_from_id(id);
+  if (motor == nullptr || !dc_run_counts(id, counts, rpm, direction)) {
+    return;
+  }
+
+  for (;;) {
+    if (g_paused) {
+      // Capture remaining counts before stopping
+      const int32_t remaining = motor->closedLoop
+                                  ? dc_speed_loop_remaining(motor->speedLoop, encoder_read(motor->encoder))
+                                  : 0;
+      stop_motor(*motor, DC_PAUSE_STOP_MODE);
+      while (g_paused) delay(10);
+      if (remaining > 0) {
+        dc_run_counts(id, remaining, rpm, direction);
+      } else {
+        break;
+      }
+    }
+
+    dc_service();
+
+    if (is_timed_motion_complete(*motor)) {
+      break;
+    }
+
+    delay(0);
+  }
+}
+
+float dc_get_rpm(DcMotorId id) {
+  const DcRuntime *motor = motor_from_id(id);
+  if (motor == nullptr || motor->encoder == ENCODER_NONE || !motor->closedLoop) {
+    return 0.0f;
+  }
+  return motor->speedLoop.measured_rpm;
+}
+
+int32_t dc_get_encoder_count(DcMotorId id) {
+  const DcRuntime *motor = motor_from_id(id);
+  if (motor == nullptr || motor->encoder == ENCODER_NONE) {
+    return 0;
+  }
+  return encoder_read(motor->encoder);
+}
+
+bool dc_is_busy(DcMotorId id) {
+  const DcRuntime *motor = motor_from_id(id);
+  return motor != nullptr && !is_timed_motion_complete(*motor);
+}
+
+DcStatus dc_get_status(DcMotorId id) {
+  DcStatus status = {false, false, 0, Direction::CW, false, 0.0f, 0.0f, CurrentFault::NONE};
+  const DcRuntime *motor = motor_from_id(id);
+  if (motor == nullptr) {
+    return status;
+  }
+
+  status.running = motor->running;
+  status.enabled = (motor == &dc3000) ? g_en3000 : g_en300;
+  status.duty = motor->running ? motor->speed : 0;
+  status.direction = motor->direction;
+  status.braking = motor->braking;
+
+  const DcCurrent current = current_sense_read(id);
+  status.current_ma = current.current_ma;
+  status.peak_ma = current.peak_ma;
+  status.fault = current.fault;
+  return status;
+}
+
+DcThermal dc_get_thermal(DcMotorId id) {
+  DcThermal thermal = {0.0f, DC_PWM_MAX};
+  const DcRuntime *motor = motor_from_id(id);
+  if (motor == nullptr) {
+    return thermal;
+  }
+
+  lock();
+  thermal.load = motor->thermal.load;
+  thermal.duty_limit = motor->dutyLimit;
+  unlock();
+  return thermal;
+}
+
+uint32_t dc_budget_ms(DcMotorId id, uint8_t duty) {
+  const DcRuntime *motor = motor_from_id(id);
+  if (motor == nullptr) {
+    return 0;
+  }
+
+  lock();
+  const DcThermalModel model = motor->thermal;
+  unlock();
+  return dc_thermal_budget_ms(model, clamp_speed(duty), DC_PWM_MAX);
+}
+
+DcTimedMove dc_boost_move(const DcTimedMove &move) {
+  const uint8_t speed = clamp_speed(move.speed);
+  if (motor_from_id(move.motor) == nullptr || speed == 0 || speed == DC_PWM_MAX) {
+    return move;
+  }
+
+  DcTimedMove boosted = move;
+  boosted.speed = DC_PWM_MAX;
+  boosted.time_ms = (move.time_ms * speed + DC_PWM_MAX - 1) / DC_PWM_MAX;
+  return dc_budget_ms(move.motor, DC_PWM_MAX) >= boosted.time_ms ? boosted : move;
+}
+
+void dc_thermal_report(Print &out) {
+  static const char *const kNames[3] = {"dc_3000", "dc1_300", "dc2_300"};
+  for (uint8_t index = 0; index < 3; ++index) {
+    const DcMotorId id = static_cast<DcMotorId>(index);
+    const DcThermal thermal = dc_get_thermal(id);
+    const uint32_t budget = dc_budget_ms(id, DC_PWM_MAX);
+    if (budget == UINT32_MAX) {
+      out.printf("%s load %.2f, duty limit %u, full duty unlimited\n", kNames[index], thermal.load,
+                 thermal.duty_limit);
+    } else {
+      out.printf("%s load %.2f, duty limit %u, full duty for %lu ms\n", kNames[index], thermal.load,
+                 thermal.duty_limit, static_cast<unsigned long>(budget));
+    }
+  }
+}
+
+uint32_t dc_estimate_run_us(const DcTimedMove &move) {
+  if (motor_from_id(move.motor) == nullptr) {
+    return 0;
+  }
+
+  // Runs over ~71 minutes do not fit in microseconds; saturate rather than wrap.
+  const uint64_t us = static_cast<uint64_t>(move.time_ms) * 1000ULL;
+  return (us > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(us);
+}
+
+uint32_t dc_estimate_batch_us(const DcTimedMove *moves, uint8_t move_count) {
+  if (moves == nullptr) {
+    return 0;
+  }
+
+  uint32_t longest = 0;
+  for (uint8_t i = 0; i < move_count; ++i) {
+    const uint32_t duration = dc_estimate_run_us(moves[i]);
+    if (duration > longest) {
+      longest = duration;
+    }
+  }
+  return longest;
 }
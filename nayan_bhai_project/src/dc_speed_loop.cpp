@@ -0,0 +1,138 @@
+#include "dc_speed_loop.h"
+
+#include <math.h>
+
+namespace {
+float clampf(float value, float low, float high) {
+  if (value < low) {
+    return low;
+  }
+  if (value > high) {
+    return high;
+  }
+  return value;
+}
+
+void reset_state(DcSpeedLoop &loop, int32_t count, float rpm, int8_t direction) {
+  loop.target_rpm = (rpm < 0.0f) ? 0.0f : rpm;
+  loop.command_rpm = loop.target_rpm;
+  loop.measured_rpm = 0.0f;
+  loop.integral = 0.0f;
+  loop.history[0] = count;
+  loop.history_head = 1;
+  loop.history_fill = 1;
+  loop.direction = (direction < 0) ? -1 : 1;
+}
+
+// Records count and returns the speed over the shortest window back that spans
+// window_counts, or over window_periods if the motor is slower than that.
+float measure_rpm(DcSpeedLoop &loop, int32_t count) {
+  const DcSpeedLoopConfig &config = loop.config;
+  loop.history[loop.history_head] = count;
+  loop.history_head = static_cast<uint8_t>((loop.history_head + 1) % DC_SPEED_HISTORY);
+  if (loop.history_fill < DC_SPEED_HISTORY) {
+    ++loop.history_fill;
+  }
+
+  int32_t delta = 0;
+  uint8_t periods = 0;
+  while (periods < config.window_periods && periods + 1 < loop.history_fill) {
+    ++periods;
+    const uint8_t slot = static_cast<uint8_t>((loop.history_head + DC_SPEED_HISTORY - 1 - periods) % DC_SPEED_HISTORY);
+    delta = (count - loop.history[slot]) * loop.direction;
+    if (delta >= config.window_counts || -delta >= config.window_counts) {
+      break;
+    }
+  }
+  if (periods == 0) {
+    return 0.0f;
+  }
+  return static_cast<float>(delta) / config.counts_per_rev * 60.0f / (static_cast<float>(periods) * config.period_s);
+}
+
+// Highest speed from which the motor can still stop within `remaining` counts.
+float approach_limit_rpm(const DcSpeedLoopConfig &config, int32_t remaining) {
+  const float remainingRevs = static_cast<float>(remaining) / config.counts_per_rev;
+  const float decelRevPerS2 = config.decel_rpm_per_s / 60.0f;
+  return 60.0f * sqrtf(2.0f * decelRevPerS2 * remainingRevs);
+}
+}  // namespace
+
+void dc_speed_loop_init(DcSpeedLoop &loop, const DcSpeedLoopConfig &config) {
+  loop.config = config;
+  if (loop.config.counts_per_rev <= 0.0f) {
+    loop.config.counts_per_rev = 1.0f;
+  }
+  if (loop.config.period_s <= 0.0f) {
+    loop.config.period_s = 0.002f;
+  }
+  if (loop.config.window_counts < 1) {
+    loop.config.window_counts = 1;
+  }
+  if (loop.config.window_periods < 1 || loop.config.window_periods >= DC_SPEED_HISTORY) {
+    loop.config.window_periods = DC_SPEED_HISTORY - 1;
+  }
+  reset_state(loop, 0, 0.0f, 1);
+  loop.target_count = 0;
+  loop.count_mode = false;
+}
+
+void dc_speed_loop_start(DcSpeedLoop &loop, int32_t count, float rpm, int8_t direction) {
+  reset_state(loop, count, rpm, direction);
+  loop.count_mode = false;
+}
+
+void dc_speed_loop_start_counts(DcSpeedLoop &loop, int32_t count, int32_t counts, float rpm, int8_t direction) {
+  reset_state(loop, count, rpm, direction);
+  loop.count_mode = true;
+  loop.target_count = count + loop.direction * ((counts < 0) ? -counts : counts);
+}
+
+int32_t dc_speed_loop_remaining(const DcSpeedLoop &loop, int32_t count) {
+  if (!loop.count_mode) {
+    return 0;
+  }
+  const int32_t remaining = (loop.target_count - count) * loop.direction;
+  return (remaining > 0) ? remaining : 0;
+}
+
+DcSpeedLoopOutput dc_speed_loop_update(DcSpeedLoop &loop, int32_t count) {
+  const DcSpeedLoopConfig &config = loop.config;
+  DcSpeedLoopOutput output = {0.0f, false};
+
+  const float previousRpm = loop.measured_rpm;
+  loop.measured_rpm = measure_rpm(loop, count);
+
+  loop.command_rpm = loop.target_rpm;
+  if (loop.count_mode) {
+    const int32_t remaining = dc_speed_loop_remaining(loop, count);
+    if (remaining == 0) {
+      loop.command_rpm = 0.0f;
+      loop.integral = 0.0f;
+      output.done = true;
+      return output;
+    }
+    float approach = approach_limit_rpm(config, remaining);
+    if (approach < config.min_rpm) {
+      approach = config.min_rpm;
+    }
+    if (approach < loop.command_rpm) {
+      loop.command_rpm = approach;
+    }
+  }
+
+  const float error = loop.command_rpm - loop.measured_rpm;
+  const float derivative = -(loop.measured_rpm - previousRpm) / config.period_s;
+  const float unclamped = config.kff * loop.command_rpm + config.kp * error + config.ki * loop.integral +
+                          config.kd * derivative;
+
+  // Conditional integration: stop winding up while the output is pinned in the error's direction.
+  const bool saturatedHigh = unclamped >= config.max_duty && error > 0.0f;
+  const bool saturatedLow = unclamped <= 0.0f && error < 0.0f;
+  if (!saturatedHigh && !saturatedLow) {
+    loop.integral += error * config.period_s;
+  }
+
+  output.duty = clampf(unclamped, 0.0f, config.max_duty);
+  return output;
+}
@@ -0,0 +1,66 @@
+#include "dc_thermal.h"
+
+#include <math.h>
+
+void dc_thermal_init(DcThermalModel &model, const DcThermalConfig &config, float load) {
+  model.config = config;
+  model.load = load;
+  model.heat_sum = 0.0f;
+  model.sum_us = 0;
+}
+
+float dc_thermal_heat_from_duty(const DcThermalModel &model, uint8_t duty, uint8_t max_duty) {
+  const float ma = model.config.full_duty_ma * static_cast<float>(duty) / static_cast<float>(max_duty);
+  return dc_thermal_heat_from_current(model, ma);
+}
+
+float dc_thermal_heat_from_current(const DcThermalModel &model, float current_ma) {
+  const float ratio = current_ma / model.config.continuous_ma;
+  return ratio * ratio;
+}
+
+void dc_thermal_accumulate(DcThermalModel &model, float heat, uint32_t dt_us) {
+  model.heat_sum += heat * static_cast<float>(dt_us);
+  model.sum_us += dt_us;
+}
+
+void dc_thermal_step(DcThermalModel &model) {
+  if (model.sum_us == 0) {
+    return;
+  }
+  const float heat = model.heat_sum / static_cast<float>(model.sum_us);
+  const float decay = expf(-static_cast<float>(model.sum_us) * 1e-6f / model.config.tau_s);
+  model.load = heat + (model.load - heat) * decay;
+  model.heat_sum = 0.0f;
+  model.sum_us = 0;
+}
+
+uint8_t dc_thermal_duty_limit(const DcThermalModel &model, uint8_t max_duty) {
+  const DcThermalConfig &config = model.config;
+  const float fullHeat = dc_thermal_heat_from_duty(model, max_duty, max_duty);
+  if (model.load <= config.derate_start || fullHeat <= 1.0f) {
+    return max_duty;
+  }
+
+  // Heat input allowed falls linearly from full duty's to the continuous 1.0.
+  float fraction = (model.load - config.derate_start) / (1.0f - config.derate_start);
+  if (fraction > 1.0f) {
+    fraction = 1.0f;
+  }
+  const float heat = fullHeat - (fullHeat - 1.0f) * fraction;
+  return static_cast<uint8_t>(static_cast<float>(max_duty) * sqrtf(heat / fullHeat));
+}
+
+uint32_t dc_thermal_budget_ms(const DcThermalModel &model, uint8_t duty, uint8_t max_duty) {
+  const float limit = model.config.derate_start;
+  if (model.load >= limit) {
+    return 0;
+  }
+  const float heat = dc_thermal_heat_from_duty(model, duty, max_duty);
+  if (heat <= limit) {
+    return UINT32_MAX;
+  }
+  // load(t) = heat + (load - heat) e^(-t/tau) reaches limit at:
+  const float seconds = model.config.tau_s * logf((heat - model.load) / (heat - limit));
+  return static_cast<uint32_t>(seconds * 1000.0f);
+}
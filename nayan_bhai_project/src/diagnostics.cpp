@@ -0,0 +1,262 @@
+#include "diagnostics.h"
+
+#include <esp_freertos_hooks.h>
+
+#include "control_loop.h"
+#include "defines.h"
+#include "step_stream.h"
+#include "stepper_motor.h"
+
+#if !configUSE_TRACE_FACILITY
+#error "diagnostics needs configUSE_TRACE_FACILITY for uxTaskGetSystemState()"
+#endif
+
+namespace {
+constexpr uint32_t REPORT_NOTIFY_BIT = 1;
+
+// Per-task CPU share needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, which the
+// stock Arduino core leaves off; per-core load comes from idle hooks either way.
+#if configGENERATE_RUN_TIME_STATS
+constexpr bool RUN_TIME_STATS = true;
+#else
+constexpr bool RUN_TIME_STATS = false;
+#endif
+
+struct CoreLoad {
+  // Written by the core's idle hook only.
+  volatile uint32_t lastHookUs;
+  volatile uint32_t idleUs;
+  volatile uint32_t longestGapUs;
+
+  uint32_t lastIdleUs;  // sampler copy of idleUs at the previous sample
+  float loadPercent;
+  float peakLoadPercent;
+};
+
+struct TaskSample {
+  TaskHandle_t handle;
+  uint32_t runTime;
+  float cpuPercent;  // of one core over the last period, < 0 when unknown
+  int8_t core;       // -1 = not pinned
+};
+
+CoreLoad g_cores[portNUM_PROCESSORS] = {};
+// Sized from uxTaskGetNumberOfTasks(), which uxTaskGetSystemState() must not
+// exceed or it fills in nothing. Only the diagnostics task touches these.
+TaskStatus_t *g_status = nullptr;
+TaskSample *g_samples = nullptr;
+TaskSample *g_nextSamples = nullptr;
+UBaseType_t g_capacity = 0;
+UBaseType_t g_taskCount = 0;
+bool g_truncated = false;  // the last sample could not list every task
+uint32_t g_lastTotalRunTime = 0;
+uint32_t g_lastSampleUs = 0;
+TaskHandle_t g_diagTask = nullptr;
+
+// Continuous idle iterations are closer together than DIAG_IDLE_CONTINUITY_US;
+// a longer gap means other tasks held the core and the idle task was starved.
+bool record_idle(CoreLoad &core) {
+  const uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+  const uint32_t gap = now - core.lastHookUs;
+  if (gap <= DIAG_IDLE_CONTINUITY_US) {
+    core.idleUs += gap;
+  } else if (gap > core.longestGapUs) {
+    core.longestGapUs = gap;
+  }
+  core.lastHookUs = now;
+  return false;  // keep the hook running instead of waiting for the next interrupt
+}
+
+bool idle_hook_core0() {
+  return record_idle(g_cores[0]);
+}
+
+bool idle_hook_core1() {
+  return record_idle(g_cores[portNUM_PROCESSORS - 1]);
+}
+
+bool previous_run_time(TaskHandle_t handle, uint32_t &runTime) {
+  for (UBaseType_t i = 0; i < g_taskCount; ++i) {
+    if (g_samples[i].handle == handle) {
+      runTime = g_samples[i].runTime;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Keeps the previous samples, which the next CPU share is computed against.
+bool grow_buffers(UBaseType_t capacity) {
+  TaskStatus_t *status = static_cast<TaskStatus_t *>(malloc(sizeof(TaskStatus_t) * capacity));
+  TaskSample *samples = static_cast<TaskSample *>(malloc(sizeof(TaskSample) * capacity));
+  TaskSample *nextSamples = static_cast<TaskSample *>(malloc(sizeof(TaskSample) * capacity));
+  if (status == nullptr || samples == nullptr || nextSamples == nullptr) {
+    free(status);
+    free(samples);
+    free(nextSamples);
+    return false;
+  }
+
+  if (g_taskCount > 0) {
+    memcpy(samples, g_samples, sizeof(TaskSample) * g_taskCount);
+  }
+  free(g_status);
+  free(g_samples);
+  free(g_nextSamples);
+  g_status = status;
+  g_samples = samples;
+  g_nextSamples = nextSamples;
+  g_capacity = capacity;
+  return true;
+}
+
+// Returns the number of entries filled in, 0 when the buffers cannot hold every task.
+UBaseType_t read_system_state(uint32_t &totalRunTime) {
+  for (uint8_t attempt = 0; attempt < 2; ++attempt) {
+    const UBaseType_t needed = uxTaskGetNumberOfTasks();
+    if (needed > g_capacity && !grow_buffers(needed + DIAG_TASK_HEADROOM)) {
+      return 0;
+    }
+    // Tasks created since the count above can still overflow the headroom; retry once.
+    const UBaseType_t count = uxTaskGetSystemState(g_status, g_capacity, &totalRunTime);
+    if (count > 0) {
+      return count;
+    }
+  }
+  return 0;
+}
+
+void sample() {
+  const uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+  const uint32_t periodUs = now - g_lastSampleUs;
+  g_lastSampleUs = now;
+
+  for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core) {
+    CoreLoad &load = g_cores[core];
+    const uint32_t idleUs = load.idleUs;
+    const uint32_t idleDelta = idleUs - load.lastIdleUs;
+    load.lastIdleUs = idleUs;
+    const float idleShare = (periodUs > 0) ? static_cast<float>(idleDelta) / static_cast<float>(periodUs) : 0.0f;
+    load.loadPercent = 100.0f * (1.0f - ((idleShare > 1.0f) ? 1.0f : idleShare));
+    if (load.loadPercent > load.peakLoadPercent) {
+      load.peakLoadPercent = load.loadPercent;
+    }
+  }
+
+  uint32_t totalRunTime = 0;
+  const UBaseType_t count = read_system_state(totalRunTime);
+  g_truncated = count == 0;
+  if (count == 0) {
+    g_taskCount = 0;
+    return;
+  }
+  const uint32_t totalDelta = totalRunTime - g_lastTotalRunTime;
+  g_lastTotalRunTime = totalRunTime;
+
+  TaskSample *samples = g_nextSamples;
+  for (UBaseType_t i = 0; i < count; ++i) {
+    samples[i].handle = g_status[i].xHandle;
+    samples[i].runTime = g_status[i].ulRunTimeCounter;
+    samples[i].cpuPercent = -1.0f;
+    const BaseType_t affinity = xTaskGetAffinity(g_status[i].xHandle);
+    samples[i].core = (affinity >= 0 && affinity < portNUM_PROCESSORS) ? static_cast<int8_t>(affinity) : -1;
+
+    uint32_t previous = 0;
+    if (RUN_TIME_STATS && totalDelta > 0 && previous_run_time(g_status[i].xHandle, previous)) {
+      samples[i].cpuPercent = 100.0f * static_cast<float>(g_status[i].ulRunTimeCounter - previous) /
+                              static_cast<float>(totalDelta);
+    }
+  }
+
+  g_nextSamples = g_samples;
+  g_samples = samples;
+  g_taskCount = count;
+}
+
+void print_report() {
+  const uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+  for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core) {
+    const CoreLoad &load = g_cores[core];
+    // A core whose idle task is starved right now has not recorded the gap yet.
+    const uint32_t currentGap = now - load.lastHookUs;
+    const uint32_t longestGap = (currentGap > load.longestGapUs) ? currentGap : load.longestGapUs;
+    Serial.printf("[DIAG] core%u load %5.1f%% (peak %5.1f%%), idle starved up to %.1f ms\n", core, load.loadPercent,
+                  load.peakLoadPercent, static_cast<float>(longestGap) / 1000.0f);
+  }
+
+  Serial.printf("[DIAG] stepper service gap up to %lu us while moving since the last report\n",
+                static_cast<unsigned long>(stepper_take_max_service_gap_us()));
+  if (STEPPER_STREAM_AXES > 0) {
+    Serial.printf("[DIAG] step stream ran dry %lu times since the last report\n",
+                  static_cast<unsigned long>(step_stream_take_underruns()));
+  }
+
+  const ControlLoopStats control = control_loop_take_stats();
+  Serial.printf("[DIAG] control loop %lu Hz: %lu ticks, %lu overruns, jitter up to %lu us, work up to %lu us\n",
+                static_cast<unsigned long>(control.rate_hz), static_cast<unsigned long>(control.ticks),
+                static_cast<unsigned long>(control.overruns), static_cast<unsigned long>(control.max_jitter_us),
+                static_cast<unsigned long>(control.max_work_us));
+
+  Serial.printf("[DIAG] %-16s %4s %4s %6s %10s\n", "task", "core", "prio", "cpu%", "stack free");
+  for (UBaseType_t i = 0; i < g_taskCount; ++i) {
+    const TaskStatus_t &status = g_status[i];
+    char cpu[8] = "-";
+    if (g_samples[i].cpuPercent >= 0.0f) {
+      snprintf(cpu, sizeof(cpu), "%.1f", g_samples[i].cpuPercent);
+    }
+    // ESP-IDF stacks are sized in bytes, so is the high-water mark.
+    Serial.printf("[DIAG] %-16s %4d %4u %6s %10lu\n", status.pcTaskName, g_samples[i].core,
+                  static_cast<unsigned>(status.uxCurrentPriority), cpu,
+                  static_cast<unsigned long>(status.usStackHighWaterMark));
+  }
+  if (g_truncated) {
+    Serial.printf("[DIAG] task table skipped: could not list %u tasks\n",
+                  static_cast<unsigned>(uxTaskGetNumberOfTasks()));
+  }
+}
+
+void diagnostics_task(void *parameter) {
+  (void)parameter;
+
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    uint32_t bits = 0;
+    const TickType_t elapsed = xTaskGetTickCount() - lastWake;
+    const TickType_t period = pdMS_TO_TICKS(DIAG_SAMPLE_PERIOD_MS);
+    xTaskNotifyWait(0, REPORT_NOTIFY_BIT, &bits, (elapsed < period) ? period - elapsed : 0);
+
+    if (xTaskGetTickCount() - lastWake >= period) {
+      lastWake = xTaskGetTickCount();
+      sample();
+    }
+    if (bits & REPORT_NOTIFY_BIT) {
+      print_report();
+    }
+  }
+}
+}  // namespace
+
+void diagnostics_start() {
+  if (g_diagTask != nullptr) {
+    return;
+  }
+
+  const uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+  for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core) {
+    g_cores[core].lastHookUs = now;
+  }
+  g_lastSampleUs = now;
+
+  esp_register_freertos_idle_hook_for_cpu(idle_hook_core0, 0);
+  if (portNUM_PROCESSORS > 1) {
+    esp_register_freertos_idle_hook_for_cpu(idle_hook_core1, 1);
+  }
+
+  xTaskCreatePinnedToCore(diagnostics_task, "diagnostics", 4096, nullptr, 1, &g_diagTask, 0);
+}
+
+void diagnostics_request_report() {
+  if (g_diagTask != nullptr) {
+    xTaskNotify(g_diagTask, REPORT_NOTIFY_BIT, eSetBits);
+  }
+}
@@ -0,0 +1,113 @@
+#include "encoder.h"
+
+#include <driver/pcnt.h>
+
+namespace {
+// The hardware counter is 16-bit; it wraps to zero at these limits and the
+// ISR folds the wrap into a 32-bit software accumulator.
+constexpr int16_t COUNTER_LIMIT = 16384;
+constexpr uint16_t GLITCH_FILTER_APB_CYCLES = 100;  // ~1.25 us at 80 MHz
+constexpr uint8_t MAX_ENCODERS = PCNT_UNIT_MAX;
+
+volatile int32_t g_accumulator[MAX_ENCODERS] = {};
+uint8_t g_attachedCount = 0;
+bool g_isrServiceInstalled = false;
+portMUX_TYPE g_encoderMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool is_valid_encoder(int8_t encoder) {
+  return encoder >= 0 && encoder < g_attachedCount;
+}
+
+void IRAM_ATTR encoder_overflow_isr(void *arg) {
+  const uint32_t unit = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg));
+  uint32_t status = 0;
+  pcnt_get_event_status(static_cast<pcnt_unit_t>(unit), &status);
+
+  portENTER_CRITICAL_ISR(&g_encoderMux);
+  if (status & PCNT_EVT_H_LIM) {
+    g_accumulator[unit] += COUNTER_LIMIT;
+  } else if (status & PCNT_EVT_L_LIM) {
+    g_accumulator[unit] -= COUNTER_LIMIT;
+  }
+  portEXIT_CRITICAL_ISR(&g_encoderMux);
+}
+
+void configure_channel(pcnt_unit_t unit, pcnt_channel_t channel, gpio_num_t pulse, gpio_num_t ctrl,
+                       pcnt_count_mode_t rising, pcnt_count_mode_t falling) {
+  pcnt_config_t config = {};
+  config.pulse_gpio_num = pulse;
+  config.ctrl_gpio_num = ctrl;
+  config.lctrl_mode = PCNT_MODE_REVERSE;
+  config.hctrl_mode = PCNT_MODE_KEEP;
+  config.pos_mode = rising;
+  config.neg_mode = falling;
+  config.counter_h_lim = COUNTER_LIMIT;
+  config.counter_l_lim = -COUNTER_LIMIT;
+  config.unit = unit;
+  config.channel = channel;
+  pcnt_unit_config(&config);
+}
+}  // namespace
+
+int8_t encoder_attach(gpio_num_t pin_a, gpio_num_t pin_b) {
+  if (pin_a == GPIO_NUM_NC || pin_b == GPIO_NUM_NC || g_attachedCount >= MAX_ENCODERS) {
+    return ENCODER_NONE;
+  }
+
+  const uint8_t index = g_attachedCount;
+  const pcnt_unit_t unit = static_cast<pcnt_unit_t>(index);
+
+  // Both channels count both edges of their pulse pin -> x4 quadrature decoding.
+  configure_channel(unit, PCNT_CHANNEL_0, pin_a, pin_b, PCNT_COUNT_DEC, PCNT_COUNT_INC);
+  configure_channel(unit, PCNT_CHANNEL_1, pin_b, pin_a, PCNT_COUNT_INC, PCNT_COUNT_DEC);
+
+  pcnt_set_filter_value(unit, GLITCH_FILTER_APB_CYCLES);
+  pcnt_filter_enable(unit);
+  pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+  pcnt_event_enable(unit, PCNT_EVT_L_LIM);
+
+  pcnt_counter_pause(unit);
+  pcnt_counter_clear(unit);
+
+  if (!g_isrServiceInstalled) {
+    pcnt_isr_service_install(0);
+    g_isrServiceInstalled = true;
+  }
+  pcnt_isr_handler_add(unit, encoder_overflow_isr, reinterpret_cast<void *>(static_cast<uintptr_t>(index)));
+
+  g_accumulator[index] = 0;
+  pcnt_counter_resume(unit);
+
+  ++g_attachedCount;
+  return static_cast<int8_t>(index);
+}
+
+int32_t encoder_read(int8_t encoder) {
+  if (!is_valid_encoder(encoder)) {
+    return 0;
+  }
+
+  // Retry if the overflow ISR ran between reading the accumulator and the counter.
+  int32_t before = 0;
+  int32_t after = 0;
+  int16_t counter = 0;
+  do {
+    before = g_accumulator[encoder];
+    pcnt_get_counter_value(static_cast<pcnt_unit_t>(encoder), &counter);
+    after = g_accumulator[encoder];
+  } while (before != after);
+
+  return after + counter;
+}
+
+void encoder_write(int8_t encoder, int32_t count) {
+  if (!is_valid_encoder(encoder)) {
+    return;
+  }
+
+  const pcnt_unit_t unit = static_cast<pcnt_unit_t>(encoder);
+  portENTER_CRITICAL(&g_encoderMux);
+  pcnt_counter_clear(unit);
+  g_accumulator[encoder] = count;
+  portEXIT_CRITICAL(&g_encoderMux);
+}
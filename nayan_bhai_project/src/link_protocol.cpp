@@ -0,0 +1,486 @@
+#include "link_protocol.h"
+
+#include <string.h>
+
+#include "crc16.h"
+
+namespace {
+constexpr uint8_t HEADER_BYTES = 5;  // sync0, sync1, type, length
+constexpr uint8_t CRC_BYTES = 2;
+constexpr float MAX_SKEW = 500e-6f;  // crystals beyond 500 ppm apart are treated as a misread
+constexpr uint8_t MIN_SKEW_POINTS = 4;  // fewer span too short a time to tell the skew from noise
+constexpr uint8_t DONE_POLL_RESENDS = 4;  // resend periods between asks for a started batch's BATCH_DONE
+
+struct Writer {
+  uint8_t *data;
+  uint16_t length;
+};
+
+void put_u8(Writer &writer, uint8_t value) {
+  writer.data[writer.length++] = value;
+}
+
+void put_u16(Writer &writer, uint16_t value) {
+  put_u8(writer, static_cast<uint8_t>(value));
+  put_u8(writer, static_cast<uint8_t>(value >> 8));
+}
+
+void put_u32(Writer &writer, uint32_t value) {
+  put_u16(writer, static_cast<uint16_t>(value));
+  put_u16(writer, static_cast<uint16_t>(value >> 16));
+}
+
+void put_u64(Writer &writer, uint64_t value) {
+  put_u32(writer, static_cast<uint32_t>(value));
+  put_u32(writer, static_cast<uint32_t>(value >> 32));
+}
+
+struct Reader {
+  const uint8_t *data;
+  uint16_t length;
+  uint16_t offset;
+};
+
+bool has(const Reader &reader, uint16_t bytes) {
+  return reader.offset + bytes <= reader.length;
+}
+
+uint8_t get_u8(Reader &reader) {
+  return reader.data[reader.offset++];
+}
+
+uint16_t get_u16(Reader &reader) {
+  const uint16_t low = get_u8(reader);
+  return static_cast<uint16_t>(low | (static_cast<uint16_t>(get_u8(reader)) << 8));
+}
+
+uint32_t get_u32(Reader &reader) {
+  const uint32_t low = get_u16(reader);
+  return low | (static_cast<uint32_t>(get_u16(reader)) << 16);
+}
+
+uint64_t get_u64(Reader &reader) {
+  const uint64_t low = get_u32(reader);
+  return low | (static_cast<uint64_t>(get_u32(reader)) << 32);
+}
+
+void send_frame(LinkNode &node, LinkMessage type, const uint8_t *payload, uint16_t length) {
+  uint8_t frame[HEADER_BYTES + LINK_MAX_PAYLOAD + CRC_BYTES];
+  Writer writer = {frame, 0};
+  put_u8(writer, LINK_FRAME_SYNC0);
+  put_u8(writer, LINK_FRAME_SYNC1);
+  put_u8(writer, static_cast<uint8_t>(type));
+  put_u16(writer, length);
+  memcpy(frame + writer.length, payload, length);
+  writer.length += length;
+  put_u16(writer, crc16_ccitt(frame + 2, writer.length - 2));
+  node.config.write(frame, writer.length, node.config.context);
+}
+
+// Microseconds one byte (start, 8 data, stop bit) spends on the wire.
+float byte_time_us(const LinkNode &node) {
+  return (node.config.baud > 0) ? 10e6f / static_cast<float>(node.config.baud) : 0.0f;
+}
+
+void send_time_request(LinkNode &node, uint64_t now_us) {
+  uint8_t payload[8];
+  Writer writer = {payload, 0};
+  put_u64(writer, now_us);
+  node.request_t1 = now_us;
+  node.last_request_us = now_us;
+  send_frame(node, LinkMessage::TIME_REQUEST, payload, writer.length);
+}
+
+void send_batch(LinkNode &node) {
+  const LinkBatch &batch = node.out_batch;
+  uint8_t payload[LINK_MAX_PAYLOAD];
+  Writer writer = {payload, 0};
+  put_u16(writer, batch.id);
+  put_u64(writer, batch.start_us);
+  put_u8(writer, batch.count);
+  for (uint8_t i = 0; i < batch.count; ++i) {
+    const LinkBatchItem &item = batch.items[i];
+    put_u8(writer, item.kind);
+    put_u32(writer, item.start_offset_ms);
+    put_u8(writer, item.motor);
+    put_u32(writer, static_cast<uint32_t>(item.amount));
+    put_u8(writer, item.direction);
+    put_u8(writer, item.speed);
+    put_u8(writer, item.option);
+  }
+  send_frame(node, LinkMessage::BATCH, payload, writer.length);
+}
+
+void send_id(LinkNode &node, LinkMessage type, uint16_t id, int8_t flag) {
+  uint8_t payload[3];
+  Writer writer = {payload, 0};
+  put_u16(writer, id);
+  if (flag >= 0) {
+    put_u8(writer, static_cast<uint8_t>(flag));
+  }
+  send_frame(node, type, payload, writer.length);
+}
+
+// Slope of the least-squares line through the offset updates in the ring.
+// Times and offsets go relative to the oldest point before going to double:
+// boot times apart make them too large for the precision the slope needs.
+float fit_skew(const LinkNode &node) {
+  const uint8_t oldest = static_cast<uint8_t>((node.skew_head + LINK_SKEW_POINTS - node.skew_count) % LINK_SKEW_POINTS);
+  const LinkSyncSample &origin = node.skew_points[oldest];
+  double sumX = 0.0;
+  double sumY = 0.0;
+  double sumXX = 0.0;
+  double sumXY = 0.0;
+  for (uint8_t i = 0; i < node.skew_count; ++i) {
+    const LinkSyncSample &point = node.skew_points[(oldest + i) % LINK_SKEW_POINTS];
+    const double x = static_cast<double>(static_cast<int64_t>(point.local_us - origin.local_us));
+    const double y = static_cast<double>(point.offset_us - origin.offset_us);
+    sumX += x;
+    sumY += y;
+    sumXX += x * x;
+    sumXY += x * y;
+  }
+  const double n = node.skew_count;
+  const double spread = n * sumXX - sumX * sumX;
+  if (spread <= 0.0) {
+    return node.skew;
+  }
+  float skew = static_cast<float>((n * sumXY - sumX * sumY) / spread);
+  if (skew > MAX_SKEW) {
+    skew = MAX_SKEW;
+  } else if (skew < -MAX_SKEW) {
+    skew = -MAX_SKEW;
+  }
+  return skew;
+}
+
+// Picks the exchange with the shortest round trip out of a full window and
+// moves the offset to it; the skew is refitted over the last updates.
+void update_offset(LinkNode &node) {
+  const LinkSyncSample *best = &node.window[0];
+  for (uint8_t i = 1; i < node.window_count; ++i) {
+    if (node.window[i].rtt_us < best->rtt_us) {
+      best = &node.window[i];
+    }
+  }
+
+  node.skew_points[node.skew_head] = *best;
+  node.skew_head = static_cast<uint8_t>((node.skew_head + 1) % LINK_SKEW_POINTS);
+  if (node.skew_count < LINK_SKEW_POINTS) {
+    ++node.skew_count;
+  }
+  if (node.skew_count >= MIN_SKEW_POINTS) {
+    node.skew = fit_skew(node);
+  }
+
+  node.offset_us = best->offset_us;
+  node.offset_local_us = best->local_us;
+  node.error_bound_us = best->rtt_us / 2;
+  node.synced = true;
+  node.window_count = 0;
+  ++node.stats.sync_updates;
+}
+
+void handle_time_reply(LinkNode &node, Reader &reader, uint64_t rx_us) {
+  if (node.config.clock_master || !has(reader, 24)) {
+    return;
+  }
+  const uint64_t t1 = get_u64(reader);
+  const uint64_t t2 = get_u64(reader);
+  const uint64_t t3 = get_u64(reader);
+  if (t1 != node.request_t1 || rx_us < t1 || t3 < t2) {
+    return;  // stale or garbled
+  }
+  node.request_t1 = 0;
+
+  const int64_t rtt = static_cast<int64_t>(rx_us - t1) - static_cast<int64_t>(t3 - t2);
+  LinkSyncSample &sample = node.window[node.window_count++];
+  sample.offset_us = (static_cast<int64_t>(t2 - t1) + static_cast<int64_t>(t3) - static_cast<int64_t>(rx_us)) / 2;
+  sample.rtt_us = (rtt > 0) ? static_cast<uint32_t>(rtt) : 0;
+  sample.local_us = rx_us;
+  if (node.window_count == LINK_SYNC_WINDOW) {
+    update_offset(node);
+  }
+}
+
+// The fields an item's kind uses must name a motor and values this side knows:
+// a peer on a newer protocol, or a bad frame that passed the CRC, must not move anything.
+bool item_valid(const LinkNode &node, const LinkBatchItem &item) {
+  switch (item.kind) {
+    case LINK_ITEM_STEPPER:
+      return item.motor >= 1 && item.motor <= node.config.stepper_motors && item.direction < LINK_DIRECTIONS;
+    case LINK_ITEM_DC:
+      return item.motor < LINK_DC_MOTORS && item.direction < LINK_DIRECTIONS && item.option < LINK_DC_STOP_MODES;
+    case LINK_ITEM_SOLENOID:
+      return item.option < LINK_SOLENOID_STATES;
+    default:
+      return false;
+  }
+}
+
+void handle_batch(LinkNode &node, Reader &reader) {
+  if (!has(reader, 11)) {
+    return;
+  }
+  LinkBatch batch = {};
+  batch.id = get_u16(reader);
+  batch.start_us = get_u64(reader);
+  batch.count = get_u8(reader);
+  if (batch.count == 0 || batch.count > LINK_MAX_BATCH_ITEMS || !has(reader, batch.count * sizeof(LinkBatchItem))) {
+    return;
+  }
+  for (uint8_t i = 0; i < batch.count; ++i) {
+    LinkBatchItem &item = batch.items[i];
+    item.kind = get_u8(reader);
+    item.start_offset_ms = get_u32(reader);
+    item.motor = get_u8(reader);
+    item.amount = static_cast<int32_t>(get_u32(reader));
+    item.direction = get_u8(reader);
+    item.speed = get_u8(reader);
+    item.option = get_u8(reader);
+  }
+
+  // The sender has one batch in flight, so only the latest can be a resend.
+  if (batch.id == node.in_accepted_id) {
+    send_id(node, LinkMessage::BATCH_ACK, batch.id, 1);
+    if (batch.id == node.in_completed_id) {
+      send_id(node, LinkMessage::BATCH_DONE, batch.id, -1);
+    }
+    return;
+  }
+  bool valid = true;
+  for (uint8_t i = 0; i < batch.count; ++i) {
+    valid = valid && item_valid(node, batch.items[i]);
+  }
+  if (!valid || node.in_count == LINK_RX_BATCHES) {
+    send_id(node, LinkMessage::BATCH_ACK, batch.id, 0);
+    return;
+  }
+
+  node.in_batches[(node.in_head + node.in_count) % LINK_RX_BATCHES] = batch;
+  ++node.in_count;
+  node.in_accepted_id = batch.id;
+  send_id(node, LinkMessage::BATCH_ACK, batch.id, 1);
+}
+
+void handle_frame(LinkNode &node, LinkMessage type, Reader &reader, uint64_t rx_us, uint64_t now_us) {
+  switch (type) {
+    case LinkMessage::TIME_REQUEST: {
+      if (!node.config.clock_master || !has(reader, 8)) {
+        return;
+      }
+      uint8_t payload[24];
+      Writer writer = {payload, 0};
+      put_u64(writer, get_u64(reader));
+      put_u64(writer, rx_us);
+      put_u64(writer, now_us);
+      send_frame(node, LinkMessage::TIME_REPLY, payload, writer.length);
+      return;
+    }
+    case LinkMessage::TIME_REPLY:
+      handle_time_reply(node, reader, rx_us);
+      return;
+    case LinkMessage::BATCH:
+      handle_batch(node, reader);
+      return;
+    case LinkMessage::BATCH_ACK: {
+      if (!has(reader, 3)) {
+        return;
+      }
+      const uint16_t id = get_u16(reader);
+      const bool accepted = get_u8(reader) != 0;
+      if (node.out_pending && id == node.out_batch.id) {
+        node.out_pending = false;
+        if (!accepted) {
+          node.out_failed_id = id;
+        }
+      }
+      return;
+    }
+    case LinkMessage::BATCH_DONE:
+      if (has(reader, 2)) {
+        const uint16_t id = get_u16(reader);
+        if (link_seq_reached(id, node.out_done_id)) {
+          node.out_done_id = id;
+        }
+      }
+      return;
+    case LinkMessage::BARRIER: {
+      if (!has(reader, 3)) {
+        return;
+      }
+      const uint16_t id = get_u16(reader);
+      const bool reply = get_u8(reader) != 0;
+      if (link_seq_reached(id, node.peer_barrier)) {
+        node.peer_barrier = id;
+      }
+      // Answer once, so a station that already passed cannot leave the peer waiting.
+      if (!reply && node.barrier_reached != 0 && link_seq_reached(node.barrier_reached, id)) {
+        send_id(node, LinkMessage::BARRIER, node.barrier_reached, 1);
+      }
+      return;
+    }
+  }
+}
+}  // namespace
+
+void link_init(LinkNode &node, const LinkConfig &config) {
+  memset(&node, 0, sizeof(node));
+  node.config = config;
+}
+
+void link_receive(LinkNode &node, const uint8_t *data, size_t length, uint64_t now_us) {
+  const float byteUs = byte_time_us(node);
+
+  for (size_t i = 0; i < length; ++i) {
+    const uint8_t byte = data[i];
+    if (node.rx_length == 0 && byte != LINK_FRAME_SYNC0) {
+      continue;
+    }
+    if (node.rx_length == 1 && byte != LINK_FRAME_SYNC1) {
+      node.rx_length = (byte == LINK_FRAME_SYNC0) ? 1 : 0;
+      continue;
+    }
+    node.rx[node.rx_length++] = byte;
+
+    if (node.rx_length == HEADER_BYTES) {
+      const uint16_t payload = static_cast<uint16_t>(node.rx[3] | (node.rx[4] << 8));
+      if (payload > LINK_MAX_PAYLOAD) {
+        node.rx_length = 0;
+        continue;
+      }
+      node.rx_expected = HEADER_BYTES + payload + CRC_BYTES;
+    }
+    if (node.rx_length < HEADER_BYTES || node.rx_length < node.rx_expected) {
+      continue;
+    }
+
+    const uint16_t frameLength = node.rx_length;
+    node.rx_length = 0;
+    const uint16_t crc = static_cast<uint16_t>(node.rx[frameLength - 2] | (node.rx[frameLength - 1] << 8));
+    if (crc16_ccitt(node.rx + 2, frameLength - 2 - CRC_BYTES) != crc) {
+      ++node.stats.crc_errors;
+      continue;
+    }
+    ++node.stats.frames;
+
+    // Stamp the frame's first byte: back out the bytes behind it in this chunk and its own length.
+    const float behindUs = byteUs * static_cast<float>((length - 1 - i) + (frameLength - 1));
+    const uint64_t rxUs = now_us - static_cast<uint64_t>(behindUs);
+    Reader reader = {node.rx + HEADER_BYTES, static_cast<uint16_t>(frameLength - HEADER_BYTES - CRC_BYTES), 0};
+    handle_frame(node, static_cast<LinkMessage>(node.rx[2]), reader, rxUs, now_us);
+  }
+}
+
+void link_service(LinkNode &node, uint64_t now_us) {
+  if (!node.config.clock_master) {
+    // Request faster until the first offset; a lost reply just ends up overwritten.
+    const uint32_t period = node.synced ? node.config.sync_period_us : node.config.sync_period_us / 4;
+    if (node.last_request_us == 0 || now_us - node.last_request_us >= period) {
+      send_time_request(node, now_us);
+    }
+  }
+
+  if (node.out_pending && now_us - node.out_sent_us >= node.config.resend_us) {
+    if (node.out_retries >= LINK_MAX_RETRIES) {
+      node.out_pending = false;
+      node.out_failed_id = node.out_batch.id;
+    } else {
+      ++node.out_retries;
+      ++node.stats.resends;
+      node.out_sent_us = now_us;
+      send_batch(node);
+    }
+  } else if (node.out_batch.id != 0 && node.out_failed_id != node.out_batch.id &&
+             !link_batch_done(node, node.out_batch.id) && link_local_time(node, node.out_batch.start_us) <= now_us &&
+             now_us - node.out_sent_us >= DONE_POLL_RESENDS * node.config.resend_us) {
+    // Nothing resends a lost BATCH_DONE; the peer answers a resend of its batch with it.
+    ++node.stats.resends;
+    node.out_sent_us = now_us;
+    send_batch(node);
+  }
+
+  if (node.barrier_reached != 0 && !link_seq_reached(node.peer_barrier, node.barrier_reached) &&
+      now_us - node.barrier_sent_us >= node.config.resend_us) {
+    ++node.stats.resends;
+    node.barrier_sent_us = now_us;
+    send_id(node, LinkMessage::BARRIER, node.barrier_reached, 0);
+  }
+}
+
+uint64_t link_shared_time(const LinkNode &node, uint64_t local_us) {
+  if (node.config.clock_master || !node.synced) {
+    return local_us;
+  }
+  const float elapsed = static_cast<float>(static_cast<int64_t>(local_us - node.offset_local_us));
+  return local_us + node.offset_us + static_cast<int64_t>(node.skew * elapsed);
+}
+
+uint64_t link_local_time(const LinkNode &node, uint64_t shared_us) {
+  if (node.config.clock_master || !node.synced) {
+    return shared_us;
+  }
+  // The skew term changes by nanoseconds over the offset itself, one step is enough.
+  const uint64_t guess = shared_us - node.offset_us;
+  return shared_us - (link_shared_time(node, guess) - guess);
+}
+
+bool link_is_synced(const LinkNode &node) {
+  return node.config.clock_master || node.synced;
+}
+
+uint16_t link_send_batch(LinkNode &node, uint64_t start_us, const LinkBatchItem *items, uint8_t count,
+                         uint64_t now_us) {
+  if (node.out_pending || items == nullptr || count == 0 || count > LINK_MAX_BATCH_ITEMS) {
+    return 0;
+  }
+
+  if (++node.next_batch_id == 0) {
+    node.next_batch_id = 1;
+  }
+  LinkBatch &batch = node.out_batch;
+  batch.id = node.next_batch_id;
+  batch.start_us = start_us;
+  batch.count = count;
+  memcpy(batch.items, items, count * sizeof(LinkBatchItem));
+
+  node.out_pending = true;
+  node.out_retries = 0;
+  node.out_sent_us = now_us;
+  send_batch(node);
+  return batch.id;
+}
+
+bool link_batch_done(const LinkNode &node, uint16_t id) {
+  return id != 0 && node.out_done_id != 0 && link_seq_reached(node.out_done_id, id);
+}
+
+bool link_batch_failed(const LinkNode &node, uint16_t id) {
+  return id == 0 || node.out_failed_id == id;
+}
+
+const LinkBatch *link_peek_batch(const LinkNode &node) {
+  return (node.in_count > 0) ? &node.in_batches[node.in_head] : nullptr;
+}
+
+void link_complete_batch(LinkNode &node) {
+  if (node.in_count == 0) {
+    return;
+  }
+  const uint16_t id = node.in_batches[node.in_head].id;
+  node.in_head = (node.in_head + 1) % LINK_RX_BATCHES;
+  --node.in_count;
+  node.in_completed_id = id;
+  send_id(node, LinkMessage::BATCH_DONE, id, -1);
+}
+
+void link_barrier_arrive(LinkNode &node, uint16_t id, uint64_t now_us) {
+  node.barrier_reached = id;
+  node.barrier_sent_us = now_us;
+  send_id(node, LinkMessage::BARRIER, id, 0);
+}
+
+bool link_barrier_passed(const LinkNode &node, uint16_t id) {
+  return id != 0 && node.barrier_reached != 0 && node.peer_barrier != 0 &&
+         link_seq_reached(node.barrier_reached, id) && link_seq_reached(node.peer_barrier, id);
+}
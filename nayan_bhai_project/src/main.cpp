@@ -1,21 +1,30 @@
 #include <Arduino.h>
-#include <FastLED.h>
 
+#include "benchmark.h"
+#include "boot_profile.h"
 #include "button_matrix.h"
+#include "console.h"
+#include "control_loop.h"
+#include "current_sense.h"
+#include "cycle_checkpoint.h"
 #include "dc_motor.h"
+#include "diagnostics.h"
 #include "main.h"
+#include "motion_batch.h"
+#include "motion_snapshot.h"
+#include "station_link.h"
+#include "status_led.h"
 #include "stepper_motor.h"
-
-static CRGB g_leds[1];
+#include "stepper_profile_table.h"
+#include "telemetry.h"
+#include "trace.h"
 
 void rgb_led_init() {
-  FastLED.addLeds<WS2812, PIN_RGB_LED, GRB>(g_leds, 1);
-  FastLED.setBrightness(RGB_LED_BRIGHTNESS);
+  status_led_init();
 }
 
 void set_rgb_led(uint8_t r, uint8_t g, uint8_t b) {
-  g_leds[0] = CRGB(r, g, b);
-  FastLED.show();
+  status_led_set(LedPattern::SOLID, r, g, b);
 }
 
 // Global state definitions
@@ -27,12 +36,38 @@ const StepperMove Task7[] = {
   {3, 5000, Direction::CW},
   {2, 2500, Direction::CCW},
 };
+
+const MotionBatchItem Task10[] = {
+  batch_solenoid(SolenoidState::OFF),
+  batch_dc({DcMotorId::M2_300, 353, 255, Direction::CCW, DcStopMode::DEFAULT}),
+};
+
+constexpr uint8_t CYCLE_TASK_COUNT = 10;
+
+// Where loop() stands in the sequence, checkpointed before every task.
+uint32_t g_cycle = 0;
+uint8_t g_nextTask = 0;
+CycleCheckpoint g_checkpoint;
+volatile bool g_resumeOffered = false;  // a checkpoint was found at boot and not yet taken or dropped
+
+// Stall events arrive inside stepper_service(); loop() prints them between tasks.
+constexpr uint8_t STALL_REPORT_DEPTH = 4;
+StepperStallEvent g_stallReports[STALL_REPORT_DEPTH];
+uint8_t g_stallReportCount = 0;
+uint8_t g_stallReportsLost = 0;
+portMUX_TYPE g_stallReportMux = portMUX_INITIALIZER_UNLOCKED;
 }
 
 void on_button_event(ButtonEvent event) {
-  const char* name = button_name(event.button);
-  const char* state = (event.state == ButtonState::PRESSED) ? "PRESSED" : "RELEASED";
-  Serial.printf("[BTN] %s %s\n", name, state);
+  if (event.state == ButtonState::CHORD) {
+    Serial.printf("[BTN] %s+%s CHORD\n", button_name(event.button), button_name(event.other));
+  } else {
+    Serial.printf("[BTN] %s %s\n", button_name(event.button), button_state_name(event.state));
+  }
+  if (event.state == ButtonState::PRESSED || event.state == ButtonState::RELEASED) {
+    trace_instant(TraceEvent::BUTTON, TraceTrack::CORE,
+                  (static_cast<int32_t>(event.button) << 1) | (event.state == ButtonState::PRESSED ? 1 : 0));
+  }
 
   // BTN1 = Stepper 1 CW (hold) / STOP (release)
   if (event.button == ButtonId::BTN1) {
@@ -70,9 +105,20 @@ void on_button_event(ButtonEvent event) {
     // if (event.state == ButtonState::RELEASED) stepper_stop(3);
   }
 
+  // BTN0 before START = drop the checkpoint found at boot and start cold
+  if (event.button == ButtonId::BTN0) {
+    if (event.state == ButtonState::PRESSED && g_resumeOffered && !start_button_pressed) {
+      g_resumeOffered = false;
+      cycle_checkpoint_clear();
+      set_rgb_led(255, 255, 255); // WHITE = waiting for start
+      Serial.println("[CKPT] checkpoint dropped - A starts a cold cycle");
+    }
+  }
+
   if (event.button == ButtonId::BTNA) {
     if (event.state == ButtonState::PRESSED) {
       g_paused = false;
+      trace_instant(TraceEvent::RESUME);
       start_button_pressed = true;
       set_rgb_led(0, 255, 0); // GREEN = running
     }
@@ -80,76 +126,339 @@ void on_button_event(ButtonEvent event) {
 
   if (event.button == ButtonId::BTNB) {
     if (event.state == ButtonState::PRESSED) {
+      benchmark_mark_pause();
       g_paused = true;
-      // Instantly stop all actuators
-      stepper_all_stop();
-      dc_stop_all();
+      trace_instant(TraceEvent::PAUSE);
+      // The running step and DC commands see g_paused, bring their actuators to
+      // rest and keep what they had left; stopping them here would lose that.
       set_rgb_led(255, 0, 0); // RED = paused
       Serial.println("[BTN] PAUSE - press A to resume");
     }
   }
 }
 
+// Service chords, on their own low-priority subscriber.
+void on_diag_button_event(ButtonEvent event) {
+  // BTNSTAR + BTNHASH chord = print task/stack/load diagnostics
+  if (button_is_chord(event, ButtonId::BTNSTAR, ButtonId::BTNHASH)) {
+    diagnostics_request_report();
+  }
+
+  // BTNC + BTND chord = run the benchmark battery (before START only)
+  if (button_is_chord(event, ButtonId::BTNC, ButtonId::BTND)) {
+    benchmark_request();
+  }
+}
+
+void on_stepper_stall(const StepperStallEvent &event) {
+  portENTER_CRITICAL(&g_stallReportMux);
+  if (g_stallReportCount < STALL_REPORT_DEPTH) {
+    g_stallReports[g_stallReportCount++] = event;
+  } else {
+    ++g_stallReportsLost;
+  }
+  portEXIT_CRITICAL(&g_stallReportMux);
+  trace_instant(TraceEvent::STALL, static_cast<TraceTrack>(static_cast<uint8_t>(TraceTrack::STEPPER_1) +
+                                                           event.motor_number - 1),
+                event.following_error);
+
+  if (event.gave_up) {
+    // Hold the sequence until the operator clears the jam and presses A; the
+    // blocking move waits for that and then finishes the steps it had left.
+    g_paused = true;
+    trace_instant(TraceEvent::PAUSE);
+    status_led_set(LedPattern::ERROR_CODE, 255, 0, 0, event.motor_number); // RED blinks = jammed axis number
+  }
+}
+
+void on_dc_current_fault(const DcCurrentEvent &event) {
+  Serial.printf("[DC] motor %u %s, %.0f mA (peak %.0f mA) - stopped\n", static_cast<unsigned>(event.motor),
+                current_fault_name(event.fault), event.current_ma, event.peak_ma);
+
+  // Hold the sequence until the operator clears the fault and presses A
+  g_paused = true;
+  trace_instant(TraceEvent::PAUSE);
+  status_led_set(LedPattern::ERROR_CODE, 255, 80, 0, static_cast<uint8_t>(event.motor) + 1); // ORANGE blinks = DC motor id + 1
+}
+
+static volatile SolenoidState g_solenoid = SolenoidState::OFF;
+
 void solenoid_state(SolenoidState state) {
+  if (state != g_solenoid) {
+    if (state == SolenoidState::ON) {
+      trace_begin(TraceEvent::SOLENOID_ON, TraceTrack::SOLENOID);
+    } else {
+      trace_end(TraceEvent::SOLENOID_ON, TraceTrack::SOLENOID);
+    }
+  }
+  g_solenoid = state;
   digitalWrite(static_cast<uint8_t>(PIN_SOLENOID_RLY), state == SolenoidState::ON ? LOW : HIGH);
 }
 
-void setup() {
-  Serial.begin(115200);
-
-  rgb_led_init();
-  set_rgb_led(255, 255, 255); // WHITE = waiting for start
+SolenoidState solenoid_get_state() {
+  return g_solenoid;
+}
 
+// Called by the Arduino core before setup(): put every actuator output in its
+// safe state within the first milliseconds after reset, before anything slow runs.
+extern "C" void initVariant() {
+  stepper_safe_state();
+  dc_motor_safe_state();
   pinMode(static_cast<uint8_t>(PIN_SOLENOID_RLY), OUTPUT);
   solenoid_state(SolenoidState::OFF); // Turn OFF solenoid at startup
+  boot_mark("safe_outputs");
+}
+
+namespace {
+// Operator I/O comes up on core 0 while setup() configures the actuators on core 1.
+void init_operator_io_task(void *parameter) {
+  TaskHandle_t setupTask = static_cast<TaskHandle_t>(parameter);
+
+  rgb_led_init();
+  boot_mark("rgb_led_init");
+
+  button_matrix_init();
+  button_subscribe(on_button_event, "btn_control", 3);
+  button_subscribe(on_diag_button_event, "btn_diag", 1);
+  boot_mark("button_matrix_init");
+
+  xTaskNotifyGive(setupTask);
+  vTaskDelete(nullptr);
+}
+}  // namespace
+
+void setup() {
+  boot_mark("setup");
+  xTaskCreatePinnedToCore(init_operator_io_task, "boot_io", 4096, xTaskGetCurrentTaskHandle(), 5, nullptr, 0);
 
   // Initialize framework with acceleration
   stepper_init();
   stepper_set_config(12000.0f, 8000.0f, 8000.0f);  // 12000 steps/sec, 8000 accel
+  if (STEPPER_USE_PROFILE_TABLE) {
+    // Per-move profiles from tools/profile_tuner; unmatched moves keep the config above
+    stepper_set_profile_table(kStepperProfileTable, kStepperProfileTableCount);
+  }
+  stepper_set_stall_callback(on_stepper_stall);
+  boot_mark("stepper_init");
 
   dc_motor_init();
   dc_stop_all();
+  current_sense_set_callback(on_dc_current_fault);
+  current_sense_init();
+  boot_mark("dc_motor_init");
 
-  button_matrix_init(on_button_event);
+  motion_snapshot_init();
 
-  Serial.println("System initialized - sequential loop script mode");
-}
+  // Times DC runs from here on, including while loop() sits in delay().
+  control_loop_start(CONTROL_LOOP_RATE_HZ);
+  boot_mark("control_loop");
 
-void loop() {
-  while(start_button_pressed){
-  // Task1: Run 300 RPM DC motor1 clockwise
-  dc1_300_run_ms_blocking(100, 255, Direction::CW);
+  // Both stations sync while waiting for start.
+  if (STATION_LINK_ROLE != 0) {
+    station_link_start(STATION_LINK_ROLE == 1);
+    boot_mark("station_link");
+  }
 
-  // Task2: Run stepper 1 counterclockwise for 3 inch (set steps of the motor)
-  stepper_run_steps_blocking(1, 5000, Direction::CCW);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  set_rgb_led(255, 255, 255); // WHITE = waiting for start
+  boot_mark("ready");
 
-  // Task3: Run stepper 2 clockwise for 1 inch (set steps of the motor)
-  stepper_run_steps_blocking(2, 2500, Direction::CW);
+  // Deferred until the machine is ready: USB CDC, logging and the background services.
+  // Never block on a USB host that is not listening.
+  Serial.begin(115200);
+  Serial.setTxTimeoutMs(0);
 
-  // Task4: Turn on the solenoid
-  solenoid_state(SolenoidState::ON);
+  if (TELEMETRY_BOOT_RATE_HZ > 0) {
+    telemetry_start(TELEMETRY_BOOT_RATE_HZ);
+  }
 
-  // Task5: Run 300 RPM DC motor2 clockwise
-  dc2_300_run_ms_blocking(353, 255, Direction::CW);
+  diagnostics_start();
+  console_init();
+  boot_mark("services");
 
-  // Task6: Run stepper 1 clockwise for 3 inch (set steps of the motor)
-  stepper_run_steps_blocking(1, 5000, Direction::CW);
+  Serial.println("System initialized - sequential loop script mode");
+  boot_report(Serial);
+
+  const CheckpointSource source = cycle_checkpoint_load(g_checkpoint);
+  if (source != CheckpointSource::NONE) {
+    // After a power loss only NVS survives and the open-loop axes must still be
+    // where the checkpoint left them; the operator confirms that by pressing A.
+    Serial.printf("[CKPT] cycle %lu stopped before Task%u (%s) - A = resume, 0 = start cold\n",
+                  static_cast<unsigned long>(g_checkpoint.cycle), g_checkpoint.task + 1,
+                  source == CheckpointSource::RTC ? "RTC, axes tracked" : "NVS, check the axes");
+    g_resumeOffered = true;
+    status_led_set(LedPattern::BLINK, 0, 255, 255); // CYAN blinks = resume offered
+  }
+}
 
-  // Task7: Run Stepper 3 clockwise for 3 inch and Stepper 2 counterclockwise for 1 inch at the same time (set steps of the motor)
-  stepper_run_steps_batch_blocking(Task7, static_cast<uint8_t>(sizeof(Task7) / sizeof(Task7[0])));
+namespace {
+void run_task(uint8_t task) {
+  switch (task) {
+    case 0:
+      // Task1: Run 300 RPM DC motor1 clockwise
+      dc1_300_run_ms_blocking(100, 255, Direction::CW);
+      break;
+    case 1:
+      // Task2: Run stepper 1 counterclockwise for 3 inch (set steps of the motor)
+      stepper_run_steps_blocking(1, 5000, Direction::CCW);
+      break;
+    case 2:
+      // Task3: Run stepper 2 clockwise for 1 inch (set steps of the motor)
+      stepper_run_steps_blocking(2, 2500, Direction::CW);
+      break;
+    case 3:
+      // Task4: Turn on the solenoid
+      solenoid_state(SolenoidState::ON);
+      break;
+    case 4:
+      // Task5: Run 300 RPM DC motor2 clockwise
+      dc2_300_run_ms_blocking(353, 255, Direction::CW);
+      break;
+    case 5:
+      // Task6: Run stepper 1 clockwise for 3 inch (set steps of the motor)
+      stepper_run_steps_blocking(1, 5000, Direction::CW);
+      break;
+    case 6:
+      // Task7: Run Stepper 3 clockwise for 3 inch and Stepper 2 counterclockwise for 1 inch at the same time (set steps of the motor)
+      stepper_run_steps_batch_blocking(Task7, static_cast<uint8_t>(sizeof(Task7) / sizeof(Task7[0])));
+      break;
+    case 7: {
+      // Task8: Run 3000 RPM DC motor clockwise
+      DcTimedMove move = {DcMotorId::M3000, 210, 100, Direction::CW, DcStopMode::DEFAULT};
+      if (DC_BOOST_SHORT_RUNS) {
+        move = dc_boost_move(move);
+      }
+      dc_3000_run_ms_blocking(move.time_ms, move.speed, move.direction);
+      break;
+    }
+    case 8:
+      // Task9: Run stepper 3 counterclockwise for 3 inch (set steps of the motor)
+      stepper_run_steps_blocking(3, 5000, Direction::CCW);
+      break;
+    case 9:
+      // Task10: Turn off the solenoid and Run 300 RPM DC motor2 counterclockwise at the same time
+      motion_batch_run_blocking(Task10, static_cast<uint8_t>(sizeof(Task10) / sizeof(Task10[0])));
+      break;
+  }
+}
 
-  // Task8: Run 3000 RPM DC motor clockwise
-  dc_3000_run_ms_blocking(210, 100, Direction::CW);
+void report_stall_events() {
+  StepperStallEvent events[STALL_REPORT_DEPTH];
+  portENTER_CRITICAL(&g_stallReportMux);
+  const uint8_t count = g_stallReportCount;
+  const uint8_t lost = g_stallReportsLost;
+  memcpy(events, g_stallReports, sizeof(StepperStallEvent) * count);
+  g_stallReportCount = 0;
+  g_stallReportsLost = 0;
+  portEXIT_CRITICAL(&g_stallReportMux);
+
+  for (uint8_t i = 0; i < count; ++i) {
+    const StepperStallEvent &event = events[i];
+    Serial.printf("[STALL] stepper %u error %ld steps, corrected %ld -> %ld, retry %u%s\n",
+                  event.motor_number, static_cast<long>(event.following_error),
+                  static_cast<long>(event.commanded_position), static_cast<long>(event.encoder_position),
+                  event.retry, event.gave_up ? " - GAVE UP" : "");
+  }
+  if (lost > 0) {
+    Serial.printf("[STALL] %u more events not shown\n", lost);
+  }
+}
 
-  // Task9: Run stepper 3 counterclockwise for 3 inch (set steps of the motor)
-  stepper_run_steps_blocking(3, 5000, Direction::CCW);
+// Records that `task` is next, with the actuators at rest between tasks.
+void checkpoint_task(uint8_t task) {
+  CycleCheckpoint checkpoint = {};
+  checkpoint.cycle = g_cycle;
+  checkpoint.task = task;
+  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+    checkpoint.position[index] = stepper_get_position(index + 1);
+  }
+  checkpoint.solenoid = solenoid_get_state();
+  cycle_checkpoint_save(checkpoint);
+}
 
-  // Task10: Turn off the solenoid and Run 300 RPM DC motor2 counterclockwise at the same time
-  solenoid_state(SolenoidState::OFF); // Task10.1: Turn off the solenoid
-  dc2_300_run_ms_blocking(353, 255, Direction::CCW); // Task10.2: Run 300 RPM DC motor2 counterclockwise
+// Puts the machine back where the checkpointed task started, so it can run
+// again in full. A task cut short by the reset is never continued midway:
+// timed DC runs have no position to return to.
+void resume_from_checkpoint() {
+  int32_t live[STEPPER_MOTOR_COUNT];
+  const bool tracked = cycle_checkpoint_live_positions(live);
+  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+    stepper_set_position(index + 1, tracked ? live[index] : g_checkpoint.position[index]);
+  }
 
-  // Small gap before repeating the sequence
-  delay(1000);
+  if (tracked) {
+    bool moving = true;
+    bool sent = false;
+    while (moving) {
+      if (g_paused) {
+        // Stops along the ramps like the sequence's own moves; the targets are
+        // absolute, so the way back is sent again from wherever they stopped.
+        int32_t remaining[STEPPER_MOTOR_COUNT] = {};
+        stepper_hold((1U << STEPPER_MOTOR_COUNT) - 1, remaining);
+        while (g_paused) delay(10);
+        sent = false;
+      }
+      if (!sent) {
+        for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+          stepper_move_to(index + 1, g_checkpoint.position[index]);
+        }
+        sent = true;
+      }
+
+      stepper_service();
+      moving = false;
+      for (uint8_t motor = 1; motor <= STEPPER_MOTOR_COUNT; ++motor) {
+        moving = moving || stepper_get_motion_state(motor) != StepperMotionState::IDLE;
+      }
+      delay(0);
+    }
   }
-  delay(100);
-}
\ No newline at end of file
+
+  solenoid_state(g_checkpoint.solenoid);
+  g_cycle = g_checkpoint.cycle;
+  g_nextTask = g_checkpoint.task;
+  g_resumeOffered = false;
+  Serial.printf("[CKPT] resuming cycle %lu at Task%u\n", static_cast<unsigned long>(g_cycle), g_nextTask + 1);
+}
+}  // namespace
+
+void loop() {
+  while(start_button_pressed){
+  if (g_resumeOffered) {
+    resume_from_checkpoint();
+  }
+  trace_begin(TraceEvent::LOOP_CYCLE);
+
+  for (uint8_t task = g_nextTask; task < CYCLE_TASK_COUNT; ++task) {
+    checkpoint_task(task);
+    run_task(task);
+    report_stall_events();
+    // At rest between tasks: take what the neighbour scheduled here meanwhile.
+    station_link_service();
+  }
+  g_nextTask = 0;
+  ++g_cycle;
+  checkpoint_task(0);
+  cycle_checkpoint_persist();
+
+  trace_end(TraceEvent::LOOP_CYCLE);
+
+  // Small gap before repeating the sequence, open to the neighbour's batches
+  const uint32_t gapStart = millis();
+  while (millis() - gapStart < 1000) {
+    station_link_service();
+    delay(1);
+  }
+  }
+
+  report_stall_events();
+
+  if (benchmark_take_request()) {
+    benchmark_run(Serial);
+    set_rgb_led(255, 255, 255); // WHITE = waiting for start
+  }
+
+  // Batches the neighbour scheduled here; poll often enough to meet their start times.
+  station_link_service();
+  delay(STATION_LINK_ROLE != 0 ? 1 : 100);
+}
@@ -0,0 +1,140 @@
+#include "motion_batch.h"
+#include "main.h"
+
+namespace {
+void start_item(const MotionBatchItem &item) {
+  switch (item.kind) {
+    case MotionBatchKind::STEPPER:
+      stepper_run_steps(item.stepper.motor_number, item.stepper.steps, item.stepper.direction);
+      break;
+    case MotionBatchKind::DC:
+      dc_run_ms(item.dc);
+      break;
+    case MotionBatchKind::SOLENOID:
+      solenoid_state(item.solenoid);
+      break;
+  }
+}
+
+bool is_item_complete(const MotionBatchItem &item) {
+  switch (item.kind) {
+    case MotionBatchKind::STEPPER:
+      // A move that gave up on a stall waits for the pause to finish it.
+      return stepper_get_motion_state(item.stepper.motor_number) == StepperMotionState::IDLE &&
+             !stepper_has_stalled_move(item.stepper.motor_number);
+    case MotionBatchKind::DC:
+      return !dc_is_busy(item.dc.motor);
+    case MotionBatchKind::SOLENOID:
+      return true;
+  }
+  return true;
+}
+
+// Steppers only move while serviced here, so they are brought to rest on pause;
+// DC runs are held by dc_service() on their own.
+void hold_steppers_while_paused(const MotionBatchItem *items, uint8_t count, const bool *started) {
+  uint16_t mask = 0;
+  for (uint8_t i = 0; i < count; ++i) {
+    if (started[i] && items[i].kind == MotionBatchKind::STEPPER && items[i].stepper.motor_number >= 1 &&
+        items[i].stepper.motor_number <= STEPPER_MOTOR_COUNT) {
+      mask |= 1U << (items[i].stepper.motor_number - 1);
+    }
+  }
+
+  int32_t remaining[STEPPER_MOTOR_COUNT] = {};
+  stepper_hold(mask, remaining);
+  while (g_paused) delay(10);
+  stepper_resume(mask, remaining);
+}
+}  // namespace
+
+MotionBatchItem batch_stepper(const StepperMove &move, uint32_t start_offset_ms) {
+  MotionBatchItem item = {};
+  item.kind = MotionBatchKind::STEPPER;
+  item.start_offset_ms = start_offset_ms;
+  item.stepper = move;
+  return item;
+}
+
+MotionBatchItem batch_dc(const DcTimedMove &move, uint32_t start_offset_ms) {
+  MotionBatchItem item = {};
+  item.kind = MotionBatchKind::DC;
+  item.start_offset_ms = start_offset_ms;
+  item.dc = move;
+  return item;
+}
+
+MotionBatchItem batch_solenoid(SolenoidState state, uint32_t start_offset_ms) {
+  MotionBatchItem item = {};
+  item.kind = MotionBatchKind::SOLENOID;
+  item.start_offset_ms = start_offset_ms;
+  item.solenoid = state;
+  return item;
+}
+
+void motion_batch_run_blocking(const MotionBatchItem *items, uint8_t item_count) {
+  if (items == nullptr || item_count == 0) {
+    return;
+  }
+
+  const uint8_t count = (item_count > MOTION_BATCH_MAX_ITEMS) ? MOTION_BATCH_MAX_ITEMS : item_count;
+  bool started[MOTION_BATCH_MAX_ITEMS] = {};
+  uint8_t startedCount = 0;
+  uint32_t activeMs = 0;
+  uint32_t lastMs = millis();
+
+  for (;;) {
+    if (g_paused) {
+      hold_steppers_while_paused(items, count, started);
+      lastMs = millis();
+    }
+
+    const uint32_t now = millis();
+    activeMs += now - lastMs;
+    lastMs = now;
+
+    for (uint8_t i = 0; i < count; ++i) {
+      if (!started[i] && items[i].start_offset_ms <= activeMs) {
+        start_item(items[i]);
+        started[i] = true;
+        ++startedCount;
+      }
+    }
+
+    stepper_service();
+    dc_service();
+
+    bool allComplete = startedCount == count;
+    for (uint8_t i = 0; i < count && allComplete; ++i) {
+      allComplete = is_item_complete(items[i]);
+    }
+
+    if (allComplete) {
+      break;
+    }
+
+    delay(0);
+  }
+}
+
+uint32_t motion_batch_estimate_us(const MotionBatchItem *items, uint8_t item_count, const MotionProfile &profile) {
+  if (items == nullptr) {
+    return 0;
+  }
+
+  uint32_t longest = 0;
+  for (uint8_t i = 0; i < item_count && i < MOTION_BATCH_MAX_ITEMS; ++i) {
+    uint32_t duration = 0;
+    if (items[i].kind == MotionBatchKind::STEPPER) {
+      duration = stepper_estimate_move_us(items[i].stepper.motor_number, items[i].stepper.steps, profile);
+    } else if (items[i].kind == MotionBatchKind::DC) {
+      duration = dc_estimate_run_us(items[i].dc);
+    }
+    // Saturates like the estimates it adds up.
+    const uint64_t end = static_cast<uint64_t>(items[i].start_offset_ms) * 1000ULL + duration;
+    if (end > longest) {
+      longest = (end > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(end);
+    }
+  }
+  return longest;
+}
@@ -0,0 +1,110 @@
+#include "motion_profile.h"
+
+#include <math.h>
+
+namespace {
+uint32_t seconds_to_us(float seconds) {
+  if (seconds <= 0.0f) {
+    return 0;
+  }
+  return static_cast<uint32_t>(seconds * 1000000.0f + 0.5f);
+}
+}  // namespace
+
+MotionProfile motion_profile_from_config(float speed, float acceleration, float deceleration,
+                                         const MotionProfile &fallback) {
+  MotionProfile profile = fallback;
+
+  if (speed <= 0.0f) {
+    speed = fallback.max_speed;
+  }
+
+  const bool noRampRequested = (acceleration == -1.0f) || (deceleration == -1.0f);
+  if (noRampRequested) {
+    acceleration = fallback.acceleration;
+    deceleration = fallback.deceleration;
+  }
+
+  if (acceleration <= 0.0f) {
+    acceleration = fallback.acceleration;
+  }
+  if (deceleration <= 0.0f) {
+    deceleration = fallback.deceleration;
+  }
+
+  profile.max_speed = speed;
+  profile.acceleration = acceleration;
+  profile.deceleration = deceleration;
+  profile.no_ramp = noRampRequested;
+  return profile;
+}
+
+MoveTiming motion_profile_plan(const MotionProfile &profile, uint32_t steps) {
+  MoveTiming timing = {};
+
+  if (steps == 0 || profile.max_speed <= 0.0f) {
+    timing.shape = profile.no_ramp ? RampShape::NO_RAMP : RampShape::TRIANGLE;
+    return timing;
+  }
+
+  const float distance = static_cast<float>(steps);
+  const float vmax = profile.max_speed;
+
+  if (profile.no_ramp || profile.acceleration <= 0.0f || profile.deceleration <= 0.0f) {
+    timing.shape = RampShape::NO_RAMP;
+    timing.peak_speed = vmax;
+    timing.cruise_us = seconds_to_us(distance / vmax);
+    timing.total_us = timing.cruise_us;
+    return timing;
+  }
+
+  const float a = profile.acceleration;
+  const float d = profile.deceleration;
+  const float accelDistance = (vmax * vmax) / (2.0f * a);
+  const float decelDistance = (vmax * vmax) / (2.0f * d);
+
+  if (accelDistance + decelDistance >= distance) {
+    // Never reaches max speed: peak where the accel and decel parabolas meet.
+    const float peak = sqrtf((2.0f * distance * a * d) / (a + d));
+    timing.shape = RampShape::TRIANGLE;
+    timing.peak_speed = peak;
+    timing.accel_us = seconds_to_us(peak / a);
+    timing.decel_us = seconds_to_us(peak / d);
+  } else {
+    timing.shape = RampShape::TRAPEZOID;
+    timing.peak_speed = vmax;
+    timing.accel_us = seconds_to_us(vmax / a);
+    timing.decel_us = seconds_to_us(vmax / d);
+    timing.cruise_us = seconds_to_us((distance - accelDistance - decelDistance) / vmax);
+  }
+
+  timing.total_us = timing.accel_us + timing.cruise_us + timing.decel_us;
+  return timing;
+}
+
+MotionProfile motion_profile_engine(const MotionProfile &profile) {
+  MotionProfile engine = profile;
+  engine.deceleration = engine.acceleration;
+  return engine;
+}
+
+uint32_t motion_profile_engine_us(const MotionProfile &profile, uint32_t steps) {
+  if (steps == 0 || profile.max_speed <= 0.0f) {
+    return 0;
+  }
+
+  const MotionProfile engine = motion_profile_engine(profile);
+  const MoveTiming timing = motion_profile_plan(engine, steps);
+
+  if (timing.shape == RampShape::NO_RAMP) {
+    // runSpeed() fires the first step at once, then waits one interval per step.
+    return seconds_to_us(static_cast<float>(steps - 1) / engine.max_speed);
+  }
+
+  // AccelStepper's first interval c0 = 0.676 * sqrt(2 / a), in seconds.
+  const float c0 = 0.676f * sqrtf(2.0f / engine.acceleration);
+  const float rampIntervals = (timing.shape == RampShape::TRIANGLE) ? 3.0f : 2.0f;
+  const uint32_t correction = seconds_to_us(rampIntervals * c0);
+
+  return (timing.total_us > correction) ? (timing.total_us - correction) : 0;
+}
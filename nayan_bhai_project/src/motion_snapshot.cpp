@@ -0,0 +1,127 @@
+#include "motion_snapshot.h"
+#include "cycle_checkpoint.h"
+#include "main.h"
+
+#include <atomic>
+#include <esp_timer.h>
+
+namespace {
+// Odd while the writer is mid-update. Readers copy between two equal even values.
+std::atomic<uint32_t> g_seq(0);
+MotionSnapshot g_snapshot = {};
+volatile uint32_t g_lastPublishUs = 0;
+// Serializes the two writers; masking interrupts also keeps a same-core reader
+// from preempting the copy and spinning on an odd sequence forever.
+portMUX_TYPE g_writeMux = portMUX_INITIALIZER_UNLOCKED;
+
+// loop() owns the steppers, so only its task reads them.
+void capture_steppers(MotionSnapshot &snapshot, uint32_t nowUs) {
+  snapshot.stepper_timestamp_us = nowUs;
+  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+    const uint8_t motor = index + 1;
+    snapshot.position[index] = stepper_get_position(motor);
+    snapshot.speed[index] = stepper_get_speed(motor);
+    snapshot.state[index] = stepper_get_motion_state(motor);
+    snapshot.faulted[index] = stepper_is_faulted(motor);
+  }
+}
+
+// DC status and the solenoid are read under their own locks, so any task may capture them.
+void capture_outputs(MotionSnapshot &snapshot, uint32_t nowUs) {
+  snapshot.timestamp_us = nowUs;
+  for (uint8_t index = 0; index < 3; ++index) {
+    snapshot.dc[index] = dc_get_status(static_cast<DcMotorId>(index));
+  }
+  snapshot.solenoid = solenoid_get_state();
+  snapshot.paused = g_paused;
+}
+
+bool is_due(uint32_t nowUs, uint32_t max_age_us) {
+  return g_seq.load(std::memory_order_relaxed) == 0 || nowUs - g_lastPublishUs >= max_age_us;
+}
+
+// The writers capture outside g_writeMux, so the other one may have published a
+// newer capture in between; publishing this one would step the time back.
+// Caller holds g_writeMux.
+bool is_stale(uint32_t nowUs) {
+  return g_seq.load(std::memory_order_relaxed) != 0 && static_cast<int32_t>(nowUs - g_lastPublishUs) < 0;
+}
+
+// Caller holds g_writeMux.
+void publish(const MotionSnapshot &next) {
+  const uint32_t seq = g_seq.load(std::memory_order_relaxed);
+  g_lastPublishUs = next.timestamp_us;
+  g_seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  g_snapshot = next;
+  g_snapshot.sequence = seq / 2 + 1;
+  g_seq.store(seq + 2, std::memory_order_release);
+}
+}  // namespace
+
+void motion_snapshot_service(uint32_t max_age_us) {
+  const uint32_t nowUs = static_cast<uint32_t>(esp_timer_get_time());
+  if (!is_due(nowUs, max_age_us)) {
+    return;
+  }
+
+  // Capture outside the write window so readers retry as rarely as possible.
+  MotionSnapshot next;
+  capture_steppers(next, nowUs);
+  capture_outputs(next, nowUs);
+
+  portENTER_CRITICAL(&g_writeMux);
+  // A stale capture is dropped; loop() publishes again within one period.
+  if (!is_stale(nowUs)) {
+    publish(next);
+  }
+  // Only this writer captures positions, so the mirror keeps them in order either way.
+  cycle_checkpoint_track(next.position);
+  portEXIT_CRITICAL(&g_writeMux);
+}
+
+void motion_snapshot_init() {
+  motion_snapshot_service(0);
+}
+
+void motion_snapshot_service_outputs(uint32_t max_age_us) {
+  const uint32_t nowUs = static_cast<uint32_t>(esp_timer_get_time());
+  if (!is_due(nowUs, max_age_us)) {
+    return;
+  }
+
+  MotionSnapshot next;
+  capture_outputs(next, nowUs);
+
+  portENTER_CRITICAL(&g_writeMux);
+  if (is_stale(nowUs)) {
+    portEXIT_CRITICAL(&g_writeMux);
+    return;
+  }
+  // Carries the stepper fields of the last full capture; they are unchanged
+  // unless loop() has run stepper_service(), which publishes them itself.
+  next.stepper_timestamp_us = g_snapshot.stepper_timestamp_us;
+  memcpy(next.position, g_snapshot.position, sizeof(next.position));
+  memcpy(next.speed, g_snapshot.speed, sizeof(next.speed));
+  memcpy(next.state, g_snapshot.state, sizeof(next.state));
+  memcpy(next.faulted, g_snapshot.faulted, sizeof(next.faulted));
+  publish(next);
+  portEXIT_CRITICAL(&g_writeMux);
+}
+
+bool motion_snapshot_read(MotionSnapshot &out) {
+  for (;;) {
+    const uint32_t before = g_seq.load(std::memory_order_acquire);
+    if (before == 0) {
+      return false;
+    }
+    if (before & 1) {
+      continue;
+    }
+    out = g_snapshot;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (g_seq.load(std::memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+}
@@ -0,0 +1,105 @@
+#include "motion_trigger.h"
+#include "main.h"
+
+#include "stepper_motor.h"
+
+namespace {
+struct TriggerSlot {
+  volatile bool inUse;
+  TriggerAction action;
+};
+
+TriggerSlot slots[STEPPER_MAX_TRIGGERS] = {};
+portMUX_TYPE g_slotMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Runs inside stepper_service().
+void run_action(void *arg) {
+  TriggerSlot &slot = *static_cast<TriggerSlot *>(arg);
+  const TriggerAction action = slot.action;
+  slot.inUse = false;
+
+  switch (action.kind) {
+    case TriggerActionKind::DC_RUN:
+      dc_run_ms(action.dc_move);
+      break;
+    case TriggerActionKind::SOLENOID:
+      solenoid_state(action.solenoid);
+      break;
+    case TriggerActionKind::NOTIFY_TASK:
+      if (action.task != nullptr) {
+        xTaskNotify(action.task, action.notify_bits, eSetBits);
+      }
+      break;
+  }
+}
+
+// Runs from stepper_disarm_triggers() for a trigger dropped unfired.
+void release_slot(void *arg) {
+  static_cast<TriggerSlot *>(arg)->inUse = false;
+}
+
+TriggerSlot *claim_slot(const TriggerAction &action) {
+  TriggerSlot *claimed = nullptr;
+  portENTER_CRITICAL(&g_slotMux);
+  for (uint8_t i = 0; i < STEPPER_MAX_TRIGGERS; ++i) {
+    if (!slots[i].inUse) {
+      claimed = &slots[i];
+      claimed->inUse = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&g_slotMux);
+
+  if (claimed != nullptr) {
+    claimed->action = action;
+  }
+  return claimed;
+}
+
+bool arm(uint8_t motor_number, StepperTriggerCondition condition, int32_t position, const TriggerAction &action) {
+  TriggerSlot *slot = claim_slot(action);
+  if (slot == nullptr) {
+    return false;
+  }
+  if (!stepper_arm_trigger(motor_number, condition, position, run_action, slot, release_slot)) {
+    slot->inUse = false;
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+TriggerAction trigger_dc_run(const DcTimedMove &move) {
+  TriggerAction action = {};
+  action.kind = TriggerActionKind::DC_RUN;
+  action.dc_move = move;
+  return action;
+}
+
+TriggerAction trigger_solenoid(SolenoidState state) {
+  TriggerAction action = {};
+  action.kind = TriggerActionKind::SOLENOID;
+  action.solenoid = state;
+  return action;
+}
+
+TriggerAction trigger_notify(TaskHandle_t task, uint32_t bits) {
+  TriggerAction action = {};
+  action.kind = TriggerActionKind::NOTIFY_TASK;
+  action.task = task;
+  action.notify_bits = bits;
+  return action;
+}
+
+bool motion_trigger_at_position(uint8_t motor_number, int32_t position, const TriggerAction &action) {
+  return arm(motor_number, StepperTriggerCondition::CROSS_POSITION, position, action);
+}
+
+bool motion_trigger_at_decel(uint8_t motor_number, const TriggerAction &action) {
+  return arm(motor_number, StepperTriggerCondition::DECEL_START, 0, action);
+}
+
+void motion_trigger_clear(uint8_t motor_number) {
+  // Frees the slots through release_slot(), as any other disarm does.
+  stepper_disarm_triggers(motor_number);
+}
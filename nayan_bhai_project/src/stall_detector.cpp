@@ -0,0 +1,44 @@
+#include "stall_detector.h"
+
+#include <math.h>
+
+void stall_detector_init(StallDetector &detector, const StallDetectorConfig &config) {
+  detector.config = config;
+  if (detector.config.counts_per_step <= 0.0f) {
+    detector.config.counts_per_step = 1.0f;
+  }
+  if (detector.config.confirm_samples == 0) {
+    detector.config.confirm_samples = 1;
+  }
+  stall_detector_sync(detector, 0, 0);
+}
+
+void stall_detector_sync(StallDetector &detector, int32_t commanded_position, int32_t encoder_count) {
+  detector.commanded_origin = commanded_position;
+  detector.encoder_origin = encoder_count;
+  detector.following_error = 0;
+  detector.over_limit_samples = 0;
+}
+
+int32_t stall_detector_actual_position(const StallDetector &detector, int32_t encoder_count) {
+  const float travelledSteps = static_cast<float>(encoder_count - detector.encoder_origin) /
+                               detector.config.counts_per_step;
+  return detector.commanded_origin + static_cast<int32_t>(lroundf(travelledSteps));
+}
+
+StallCheck stall_detector_update(StallDetector &detector, int32_t commanded_position, int32_t encoder_count) {
+  detector.following_error = commanded_position - stall_detector_actual_position(detector, encoder_count);
+
+  const int32_t magnitude = (detector.following_error < 0) ? -detector.following_error : detector.following_error;
+  if (magnitude <= detector.config.following_error_limit) {
+    detector.over_limit_samples = 0;
+    return StallCheck::OK;
+  }
+
+  if (++detector.over_limit_samples < detector.config.confirm_samples) {
+    return StallCheck::OVER_LIMIT;
+  }
+
+  detector.over_limit_samples = 0;
+  return StallCheck::STALLED;
+}
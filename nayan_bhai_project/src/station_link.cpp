@@ -0,0 +1,339 @@
+#include "station_link.h"
+
+#include <driver/uart.h>
+#include <esp_timer.h>
+
+#include "defines.h"
+#include "link_protocol.h"
+#include "main.h"
+
+namespace {
+static_assert(MOTION_BATCH_MAX_ITEMS <= LINK_MAX_BATCH_ITEMS, "a batch must fit one link frame");
+static_assert(static_cast<uint8_t>(MotionBatchKind::STEPPER) == LINK_ITEM_STEPPER &&
+                  static_cast<uint8_t>(MotionBatchKind::DC) == LINK_ITEM_DC &&
+                  static_cast<uint8_t>(MotionBatchKind::SOLENOID) == LINK_ITEM_SOLENOID,
+              "item kinds go on the wire as MotionBatchKind values");
+static_assert(static_cast<uint8_t>(DcMotorId::M2_300) + 1 == LINK_DC_MOTORS &&
+                  static_cast<uint8_t>(Direction::CCW) + 1 == LINK_DIRECTIONS &&
+                  static_cast<uint8_t>(DcStopMode::BRAKE_THEN_COAST) + 1 == LINK_DC_STOP_MODES &&
+                  static_cast<uint8_t>(SolenoidState::ON) + 1 == LINK_SOLENOID_STATES,
+              "the link's field ranges must cover the enums");
+
+const uart_port_t LINK_PORT = static_cast<uart_port_t>(LINK_UART_NUM);
+
+LinkNode g_node;
+SemaphoreHandle_t g_mutex = nullptr;
+QueueHandle_t g_uartEvents = nullptr;
+TaskHandle_t g_task = nullptr;
+
+uint64_t now_us() {
+  return static_cast<uint64_t>(esp_timer_get_time());
+}
+
+// The node is shared by the link task and the caller of the API functions; it
+// writes to the UART from inside, so a mutex rather than a spinlock guards it.
+void lock() {
+  xSemaphoreTake(g_mutex, portMAX_DELAY);
+}
+
+void unlock() {
+  xSemaphoreGive(g_mutex);
+}
+
+void write_uart(const uint8_t *data, size_t length, void *context) {
+  (void)context;
+  // No TX ring buffer: returns once the bytes are in the FIFO, so a time
+  // stamped just before goes out with the first byte.
+  uart_write_bytes(LINK_PORT, data, length);
+}
+
+LinkBatchItem to_link_item(const MotionBatchItem &item) {
+  LinkBatchItem wire = {};
+  wire.kind = static_cast<uint8_t>(item.kind);
+  wire.start_offset_ms = item.start_offset_ms;
+  switch (item.kind) {
+    case MotionBatchKind::STEPPER:
+      wire.motor = item.stepper.motor_number;
+      wire.amount = item.stepper.steps;
+      wire.direction = static_cast<uint8_t>(item.stepper.direction);
+      break;
+    case MotionBatchKind::DC:
+      wire.motor = static_cast<uint8_t>(item.dc.motor);
+      wire.amount = static_cast<int32_t>(item.dc.time_ms);
+      wire.direction = static_cast<uint8_t>(item.dc.direction);
+      wire.speed = item.dc.speed;
+      wire.option = static_cast<uint8_t>(item.dc.stop_mode);
+      break;
+    case MotionBatchKind::SOLENOID:
+      wire.option = static_cast<uint8_t>(item.solenoid);
+      break;
+  }
+  return wire;
+}
+
+// handle_batch() only queues items of known kinds with fields in range; false
+// here means the two checks disagree.
+bool from_link_item(const LinkBatchItem &wire, MotionBatchItem &item) {
+  const Direction direction = static_cast<Direction>(wire.direction);
+  switch (wire.kind) {
+    case LINK_ITEM_STEPPER: {
+      const StepperMove move = {wire.motor, wire.amount, direction};
+      item = batch_stepper(move, wire.start_offset_ms);
+      return true;
+    }
+    case LINK_ITEM_DC: {
+      const DcTimedMove move = {
+          static_cast<DcMotorId>(wire.motor), static_cast<uint32_t>(wire.amount), wire.speed, direction,
+          static_cast<DcStopMode>(wire.option),
+      };
+      item = batch_dc(move, wire.start_offset_ms);
+      return true;
+    }
+    case LINK_ITEM_SOLENOID:
+      item = batch_solenoid(static_cast<SolenoidState>(wire.option), wire.start_offset_ms);
+      return true;
+    default:
+      return false;
+  }
+}
+
+void link_task(void *parameter) {
+  (void)parameter;
+
+  uint8_t buffer[LINK_MAX_PAYLOAD];
+  for (;;) {
+    uart_event_t event;
+    const bool received = xQueueReceive(g_uartEvents, &event, pdMS_TO_TICKS(1)) == pdTRUE;
+    // Stamped on wake-up; the driver posts data a fixed idle time after the
+    // last byte, which both stations see alike and so cancels in the offset.
+    const uint64_t now = now_us();
+
+    lock();
+    if (received && event.type == UART_DATA) {
+      const size_t wanted = (event.size < sizeof(buffer)) ? event.size : sizeof(buffer);
+      const int count = uart_read_bytes(LINK_PORT, buffer, wanted, 0);
+      if (count > 0) {
+        link_receive(g_node, buffer, static_cast<size_t>(count), now);
+      }
+    } else if (received && (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL)) {
+      uart_flush_input(LINK_PORT);
+      xQueueReset(g_uartEvents);
+    }
+    link_service(g_node, now);
+    unlock();
+  }
+}
+
+// Runs the batches the neighbour scheduled here, each at its start time, and
+// reports them complete.
+void run_scheduled_batches() {
+  for (;;) {
+    LinkBatch batch;
+    lock();
+    const LinkBatch *next = link_peek_batch(g_node);
+    if (next != nullptr) {
+      batch = *next;
+    }
+    unlock();
+    if (next == nullptr) {
+      return;
+    }
+
+    MotionBatchItem items[LINK_MAX_BATCH_ITEMS];
+    bool known = true;
+    for (uint8_t i = 0; i < batch.count && known; ++i) {
+      known = from_link_item(batch.items[i], items[i]);
+    }
+    if (known) {
+      station_link_wait_until(batch.start_us);
+      motion_batch_run_blocking(items, batch.count);
+    } else {
+      Serial.printf("[LINK] batch %u has an item of unknown kind - not run\n", batch.id);
+    }
+
+    lock();
+    link_complete_batch(g_node);
+    unlock();
+  }
+}
+
+// Polls done() every millisecond; time spent paused does not count against the
+// timeout. The caller is at rest while it waits, so it takes the neighbour's
+// batches meanwhile: two stations waiting on each other would deadlock otherwise.
+template <typename Done>
+bool wait_unpaused(Done done, uint32_t timeout_ms) {
+  uint32_t waited = 0;
+  uint32_t last = millis();
+  while (!done()) {
+    const uint32_t now = millis();
+    if (!g_paused) {
+      waited += now - last;
+    }
+    last = now;
+    if (waited >= timeout_ms) {
+      return false;
+    }
+    run_scheduled_batches();
+    delay(1);
+  }
+  return true;
+}
+}  // namespace
+
+bool station_link_start(bool clock_master) {
+  if (g_task != nullptr) {
+    return true;
+  }
+
+  uart_config_t config = {};
+  config.baud_rate = static_cast<int>(LINK_BAUD);
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_APB;
+  if (uart_driver_install(LINK_PORT, 1024, 0, 16, &g_uartEvents, 0) != ESP_OK) {
+    return false;
+  }
+  uart_param_config(LINK_PORT, &config);
+  uart_set_pin(LINK_PORT, PIN_LINK_TX, PIN_LINK_RX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+  // Post received bytes after two idle symbols instead of ten.
+  uart_set_rx_timeout(LINK_PORT, 2);
+
+  const LinkConfig linkConfig = {
+      clock_master, LINK_BAUD, LINK_SYNC_PERIOD_MS * 1000UL, LINK_RESEND_MS * 1000UL, STEPPER_MOTOR_COUNT,
+      write_uart, nullptr,
+  };
+  link_init(g_node, linkConfig);
+  g_mutex = xSemaphoreCreateMutex();
+
+  xTaskCreatePinnedToCore(link_task, "station_link", 4096, nullptr, LINK_TASK_PRIORITY, &g_task, 0);
+  return true;
+}
+
+bool station_link_synced() {
+  if (g_task == nullptr) {
+    return false;
+  }
+  lock();
+  const bool synced = link_is_synced(g_node);
+  unlock();
+  return synced;
+}
+
+uint64_t station_link_time_us() {
+  if (g_task == nullptr) {
+    return now_us();
+  }
+  lock();
+  const uint64_t shared = link_shared_time(g_node, now_us());
+  unlock();
+  return shared;
+}
+
+uint32_t station_link_sync_error_us() {
+  if (g_task == nullptr) {
+    return 0;
+  }
+  lock();
+  const uint32_t bound = g_node.error_bound_us;
+  unlock();
+  return bound;
+}
+
+void station_link_wait_until(uint64_t shared_us) {
+  if (g_task == nullptr) {
+    return;
+  }
+  lock();
+  const uint64_t localStart = link_local_time(g_node, shared_us);
+  unlock();
+
+  for (;;) {
+    const uint64_t now = now_us();
+    if (now >= localStart) {
+      return;
+    }
+    const uint64_t left = localStart - now;
+    if (left > LINK_START_SPIN_US) {
+      delay(static_cast<uint32_t>((left - LINK_START_SPIN_US) / 1000) + 1);
+    }
+  }
+}
+
+uint16_t station_link_schedule_batch(const MotionBatchItem *items, uint8_t item_count, uint64_t start_us) {
+  if (g_task == nullptr || items == nullptr || item_count == 0 || item_count > MOTION_BATCH_MAX_ITEMS) {
+    return 0;
+  }
+
+  LinkBatchItem wire[LINK_MAX_BATCH_ITEMS];
+  for (uint8_t i = 0; i < item_count; ++i) {
+    wire[i] = to_link_item(items[i]);
+  }
+
+  // The previous batch may still be waiting for its acknowledgement.
+  uint16_t id = 0;
+  wait_unpaused([&]() {
+    lock();
+    id = link_send_batch(g_node, start_us, wire, item_count, now_us());
+    unlock();
+    return id != 0;
+  }, LINK_RESEND_MS * (LINK_MAX_RETRIES + 1));
+  return id;
+}
+
+bool station_link_wait_batch(uint16_t id, uint32_t timeout_ms) {
+  if (g_task == nullptr) {
+    return false;
+  }
+  bool failed = false;
+  const bool done = wait_unpaused([&]() {
+    lock();
+    const bool complete = link_batch_done(g_node, id);
+    failed = link_batch_failed(g_node, id);
+    unlock();
+    return complete || failed;
+  }, timeout_ms);
+  return done && !failed;
+}
+
+bool station_link_barrier(uint16_t id, uint32_t timeout_ms) {
+  if (g_task == nullptr || id == 0) {
+    return false;
+  }
+  lock();
+  link_barrier_arrive(g_node, id, now_us());
+  unlock();
+
+  return wait_unpaused([&]() {
+    lock();
+    const bool passed = link_barrier_passed(g_node, id);
+    unlock();
+    return passed;
+  }, timeout_ms);
+}
+
+void station_link_service() {
+  if (g_task == nullptr) {
+    return;
+  }
+  run_scheduled_batches();
+}
+
+void station_link_report(Print &out) {
+  if (g_task == nullptr) {
+    out.println("link off");
+    return;
+  }
+  lock();
+  const LinkNode node = g_node;
+  unlock();
+
+  out.printf("link %s, %s, offset %lld us, skew %.2f ppm, error bound %lu us\n",
+             node.config.clock_master ? "master" : "follower", link_is_synced(node) ? "synced" : "not synced",
+             static_cast<long long>(node.offset_us), node.skew * 1e6f,
+             static_cast<unsigned long>(node.error_bound_us));
+  out.printf("link frames %lu, crc errors %lu, sync updates %lu, resends %lu\n",
+             static_cast<unsigned long>(node.stats.frames), static_cast<unsigned long>(node.stats.crc_errors),
+             static_cast<unsigned long>(node.stats.sync_updates), static_cast<unsigned long>(node.stats.resends));
+}
@@ -0,0 +1,132 @@
+#include "status_led.h"
+
+#include <driver/rmt.h>
+#include <math.h>
+
+#include "defines.h"
+#include "trace.h"
+
+namespace {
+// 80 MHz APB / 2 = 25 ns per RMT tick; WS2812 bit timings in ticks.
+constexpr uint8_t RMT_CLK_DIV = 2;
+constexpr uint16_t T0H_TICKS = 16;  // 0.40 us
+constexpr uint16_t T0L_TICKS = 34;  // 0.85 us
+constexpr uint16_t T1H_TICKS = 32;  // 0.80 us
+constexpr uint16_t T1L_TICKS = 18;  // 0.45 us
+constexpr uint8_t BITS_PER_LED = 24;
+
+const rmt_channel_t kChannel = static_cast<rmt_channel_t>(STATUS_LED_RMT_CHANNEL);
+
+struct LedRequest {
+  LedPattern pattern;
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t code;
+};
+
+QueueHandle_t g_requests = nullptr;
+rmt_item32_t g_items[BITS_PER_LED];
+uint32_t g_sentColor = 0xFFFFFFFF;  // nothing sent yet
+
+void encode_byte(rmt_item32_t *items, uint8_t value) {
+  for (uint8_t bit = 0; bit < 8; ++bit) {
+    const bool one = (value & (0x80 >> bit)) != 0;
+    items[bit].level0 = 1;
+    items[bit].duration0 = one ? T1H_TICKS : T0H_TICKS;
+    items[bit].level1 = 0;
+    items[bit].duration1 = one ? T1L_TICKS : T0L_TICKS;
+  }
+}
+
+void send_color(uint8_t r, uint8_t g, uint8_t b) {
+  const uint32_t color = (static_cast<uint32_t>(g) << 16) | (static_cast<uint32_t>(r) << 8) | b;
+  if (color == g_sentColor) {
+    return;
+  }
+  g_sentColor = color;
+
+  // WS2812 takes GRB, most significant bit first.
+  encode_byte(&g_items[0], g);
+  encode_byte(&g_items[8], r);
+  encode_byte(&g_items[16], b);
+
+  trace_begin(TraceEvent::LED_SHOW);
+  rmt_write_items(kChannel, g_items, BITS_PER_LED, true);
+  trace_end(TraceEvent::LED_SHOW);
+}
+
+// Pattern intensity 0..255 at elapsedMs into the pattern.
+uint8_t pattern_level(const LedRequest &request, uint32_t elapsedMs) {
+  switch (request.pattern) {
+    case LedPattern::SOLID:
+      return 255;
+    case LedPattern::BLINK:
+      return ((elapsedMs % STATUS_LED_BLINK_PERIOD_MS) < STATUS_LED_BLINK_PERIOD_MS / 2) ? 255 : 0;
+    case LedPattern::BREATHE: {
+      const float phase = static_cast<float>(elapsedMs % STATUS_LED_BREATHE_PERIOD_MS) /
+                          static_cast<float>(STATUS_LED_BREATHE_PERIOD_MS);
+      return static_cast<uint8_t>(127.5f * (1.0f - cosf(2.0f * static_cast<float>(M_PI) * phase)));
+    }
+    case LedPattern::ERROR_CODE: {
+      const uint32_t blinksMs = static_cast<uint32_t>(request.code) * 2 * STATUS_LED_CODE_BLINK_MS;
+      const uint32_t phase = elapsedMs % (blinksMs + STATUS_LED_CODE_PAUSE_MS);
+      return (phase < blinksMs && (phase / STATUS_LED_CODE_BLINK_MS) % 2 == 0) ? 255 : 0;
+    }
+    default:
+      return 0;
+  }
+}
+
+uint8_t scale(uint8_t channel, uint8_t level) {
+  const uint32_t scaled = static_cast<uint32_t>(channel) * level * RGB_LED_BRIGHTNESS;
+  return static_cast<uint8_t>(scaled / (255U * 255U));
+}
+
+void status_led_task(void *parameter) {
+  (void)parameter;
+
+  LedRequest current = {LedPattern::OFF, 0, 0, 0, 0};
+  uint32_t startMs = millis();
+
+  for (;;) {
+    LedRequest request;
+    if (xQueueReceive(g_requests, &request, pdMS_TO_TICKS(STATUS_LED_FRAME_MS)) == pdTRUE) {
+      current = request;
+      startMs = millis();
+    }
+
+    const uint8_t level = pattern_level(current, millis() - startMs);
+    send_color(scale(current.r, level), scale(current.g, level), scale(current.b, level));
+  }
+}
+}  // namespace
+
+void status_led_init() {
+  if (g_requests != nullptr) {
+    return;
+  }
+
+  rmt_config_t config = {};
+  config.rmt_mode = RMT_MODE_TX;
+  config.channel = kChannel;
+  config.gpio_num = PIN_RGB_LED;
+  config.clk_div = RMT_CLK_DIV;
+  config.mem_block_num = 1;
+  config.tx_config.idle_output_en = true;
+  config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+  rmt_config(&config);
+  rmt_driver_install(kChannel, 0, 0);
+
+  g_requests = xQueueCreate(1, sizeof(LedRequest));
+  xTaskCreatePinnedToCore(status_led_task, "status_led", 2048, nullptr, 1, nullptr, 0);
+}
+
+void status_led_set(LedPattern pattern, uint8_t r, uint8_t g, uint8_t b, uint8_t code) {
+  if (g_requests == nullptr) {
+    return;
+  }
+
+  const LedRequest request = {pattern, r, g, b, code};
+  xQueueOverwrite(g_requests, &request);
+}
@@ -0,0 +1,314 @@
+#include "step_stream.h"
+#include "step_stream_fill.h"
+
+#include <esp_heap_caps.h>
+#include <esp_lcd_panel_io.h>
+
+namespace {
+constexpr uint8_t BUS_WIDTH = (STEPPER_STREAM_AXES <= 4) ? 8 : 16;
+constexpr size_t BUFFER_BYTES = STEP_STREAM_BUFFER_SAMPLES * (BUS_WIDTH / 8);
+constexpr uint8_t AXIS_SLOTS = (STEPPER_STREAM_AXES > 0) ? STEPPER_STREAM_AXES : 1;  // one idle slot when there are none
+constexpr StreamTiming TIMING = {
+    STEP_STREAM_SAMPLE_HZ, STEP_STREAM_BUFFER_SAMPLES, STEP_STREAM_PULSE_SAMPLES, STEP_STREAM_DIR_SETUP_SAMPLES,
+    BUS_WIDTH,
+};
+// The i80 clock divides 80 MHz by at most 64, so the bus cannot run slower.
+static_assert(STEP_STREAM_SAMPLE_HZ >= 1250000, "LCD_CAM i80 pclk below its minimum");
+static_assert(static_cast<uint8_t>(StreamState::CONTINUOUS) == static_cast<uint8_t>(StepperMotionState::CONTINUOUS) &&
+                  static_cast<uint8_t>(StreamState::TIMED_RUN) == static_cast<uint8_t>(StepperMotionState::TIMED_RUN) &&
+                  static_cast<uint8_t>(StreamState::POSITIONING) ==
+                      static_cast<uint8_t>(StepperMotionState::POSITIONING),
+              "StreamState out of sync with StepperMotionState");
+
+esp_lcd_panel_io_handle_t g_io = nullptr;
+TaskHandle_t g_task = nullptr;
+void *g_buffers[STEP_STREAM_BUFFERS] = {};
+bool g_running = false;
+uint32_t g_bufferStart = 0;  // sample time of the buffer being filled
+volatile uint32_t g_underruns = 0;
+
+StreamAxis g_axes[AXIS_SLOTS] = {};  // owned by the fill task
+StreamCommand g_commands[AXIS_SLOTS] = {};
+StreamStatus g_status[AXIS_SLOTS] = {};  // published by the fill task after every buffer
+portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+StepperMotionState motion_state(StreamState state) {
+  return static_cast<StepperMotionState>(state);
+}
+
+bool valid_axis(uint8_t axis) {
+  return g_running && axis < AXIS_SLOTS;
+}
+
+void post_command(uint8_t axis, const StreamCommand &command) {
+  portENTER_CRITICAL(&g_mux);
+  g_commands[axis] = command;
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void apply_commands(uint32_t now) {
+  portENTER_CRITICAL(&g_mux);
+  for (uint8_t index = 0; index < AXIS_SLOTS; ++index) {
+    step_stream_fill_command(g_axes[index], g_commands[index], TIMING, now);
+  }
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void publish() {
+  portENTER_CRITICAL(&g_mux);
+  for (uint8_t index = 0; index < AXIS_SLOTS; ++index) {
+    g_status[index] = step_stream_fill_status(g_axes[index], TIMING);
+  }
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void fill_buffer(void *buffer) {
+  const uint32_t start = g_bufferStart;
+  apply_commands(start);
+
+  step_stream_fill_clear(g_axes, AXIS_SLOTS, TIMING, buffer);
+  for (uint8_t index = 0; index < AXIS_SLOTS; ++index) {
+    step_stream_fill_axis(g_axes[index], index, TIMING, start, buffer);
+  }
+
+  g_bufferStart = start + STEP_STREAM_BUFFER_SAMPLES;
+  publish();
+}
+
+void queue_buffer(uint8_t index) {
+  fill_buffer(g_buffers[index]);
+  // No command phase (lcd_cmd_bits = 0), so the bus carries the buffer only.
+  esp_lcd_panel_io_tx_color(g_io, -1, g_buffers[index], BUFFER_BYTES);
+}
+
+bool IRAM_ATTR on_buffer_done(esp_lcd_panel_io_handle_t io, void *user_ctx, void *event_data) {
+  (void)io;
+  (void)user_ctx;
+  (void)event_data;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(g_task, &woken);
+  return woken == pdTRUE;
+}
+
+void stream_task(void *parameter) {
+  (void)parameter;
+
+  for (uint8_t index = 0; index < STEP_STREAM_BUFFERS; ++index) {
+    queue_buffer(index);
+  }
+
+  uint8_t next = 0;
+  for (;;) {
+    // One notification per finished buffer; all of them means the queue ran dry.
+    const uint32_t done = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (done >= STEP_STREAM_BUFFERS) {
+      ++g_underruns;
+    }
+    for (uint32_t count = 0; count < done && count < STEP_STREAM_BUFFERS; ++count) {
+      queue_buffer(next);
+      next = (next + 1) % STEP_STREAM_BUFFERS;
+    }
+  }
+}
+}  // namespace
+
+bool step_stream_init() {
+  if (STEPPER_STREAM_AXES == 0 || g_running) {
+    return true;
+  }
+
+  esp_lcd_i80_bus_config_t busConfig = {};
+  busConfig.dc_gpio_num = PIN_STEP_STREAM_DC;
+  busConfig.wr_gpio_num = PIN_STEP_STREAM_WR;
+  busConfig.bus_width = BUS_WIDTH;
+  busConfig.max_transfer_bytes = BUFFER_BYTES;
+  bool pinsAssigned = PIN_STEP_STREAM_DC != GPIO_NUM_NC && PIN_STEP_STREAM_WR != GPIO_NUM_NC;
+  for (uint8_t bit = 0; bit < BUS_WIDTH; ++bit) {
+    busConfig.data_gpio_nums[bit] = PIN_STEP_STREAM_DATA[bit];
+    pinsAssigned = pinsAssigned && PIN_STEP_STREAM_DATA[bit] != GPIO_NUM_NC;
+  }
+  if (!pinsAssigned) {
+    return false;
+  }
+
+  for (uint8_t index = 0; index < STEP_STREAM_BUFFERS; ++index) {
+    g_buffers[index] = heap_caps_calloc(1, BUFFER_BYTES, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (g_buffers[index] == nullptr) {
+      return false;
+    }
+  }
+
+  esp_lcd_i80_bus_handle_t bus = nullptr;
+  if (esp_lcd_new_i80_bus(&busConfig, &bus) != ESP_OK) {
+    return false;
+  }
+
+  esp_lcd_panel_io_i80_config_t ioConfig = {};
+  ioConfig.cs_gpio_num = -1;
+  ioConfig.pclk_hz = STEP_STREAM_SAMPLE_HZ;
+  ioConfig.trans_queue_depth = STEP_STREAM_BUFFERS;
+  ioConfig.on_color_trans_done = on_buffer_done;
+  // IDF 4.4 sends a command word before every color transfer unless the
+  // command is zero bits wide; a word of ones would step every axis.
+  ioConfig.lcd_cmd_bits = 0;
+  ioConfig.lcd_param_bits = BUS_WIDTH;
+  ioConfig.dc_levels.dc_data_level = 1;
+  if (esp_lcd_new_panel_io_i80(bus, &ioConfig, &g_io) != ESP_OK) {
+    esp_lcd_del_i80_bus(bus);
+    return false;
+  }
+
+  g_running = true;
+  xTaskCreatePinnedToCore(stream_task, "step_stream", 3072, nullptr, STEP_STREAM_TASK_PRIORITY, &g_task, 0);
+  return true;
+}
+
+void step_stream_move(uint8_t axis, int32_t steps, float max_speed, float acceleration) {
+  if (!valid_axis(axis) || steps == 0 || max_speed <= 0.0f) {
+    return;
+  }
+  const StreamCommand command = {
+      true, StreamState::POSITIONING, false, false, false, steps, 0,
+      static_cast<int8_t>((steps > 0) ? 1 : -1), max_speed, acceleration, 0,
+  };
+  post_command(axis, command);
+}
+
+void step_stream_move_to(uint8_t axis, int32_t position, float max_speed, float acceleration) {
+  if (!valid_axis(axis) || max_speed <= 0.0f) {
+    return;
+  }
+  const StreamCommand command = {
+      true, StreamState::POSITIONING, false, true, false, 0, position, 1, max_speed, acceleration, 0,
+  };
+  post_command(axis, command);
+}
+
+void step_stream_set_profile(uint8_t axis, float max_speed, float acceleration) {
+  if (!valid_axis(axis) || max_speed <= 0.0f) {
+    return;
+  }
+  portENTER_CRITICAL(&g_mux);
+  StreamCommand &command = g_commands[axis];
+  if (!command.pending) {
+    command = StreamCommand();
+    command.pending = true;
+    command.retune = true;
+    command.state = g_status[axis].state;
+  }
+  // A motion command not picked up yet simply starts with the new profile.
+  command.max_speed = max_speed;
+  command.acceleration = acceleration;
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void step_stream_run(uint8_t axis, Direction direction, float max_speed, float acceleration, uint32_t time_ms) {
+  if (!valid_axis(axis) || max_speed <= 0.0f) {
+    return;
+  }
+  const StreamCommand command = {
+      true, (time_ms > 0) ? StreamState::TIMED_RUN : StreamState::CONTINUOUS, false, false, false,
+      0, 0, static_cast<int8_t>((direction == Direction::CW) ? 1 : -1), max_speed, acceleration, time_ms,
+  };
+  post_command(axis, command);
+}
+
+void step_stream_stop(uint8_t axis, bool ramp) {
+  if (!valid_axis(axis)) {
+    return;
+  }
+  portENTER_CRITICAL(&g_mux);
+  StreamCommand &command = g_commands[axis];
+  // A move that never started still counts as left to go.
+  const bool positioning = command.state == StreamState::POSITIONING ||
+                           (command.state == StreamState::IDLE && !command.absolute);
+  int32_t cancelled = 0;
+  if (command.pending && positioning) {
+    cancelled = command.absolute ? static_cast<int32_t>(command.target - g_status[axis].position) : command.steps;
+  }
+  command.pending = true;
+  command.retune = false;
+  command.absolute = false;
+  command.state = StreamState::IDLE;
+  command.ramp = ramp;
+  command.steps = cancelled;
+  portEXIT_CRITICAL(&g_mux);
+}
+
+bool step_stream_set_position(uint8_t axis, int32_t position) {
+  if (!valid_axis(axis)) {
+    return false;
+  }
+  portENTER_CRITICAL(&g_mux);
+  StreamCommand &command = g_commands[axis];
+  const bool idle = !command.pending && g_status[axis].state == StreamState::IDLE;
+  if (idle) {
+    command = StreamCommand();
+    command.pending = true;
+    command.state = StreamState::IDLE;
+    command.absolute = true;
+    command.target = position;
+  }
+  portEXIT_CRITICAL(&g_mux);
+  return idle;
+}
+
+int64_t step_stream_position(uint8_t axis) {
+  if (!valid_axis(axis)) {
+    return 0;
+  }
+  portENTER_CRITICAL(&g_mux);
+  const int64_t position = g_status[axis].position;
+  portEXIT_CRITICAL(&g_mux);
+  return position;
+}
+
+int32_t step_stream_remaining(uint8_t axis) {
+  if (!valid_axis(axis)) {
+    return 0;
+  }
+  portENTER_CRITICAL(&g_mux);
+  const StreamCommand &command = g_commands[axis];
+  const bool pendingMove = command.pending && command.state == StreamState::POSITIONING && !command.retune;
+  // A run not picked up yet replaces whatever move the axis is still finishing.
+  const bool pendingRun = command.pending && !command.retune &&
+                          (command.state == StreamState::CONTINUOUS || command.state == StreamState::TIMED_RUN);
+  int32_t remaining = g_status[axis].remaining;
+  if (pendingRun) {
+    remaining = 0;
+  } else if (pendingMove && command.absolute) {
+    remaining = static_cast<int32_t>(command.target - g_status[axis].position);
+  } else if (pendingMove || (command.pending && command.state == StreamState::IDLE && command.steps != 0)) {
+    remaining = command.steps;
+  }
+  portEXIT_CRITICAL(&g_mux);
+  return remaining;
+}
+
+float step_stream_speed(uint8_t axis) {
+  if (!valid_axis(axis)) {
+    return 0.0f;
+  }
+  portENTER_CRITICAL(&g_mux);
+  const float speed = g_status[axis].speed;
+  portEXIT_CRITICAL(&g_mux);
+  return speed;
+}
+
+StepperMotionState step_stream_state(uint8_t axis) {
+  if (!valid_axis(axis)) {
+    return StepperMotionState::IDLE;
+  }
+  portENTER_CRITICAL(&g_mux);
+  const StreamCommand &command = g_commands[axis];
+  const StreamState state =
+    (command.pending && command.state != StreamState::IDLE) ? command.state : g_status[axis].state;
+  portEXIT_CRITICAL(&g_mux);
+  return motion_state(state);
+}
+
+uint32_t step_stream_take_underruns() {
+  const uint32_t underruns = g_underruns;
+  g_underruns = 0;
+  return underruns;
+}
@@ -0,0 +1,264 @@
+#include "step_stream_fill.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+// Each word of a buffer is a byte or a uint16_t depending on the bus width.
+void set_words(void *buffer, const StreamTiming &timing, uint32_t first, uint32_t count, uint16_t bits) {
+  for (uint32_t sample = first; sample < first + count; ++sample) {
+    if (timing.bus_width == 8) {
+      static_cast<uint8_t *>(buffer)[sample] |= static_cast<uint8_t>(bits);
+    } else {
+      static_cast<uint16_t *>(buffer)[sample] |= bits;
+    }
+  }
+}
+
+void finish(StreamAxis &axis) {
+  if (axis.state != StreamState::POSITIONING) {
+    axis.target = axis.position;  // runs leave no steps to go
+  }
+  axis.state = StreamState::IDLE;
+  axis.stopping = false;
+  axis.ramp_steps = 0;
+}
+
+void stop_axis(StreamAxis &axis, bool ramp) {
+  if (axis.state == StreamState::IDLE) {
+    return;
+  }
+  if (ramp && axis.ramp && axis.ramp_steps > 1) {
+    axis.stopping = true;
+  } else {
+    finish(axis);
+  }
+}
+
+// Sets the speed limit and ramp of an axis. A moving ramped axis keeps its
+// speed: its steps to stop are recomputed for the new rate (v^2 / 2a, as
+// AccelStepper does), and advance() ramps it down to a lowered limit.
+void set_axis_profile(StreamAxis &axis, const StreamTiming &timing, float maxSpeed, float acceleration) {
+  const float sampleHz = static_cast<float>(timing.sample_hz);
+  // A STEP word run needs a low run at least as long after it.
+  const float minInterval = 2.0f * static_cast<float>(timing.pulse_samples);
+  axis.ramp = acceleration > 0.0f;
+  axis.acceleration = acceleration;
+  axis.min_interval = fmaxf(sampleHz / maxSpeed, minInterval);
+  // First step delay of D. Austin's real-time ramp, as in AccelStepper.
+  axis.first_interval =
+      axis.ramp ? fmaxf(0.676f * sqrtf(2.0f / acceleration) * sampleHz, axis.min_interval) : axis.min_interval;
+
+  if (axis.state == StreamState::IDLE) {
+    return;
+  }
+  if (!axis.ramp) {
+    axis.interval = axis.min_interval;
+    return;
+  }
+  const float speed = sampleHz / axis.interval;
+  axis.ramp_steps = static_cast<int32_t>(speed * speed / (2.0f * acceleration));
+}
+
+void start_axis(StreamAxis &axis, const StreamCommand &command, const StreamTiming &timing, uint32_t now) {
+  const bool fromRest = axis.state == StreamState::IDLE;
+  const bool dirChange = command.direction != axis.direction;
+
+  if (fromRest || dirChange) {
+    axis.state = StreamState::IDLE;
+  }
+  set_axis_profile(axis, timing, command.max_speed, command.acceleration);
+  axis.state = command.state;
+  axis.stopping = false;
+  axis.direction = command.direction;
+  axis.target = axis.position + ((command.state == StreamState::POSITIONING) ? command.steps : 0);
+  axis.end_sample = now + static_cast<uint32_t>(static_cast<uint64_t>(command.time_ms) * timing.sample_hz / 1000);
+
+  if (fromRest || dirChange) {
+    axis.ramp_steps = 0;
+    axis.interval = axis.first_interval;
+    axis.carry = 0.0f;
+    // Clear of the tail of the last pulse, and of the DIR change.
+    uint32_t delay = (axis.pulse_carry > 0) ? axis.pulse_carry + timing.pulse_samples : 0;
+    if (dirChange && delay < timing.dir_setup_samples) {
+      delay = timing.dir_setup_samples;
+    }
+    axis.next_sample = now + delay;
+  }
+}
+
+// Resolves an absolute target against the position reached. A moving ramped
+// axis that would have to reverse, or cannot stop in the steps left, ramps to
+// rest first and returns false, leaving the command pending.
+bool resolve_target(StreamAxis &axis, StreamCommand &command) {
+  // Clamped to one command's reach; a longer way goes as far as it can.
+  const int64_t toGo = command.target - axis.position;
+  command.direction = (toGo >= 0) ? 1 : -1;
+  command.steps = static_cast<int32_t>((toGo > INT32_MAX) ? INT32_MAX : (toGo < -INT32_MAX) ? -INT32_MAX : toGo);
+  if (axis.state == StreamState::IDLE || !axis.ramp) {
+    return true;
+  }
+  if (command.direction != axis.direction || llabs(toGo) < axis.ramp_steps) {
+    stop_axis(axis, true);
+    return false;
+  }
+  return true;
+}
+
+void schedule_next(StreamAxis &axis) {
+  const float due = axis.interval + axis.carry;
+  const float whole = floorf(due);
+  axis.carry = due - whole;
+  axis.next_sample += static_cast<uint32_t>(whole);
+}
+
+// Runs after every step: one update of the ramp, counting steps up the ramp so
+// the axis knows how many it needs to stop (the accel and decel rates are equal).
+void advance(StreamAxis &axis) {
+  const bool positioning = axis.state == StreamState::POSITIONING;
+  if (positioning && axis.position == axis.target) {
+    finish(axis);
+    return;
+  }
+
+  if (axis.ramp) {
+    const int64_t remaining = positioning ? llabs(axis.target - axis.position) : INT64_MAX;
+    if (axis.stopping || remaining <= axis.ramp_steps) {
+      if (axis.ramp_steps <= 1) {
+        if (axis.stopping) {
+          finish(axis);
+          return;
+        }
+        axis.ramp_steps = 0;
+        axis.interval = axis.first_interval;
+      } else {
+        const float k = static_cast<float>(axis.ramp_steps);
+        axis.interval *= (4.0f * k + 1.0f) / (4.0f * k - 1.0f);
+        --axis.ramp_steps;
+      }
+    } else if (axis.interval > axis.min_interval) {
+      const float k = static_cast<float>(axis.ramp_steps);
+      axis.interval = fmaxf(axis.interval * (4.0f * k + 3.0f) / (4.0f * k + 5.0f), axis.min_interval);
+      ++axis.ramp_steps;
+    } else if (axis.interval < axis.min_interval && axis.ramp_steps > 1) {
+      // Above a lowered limit: ramp down to it.
+      const float k = static_cast<float>(axis.ramp_steps);
+      axis.interval = fminf(axis.interval * (4.0f * k + 1.0f) / (4.0f * k - 1.0f), axis.min_interval);
+      --axis.ramp_steps;
+    }
+  }
+  schedule_next(axis);
+}
+}  // namespace
+
+// Commands are picked up at buffer boundaries, so DIR only ever changes on one.
+// A reversal of a ramped axis ramps it down first and starts once it is at rest.
+void step_stream_fill_command(StreamAxis &axis, StreamCommand &command, const StreamTiming &timing, uint32_t now) {
+  if (!command.pending) {
+    return;
+  }
+
+  if (command.retune) {
+    command.pending = false;
+    set_axis_profile(axis, timing, command.max_speed, command.acceleration);
+  } else if (command.state == StreamState::IDLE && command.absolute) {
+    command.pending = false;
+    if (axis.state == StreamState::IDLE) {
+      axis.position = command.target;
+      axis.target = command.target;
+    }
+  } else if (command.state == StreamState::IDLE) {
+    command.pending = false;
+    stop_axis(axis, command.ramp);
+    if (command.steps != 0 && axis.state == StreamState::IDLE) {
+      axis.target = axis.position + command.steps;
+    }
+  } else if (command.absolute) {
+    if (!resolve_target(axis, command)) {
+      return;
+    }
+    command.pending = false;
+    if (command.steps != 0) {
+      start_axis(axis, command, timing, now);
+    } else {
+      axis.target = axis.position;
+      stop_axis(axis, false);
+    }
+  } else if (axis.state != StreamState::IDLE && axis.ramp && command.direction != axis.direction) {
+    stop_axis(axis, true);
+  } else {
+    command.pending = false;
+    start_axis(axis, command, timing, now);
+  }
+}
+
+void step_stream_fill_clear(const StreamAxis *axes, uint8_t count, const StreamTiming &timing, void *buffer) {
+  uint16_t dirBits = 0;
+  for (uint8_t index = 0; index < count; ++index) {
+    if (axes[index].direction > 0) {
+      dirBits |= static_cast<uint16_t>(1U << (timing.bus_width / 2 + index));
+    }
+  }
+
+  if (timing.bus_width == 8) {
+    memset(buffer, static_cast<uint8_t>(dirBits), timing.buffer_samples);
+    return;
+  }
+  uint16_t *words = static_cast<uint16_t *>(buffer);
+  for (uint16_t sample = 0; sample < timing.buffer_samples; ++sample) {
+    words[sample] = dirBits;
+  }
+}
+
+void step_stream_fill_axis(StreamAxis &axis, uint8_t index, const StreamTiming &timing, uint32_t start,
+                           void *buffer) {
+  const uint16_t stepBit = static_cast<uint16_t>(1U << index);
+  const float sampleHz = static_cast<float>(timing.sample_hz);
+
+  // The tail of a pulse that began in the previous buffer.
+  const uint32_t earliest = (axis.pulse_carry > 0) ? axis.pulse_carry + timing.pulse_samples : 0;
+  set_words(buffer, timing, 0, axis.pulse_carry, stepBit);
+  axis.pulse_carry = 0;
+
+  while (axis.state != StreamState::IDLE) {
+    // A timed run starts its ramp down so that it is at rest by end_sample.
+    const uint32_t stopSamples =
+        axis.ramp ? static_cast<uint32_t>(sampleHz / axis.interval / axis.acceleration * sampleHz) : 0;
+    if (axis.state == StreamState::TIMED_RUN && !axis.stopping &&
+        static_cast<int32_t>(axis.next_sample + stopSamples - axis.end_sample) >= 0) {
+      stop_axis(axis, true);
+      if (axis.state == StreamState::IDLE) {
+        break;
+      }
+    }
+
+    int32_t offset = static_cast<int32_t>(axis.next_sample - start);
+    if (offset >= timing.buffer_samples) {
+      break;
+    }
+    if (offset < static_cast<int32_t>(earliest)) {
+      // Due while the queue ran dry; continue from the start of this buffer.
+      axis.next_sample = start + earliest;
+      offset = static_cast<int32_t>(earliest);
+    }
+    const uint32_t room = timing.buffer_samples - static_cast<uint32_t>(offset);
+    const uint32_t high = (timing.pulse_samples < room) ? timing.pulse_samples : room;
+    set_words(buffer, timing, static_cast<uint32_t>(offset), high, stepBit);
+    axis.pulse_carry = static_cast<uint16_t>(timing.pulse_samples - high);
+    axis.position += axis.direction;
+    advance(axis);
+  }
+}
+
+StreamStatus step_stream_fill_status(const StreamAxis &axis, const StreamTiming &timing) {
+  StreamStatus status;
+  status.state = axis.state;
+  status.position = axis.position;
+  const bool run = axis.state == StreamState::CONTINUOUS || axis.state == StreamState::TIMED_RUN;
+  status.remaining = run ? 0 : static_cast<int32_t>(axis.target - axis.position);
+  status.speed = (axis.state != StreamState::IDLE)
+                     ? axis.direction * static_cast<float>(timing.sample_hz) / axis.interval
+                     : 0.0f;
+  return status;
+}
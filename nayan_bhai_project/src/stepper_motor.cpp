@@ -1,10 +1,17 @@
 #include "stepper_motor.h"
 #include "main.h"
+#include "encoder.h"
+#include "motion_profile.h"
+#include "motion_snapshot.h"
+#include "stall_detector.h"
+#include "step_stream.h"
+#include "trace.h"
 
 #include <AccelStepper.h>
+#include <esp_timer.h>
 
 namespace {
-AccelStepper steppers[STEPPER_MOTOR_COUNT] = {
+AccelStepper steppers[STEPPER_GPIO_AXES] = {
     AccelStepper(AccelStepper::DRIVER, static_cast<uint8_t>(PIN_S_M1_STEP), static_cast<uint8_t>(PIN_S_M1_DIR)),
     AccelStepper(AccelStepper::DRIVER, static_cast<uint8_t>(PIN_S_M2_STEP), static_cast<uint8_t>(PIN_S_M2_DIR)),
     AccelStepper(AccelStepper::DRIVER, static_cast<uint8_t>(PIN_S_M3_STEP), static_cast<uint8_t>(PIN_S_M3_DIR)),
@@ -12,20 +19,65 @@ AccelStepper steppers[STEPPER_MOTOR_COUNT] = {
 
 struct StepperRuntime {
   bool timedRunActive;
-  uint32_t timedRunEndMs;
+  int64_t timedRunEndUs;
   bool infiniteRunActive;
+  float velocityTarget;      // signed speed a continuous or timed run heads for
+  float velocity;            // signed speed it runs at
+  int64_t velocityUpdateUs;
+  int64_t positionBase;      // steps folded out of AccelStepper's 32-bit position
   bool stepRunActive;
   int32_t stepRunTarget;
   int8_t stepRunDirection;
+  int8_t encoder;
+  uint8_t stallRetries;
+  bool reducedSpeed;
+  bool faulted;
+  int32_t faultRemaining;    // signed steps a move that gave up on a stall had left
+  uint32_t lastStallCheckUs;
+  bool traceMoving;
+  float maxSpeed;      // profile of the active command
+  float acceleration;
+  bool noRamp;         // ramp mode of the active command; a config change applies from the next one
 };
 
+// Stream axes (index >= STEPPER_GPIO_AXES) use the profile fields only.
 StepperRuntime runtime[STEPPER_MOTOR_COUNT] = {};
+StallDetector stallDetectors[STEPPER_GPIO_AXES] = {};
+StepperStallCallback g_stallCallback = nullptr;
+
+const gpio_num_t kEncoderPinA[STEPPER_GPIO_AXES] = {PIN_S_M1_ENC_A, PIN_S_M2_ENC_A, PIN_S_M3_ENC_A};
+const gpio_num_t kEncoderPinB[STEPPER_GPIO_AXES] = {PIN_S_M1_ENC_B, PIN_S_M2_ENC_B, PIN_S_M3_ENC_B};
 
 float g_maxSpeed = STEPPER_DEFAULT_MAX_SPEED;
 float g_acceleration = STEPPER_DEFAULT_ACCEL;
 float g_deceleration = STEPPER_DEFAULT_DECEL;
 bool g_noRampMode = false;
 
+constexpr uint16_t STEPPER_ALL_AXES = (1U << STEPPER_MOTOR_COUNT) - 1;
+constexpr int32_t POSITION_FOLD_STEPS = 1L << 30;
+
+struct StepperTrigger {
+  volatile bool armed;
+  uint8_t index;
+  StepperTriggerCondition condition;
+  int64_t position;
+  int8_t side;  // sign of (position - commanded position) when armed
+  StepperTriggerCallback callback;
+  StepperTriggerCallback release;  // runs instead of callback when disarmed unfired
+  void *arg;
+};
+
+StepperTrigger triggers[STEPPER_MAX_TRIGGERS] = {};
+volatile uint8_t g_armedTriggers = 0;
+portMUX_TYPE g_triggerMux = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t g_lastServiceUs = 0;
+bool g_serviceWasMoving = false;
+volatile uint32_t g_maxServiceGapUs = 0;
+
+const StepperProfileEntry *g_profileTable = nullptr;
+uint8_t g_profileTableCount = 0;
+
 bool is_valid_motor(uint8_t motor_number) {
   return motor_number >= 1 && motor_number <= STEPPER_MOTOR_COUNT;
 }
@@ -34,38 +86,552 @@ uint8_t idx_from_motor(uint8_t motor_number) {
   return motor_number - 1;
 }
 
+bool is_stream_axis(uint8_t index) {
+  return index >= STEPPER_GPIO_AXES;
+}
+
+uint8_t stream_axis(uint8_t index) {
+  return index - STEPPER_GPIO_AXES;
+}
+
+float stream_acceleration(uint8_t index) {
+  return runtime[index].noRamp ? 0.0f : runtime[index].acceleration;
+}
+
 bool is_motor_motion_complete(uint8_t index) {
+  if (is_stream_axis(index)) {
+    return step_stream_state(stream_axis(index)) == StepperMotionState::IDLE;
+  }
   const bool stepRunActive = runtime[index].stepRunActive;
   const bool infiniteRunActive = runtime[index].infiniteRunActive;
   const bool timedRunActive = runtime[index].timedRunActive;
   const int32_t remainingSteps = steppers[index].distanceToGo();
   return !stepRunActive && !infiniteRunActive && !timedRunActive && (remainingSteps == 0);
 }
+
+float axis_speed_limit(uint8_t index) {
+  const float maxSpeed = runtime[index].maxSpeed;
+  return runtime[index].reducedSpeed ? maxSpeed * STEPPER_STALL_RETRY_SPEED_FACTOR : maxSpeed;
+}
+
+// Continuous and timed runs are driven by update_velocity(), including their ramp down.
+bool is_velocity_run(uint8_t index) {
+  return runtime[index].infiniteRunActive || runtime[index].timedRunActive;
+}
+
+// Speed-driven motion runs at the speed set with setSpeed(), without AccelStepper's ramp.
+bool is_speed_driven(uint8_t index) {
+  return runtime[index].stepRunActive || is_velocity_run(index);
+}
+
+int64_t position_64(uint8_t index) {
+  return runtime[index].positionBase + steppers[index].currentPosition();
+}
+
+// Applies the axis' speed limit. A move already faster than a lowered limit
+// keeps the old one here: stepper_service() walks a ramped positioning move
+// down, and velocity runs ramp down on their own. AccelStepper's setMaxSpeed()
+// would cut the speed in a single step.
+void apply_speed_limit(uint8_t index) {
+  const float limit = axis_speed_limit(index);
+  if (!runtime[index].stepRunActive && fabsf(steppers[index].speed()) > limit) {
+    return;
+  }
+  steppers[index].setMaxSpeed(limit);
+}
+
+void apply_axis_profile(uint8_t index, float maxSpeed, float acceleration) {
+  runtime[index].maxSpeed = maxSpeed;
+  runtime[index].acceleration = acceleration;
+  if (is_stream_axis(index)) {
+    return;
+  }
+  // AccelStepper rescales the ramp position to the new rate, so the speed carries over.
+  steppers[index].setAcceleration(acceleration);
+  apply_speed_limit(index);
+}
+
+// Lowers AccelStepper's max speed toward a reduced limit by at most the
+// acceleration over elapsedUs; each call caps the speed at the new value.
+void slew_speed_limit(uint8_t index, uint32_t elapsedUs) {
+  const float limit = axis_speed_limit(index);
+  if (steppers[index].maxSpeed() <= limit || is_velocity_run(index)) {
+    return;
+  }
+  const float slowed = fabsf(steppers[index].speed()) - runtime[index].acceleration * elapsedUs * 1e-6f;
+  steppers[index].setMaxSpeed(fmaxf(slowed, limit));
+}
+
+// Changes the profile of the active command in place. Speed-driven motion has
+// no ramp to blend along and takes the new speed at once.
+void retune_axis(uint8_t index, float maxSpeed, float acceleration) {
+  apply_axis_profile(index, maxSpeed, acceleration);
+  if (is_stream_axis(index)) {
+    step_stream_set_profile(stream_axis(index), maxSpeed, stream_acceleration(index));
+    return;
+  }
+  const float limit = axis_speed_limit(index);
+  if (is_velocity_run(index) && runtime[index].velocityTarget != 0.0f) {
+    runtime[index].velocityTarget = (runtime[index].velocityTarget < 0.0f) ? -limit : limit;
+  } else if (runtime[index].stepRunActive) {
+    steppers[index].setSpeed((steppers[index].speed() < 0.0f) ? -limit : limit);
+  }
+}
+
+// Hands the axis to update_velocity(), carrying over the speed it has. The
+// caller sets which kind of run it is.
+void start_velocity_run(uint8_t index, float signedSpeed) {
+  StepperRuntime &axis = runtime[index];
+  if (!is_velocity_run(index)) {
+    axis.velocity = is_motor_motion_complete(index) ? 0.0f : steppers[index].speed();
+    axis.velocityUpdateUs = esp_timer_get_time();
+    // Drops AccelStepper's positioning target; the speed is set every service.
+    steppers[index].setCurrentPosition(steppers[index].currentPosition());
+  }
+  axis.stepRunActive = false;
+  axis.velocityTarget = signedSpeed;
+}
+
+// Ramps a continuous or timed run toward its target speed at the axis
+// acceleration, or jumps there without ramps. A timed run heads for rest once
+// the time left equals its time to stop, so its duration includes both ramps.
+void update_velocity(uint8_t index) {
+  StepperRuntime &axis = runtime[index];
+  const int64_t now = esp_timer_get_time();
+  const float elapsed = static_cast<float>(now - axis.velocityUpdateUs) * 1e-6f;
+  axis.velocityUpdateUs = now;
+  const bool ramped = !axis.noRamp && axis.acceleration > 0.0f;
+
+  if (axis.timedRunActive && axis.velocityTarget != 0.0f) {
+    const float stopUs = ramped ? fabsf(axis.velocity) / axis.acceleration * 1e6f : 0.0f;
+    if (now + static_cast<int64_t>(stopUs) >= axis.timedRunEndUs) {
+      axis.velocityTarget = 0.0f;
+    }
+  }
+
+  if (ramped) {
+    const float change = axis.velocityTarget - axis.velocity;
+    const float limit = axis.acceleration * elapsed;
+    axis.velocity += (change > limit) ? limit : ((change < -limit) ? -limit : change);
+  } else {
+    axis.velocity = axis.velocityTarget;
+  }
+
+  if (axis.velocity == 0.0f && axis.velocityTarget == 0.0f) {
+    axis.infiniteRunActive = false;
+    axis.timedRunActive = false;
+    // At rest where it is; no target left behind for run() to head back to.
+    steppers[index].setCurrentPosition(steppers[index].currentPosition());
+    return;
+  }
+  steppers[index].setSpeed(axis.velocity);
+}
+
+// Moves whole POSITION_FOLD_STEPS out of AccelStepper's 32-bit position into
+// positionBase, so velocity runs can go on indefinitely. Positioning moves
+// keep their target in AccelStepper's coordinates and are left alone.
+void fold_position(uint8_t index) {
+  const int32_t position = steppers[index].currentPosition();
+  if (position < POSITION_FOLD_STEPS && position > -POSITION_FOLD_STEPS) {
+    return;
+  }
+  if (!is_velocity_run(index) && !is_motor_motion_complete(index)) {
+    return;
+  }
+  const int32_t fold = (position > 0) ? POSITION_FOLD_STEPS : -POSITION_FOLD_STEPS;
+  // setCurrentPosition() also zeroes the speed, which update_velocity() sets again.
+  steppers[index].setCurrentPosition(position - fold);
+  runtime[index].positionBase += fold;
+  if (runtime[index].encoder != ENCODER_NONE) {
+    stall_detector_sync(stallDetectors[index], position - fold, encoder_read(runtime[index].encoder));
+  }
+}
+
+// Stops one GPIO axis along its ramp, or at once without ramps.
+void stop_axis(uint8_t index) {
+  runtime[index].stepRunActive = false;
+  if (is_velocity_run(index)) {
+    runtime[index].velocityTarget = 0.0f;
+  } else if (runtime[index].noRamp) {
+    // Also clears the target, which speed-driven steps leave behind.
+    steppers[index].setCurrentPosition(steppers[index].currentPosition());
+  } else {
+    steppers[index].stop();
+  }
+}
+
+// Picks the profile-table entry for a step run, or the global config.
+void select_move_profile(uint8_t index, int32_t steps) {
+  for (uint8_t entry = 0; entry < g_profileTableCount; ++entry) {
+    const StepperProfileEntry &row = g_profileTable[entry];
+    if (row.motor_number == index + 1 && row.steps == steps) {
+      apply_axis_profile(index, row.max_speed, row.acceleration);
+      return;
+    }
+  }
+  apply_axis_profile(index, g_maxSpeed, g_acceleration);
+}
+
+// Clears stall retry state when a new command is issued.
+void reset_stall_state(uint8_t index) {
+  runtime[index].stallRetries = 0;
+  runtime[index].faulted = false;
+  runtime[index].faultRemaining = 0;
+  if (runtime[index].reducedSpeed) {
+    runtime[index].reducedSpeed = false;
+    steppers[index].setMaxSpeed(runtime[index].maxSpeed);
+  }
+}
+
+// Corrects the commanded position to the encoder and retries the active
+// command at reduced speed, or stops the axis once retries are exhausted.
+void handle_stall(uint8_t index, int32_t encoderCount) {
+  StallDetector &detector = stallDetectors[index];
+  const int32_t commanded = steppers[index].currentPosition();
+  const int32_t actual = stall_detector_actual_position(detector, encoderCount);
+  const int32_t target = (runtime[index].noRamp && runtime[index].stepRunActive) ? runtime[index].stepRunTarget
+                                                                         : steppers[index].targetPosition();
+
+  StepperStallEvent event = {
+      static_cast<uint8_t>(index + 1), commanded, actual, commanded - actual, runtime[index].stallRetries, false,
+  };
+
+  // setCurrentPosition() also zeroes speed and moves the target onto the new position.
+  steppers[index].setCurrentPosition(actual);
+  stall_detector_sync(detector, actual, encoderCount);
+
+  if (runtime[index].stallRetries >= STEPPER_STALL_MAX_RETRIES) {
+    event.gave_up = true;
+    runtime[index].faulted = true;
+    // Kept for the next hold: the move stays incomplete until a pause and resume finish it.
+    runtime[index].faultRemaining = is_velocity_run(index) ? 0 : target - actual;
+    runtime[index].stepRunActive = false;
+    runtime[index].timedRunActive = false;
+    runtime[index].infiniteRunActive = false;
+  } else {
+    ++runtime[index].stallRetries;
+    runtime[index].reducedSpeed = true;
+    const float speedLimit = axis_speed_limit(index);
+    steppers[index].setMaxSpeed(speedLimit);
+
+    if (runtime[index].stepRunActive) {
+      runtime[index].stepRunDirection = (target >= actual) ? 1 : -1;
+      steppers[index].setSpeed((target >= actual) ? speedLimit : -speedLimit);
+    } else if (is_velocity_run(index)) {
+      // Ramp up again from rest, to the reduced limit unless it was stopping.
+      runtime[index].velocity = 0.0f;
+      if (runtime[index].velocityTarget != 0.0f) {
+        runtime[index].velocityTarget = (runtime[index].velocityTarget < 0.0f) ? -speedLimit : speedLimit;
+      }
+    } else {
+      // Ramped positioning: head for the same target again.
+      steppers[index].moveTo(target);
+    }
+  }
+
+  if (g_stallCallback != nullptr) {
+    g_stallCallback(event);
+  }
+}
+
+void supervise_encoder(uint8_t index, uint32_t nowUs) {
+  if (runtime[index].encoder == ENCODER_NONE) {
+    return;
+  }
+  if (static_cast<uint32_t>(nowUs - runtime[index].lastStallCheckUs) < STEPPER_STALL_CHECK_PERIOD_US) {
+    return;
+  }
+  runtime[index].lastStallCheckUs = nowUs;
+
+  const int32_t encoderCount = encoder_read(runtime[index].encoder);
+  if (is_motor_motion_complete(index)) {
+    if (runtime[index].reducedSpeed) {
+      runtime[index].reducedSpeed = false;
+      steppers[index].setMaxSpeed(runtime[index].maxSpeed);
+    }
+    return;
+  }
+
+  const StallCheck check =
+      stall_detector_update(stallDetectors[index], steppers[index].currentPosition(), encoderCount);
+  if (check == StallCheck::STALLED) {
+    handle_stall(index, encoderCount);
+  }
+}
+// Freezes the axis where it is (no deceleration ramp) and returns the signed
+// steps its step run had left.
+int32_t freeze_axis(uint8_t index) {
+  const int32_t remaining = runtime[index].noRamp
+    ? (runtime[index].stepRunActive ? runtime[index].stepRunTarget - steppers[index].currentPosition() : 0)
+    : steppers[index].distanceToGo();
+  steppers[index].setCurrentPosition(steppers[index].currentPosition());
+  runtime[index].stepRunActive = false;
+  runtime[index].timedRunActive = false;
+  runtime[index].infiniteRunActive = false;
+  runtime[index].velocity = 0.0f;
+  return remaining;
+}
+
+// Returns the steps a move that gave up on a stall had left and clears the
+// fault, so the axis gets its retries back for the remainder.
+int32_t take_fault_remaining(uint8_t index) {
+  const int32_t remaining = runtime[index].faultRemaining;
+  if (remaining != 0) {
+    reset_stall_state(index);
+  }
+  return remaining;
+}
+
+// True while a move on the axis is unfinished, including one that gave up on a stall.
+bool is_move_pending(uint8_t index) {
+  return !is_motor_motion_complete(index) || runtime[index].faultRemaining != 0;
+}
+
+// Brings the axes in mask to rest for a pause and stores the signed steps each
+// step run had left. Ramped motion decelerates along its profile, with the
+// deceleration scaled down so every axis stops at the same moment and none runs
+// past its target; the steps are all emitted, so the position stays exact.
+// Continuous and timed runs ramp down the same way and are dropped. Motion
+// without ramps freezes at once. Stream axes ramp down along their own profile.
+// A move that gave up on a stall hands over what it had left.
+void hold_axes(uint16_t mask, int32_t *remaining) {
+  bool decelerating[STEPPER_MOTOR_COUNT] = {};
+  bool positioning[STEPPER_MOTOR_COUNT] = {};
+  int32_t target[STEPPER_MOTOR_COUNT] = {};
+  float acceleration[STEPPER_MOTOR_COUNT] = {};
+  float stopTime = 0.0f;
+
+  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+    if (!(mask & (1U << index))) {
+      continue;
+    }
+    remaining[index] = 0;
+    if (is_stream_axis(index)) {
+      step_stream_stop(stream_axis(index), true);
+      continue;
+    }
+
+    const float speed = fabsf(steppers[index].speed());
+    const bool ramped = !runtime[index].noRamp && !runtime[index].stepRunActive && speed > 0.0f &&
+                        runtime[index].acceleration > 0.0f;
+    if (!ramped) {
+      remaining[index] = freeze_axis(index);
+      continue;
+    }
+
+    decelerating[index] = true;
+    positioning[index] = !is_velocity_run(index);
+    target[index] = steppers[index].targetPosition();
+    acceleration[index] = runtime[index].acceleration;
+    stopTime = fmaxf(stopTime, speed / runtime[index].acceleration);
+  }
+
+  for (uint8_t index = 0; index < STEPPER_GPIO_AXES; ++index) {
+    if (!decelerating[index]) {
+      continue;
+    }
+
+    const float speed = fabsf(steppers[index].speed());
+    float rate = speed / stopTime;
+    if (!positioning[index]) {
+      runtime[index].acceleration = rate;
+      runtime[index].velocityTarget = 0.0f;
+      continue;
+    }
+    // AccelStepper::stop() adds one step to the stopping distance.
+    const long limit = labs(steppers[index].distanceToGo()) - 1;
+    if (limit <= 0) {
+      continue;
+    }
+    rate = fmaxf(rate, speed * speed / (2.0f * static_cast<float>(limit)));
+    if (rate >= runtime[index].acceleration) {
+      continue;  // already decelerating into its target
+    }
+    steppers[index].setAcceleration(rate);
+    steppers[index].stop();
+  }
+
+  for (;;) {
+    bool atRest = true;
+    for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+      if (is_stream_axis(index)) {
+        atRest = atRest && (!(mask & (1U << index)) || is_motor_motion_complete(index));
+      } else {
+        atRest = atRest && (!decelerating[index] || is_motor_motion_complete(index));
+      }
+    }
+    if (atRest) {
+      break;
+    }
+    stepper_service();
+    delay(0);
+  }
+
+  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+    if (is_stream_axis(index) && (mask & (1U << index))) {
+      remaining[index] = step_stream_remaining(stream_axis(index));
+    } else if (decelerating[index]) {
+      remaining[index] = positioning[index] ? target[index] - steppers[index].currentPosition() : 0;
+      runtime[index].acceleration = acceleration[index];
+      steppers[index].setAcceleration(acceleration[index]);
+    }
+    if (!is_stream_axis(index) && (mask & (1U << index))) {
+      remaining[index] += take_fault_remaining(index);
+    }
+  }
+}
+
+// Resumes a held step run from where it stopped; AccelStepper ramps from 0 to full speed.
+void resume_axis(uint8_t index, int32_t remaining) {
+  if (remaining == 0) {
+    return;
+  }
+  if (is_stream_axis(index)) {
+    step_stream_move(stream_axis(index), remaining, runtime[index].maxSpeed, stream_acceleration(index));
+  } else if (runtime[index].noRamp) {
+    runtime[index].stepRunActive = true;
+    runtime[index].stepRunDirection = (remaining > 0) ? 1 : -1;
+    runtime[index].stepRunTarget = steppers[index].currentPosition() + remaining;
+    steppers[index].setSpeed((remaining > 0) ? runtime[index].maxSpeed : -runtime[index].maxSpeed);
+  } else {
+    // Re-apply config to guarantee clean accel/decel profile from 0
+    apply_axis_profile(index, runtime[index].maxSpeed, runtime[index].acceleration);
+    steppers[index].move(remaining);
+  }
+}
+
+// Resumes the held step runs of mask together. Each axis's profile is scaled
+// down so its move takes as long as the slowest one's, as hold_axes() scales the
+// stop, and the axes arrive together. Speed times k and acceleration times k^2
+// keep the shape of the ramp and divide its duration by k.
+void resume_axes(uint16_t mask, const int32_t *remaining) {
+  uint32_t moveUs[STEPPER_MOTOR_COUNT] = {};
+  uint32_t slowestUs = 0;
+  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+    if (!(mask & (1U << index)) || remaining[index] == 0) {
+      continue;
+    }
+    const MotionProfile profile = {runtime[index].maxSpeed, runtime[index].acceleration, runtime[index].acceleration,
+                                   runtime[index].noRamp};
+    moveUs[index] = motion_profile_plan(profile, static_cast<uint32_t>(labs(remaining[index]))).total_us;
+    if (moveUs[index] > slowestUs) {
+      slowestUs = moveUs[index];
+    }
+  }
+
+  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
+    if (!(mask & (1U << index))) {
+      continue;
+    }
+    if (moveUs[index] > 0 && moveUs[index] < slowestUs) {
+      const float k = static_cast<float>(moveUs[index]) / static_cast<float>(slowestUs);
+      // Held for the rest of this move only; the next command selects its own profile.
+      runtime[index].maxSpeed *= k;
+      runtime[index].acceleration *= k * k;
+    }
+    resume_axis(index, remaining[index]);
+  }
+}
+
+// AccelStepper starts decelerating once the stopping distance covers what is
+// left to go; a velocity run once it heads for rest.
+bool in_decel_phase(uint8_t index) {
+  if (is_velocity_run(index)) {
+    return !runtime[index].noRamp && runtime[index].velocityTarget == 0.0f && runtime[index].velocity != 0.0f;
+  }
+  if (runtime[index].stepRunActive) {
+    return false;
+  }
+  const float speed = steppers[index].speed();
+  const float acceleration = runtime[index].acceleration;
+  const long remaining = labs(steppers[index].distanceToGo());
+  return acceleration > 0.0f && speed != 0.0f && remaining <= static_cast<long>(speed * speed / (2.0f * acceleration));
+}
+
+bool trigger_condition_met(const StepperTrigger &trigger, bool moving) {
+  const uint8_t index = trigger.index;
+  if (trigger.condition == StepperTriggerCondition::CROSS_POSITION) {
+    return (position_64(index) - trigger.position) * trigger.side >= 0;
+  }
+  // Without ramps there is no decel phase; fire when the move ends.
+  return moving ? in_decel_phase(index) : runtime[index].traceMoving;
+}
+
+void check_triggers(uint8_t index, bool moving) {
+  for (uint8_t slot = 0; slot < STEPPER_MAX_TRIGGERS; ++slot) {
+    StepperTrigger &trigger = triggers[slot];
+    if (!trigger.armed || trigger.index != index || !trigger_condition_met(trigger, moving)) {
+      continue;
+    }
+
+    portENTER_CRITICAL(&g_triggerMux);
+    const bool fire = trigger.armed;
+    trigger.armed = false;
+    if (fire) {
+      --g_armedTriggers;
+    }
+    portEXIT_CRITICAL(&g_triggerMux);
+
+    if (fire) {
+      trigger.callback(trigger.arg);
+    }
+  }
+}
 }  // namespace
 
+void stepper_safe_state() {
+  pinMode(static_cast<uint8_t>(PIN_S_M_EN), OUTPUT);
+  stepper_enable(false);
+
+  const gpio_num_t pins[] = {
+    PIN_S_M1_STEP, PIN_S_M1_DIR, PIN_S_M2_STEP, PIN_S_M2_DIR, PIN_S_M3_STEP, PIN_S_M3_DIR,
+  };
+  for (const gpio_num_t pin : pins) {
+    pinMode(static_cast<uint8_t>(pin), OUTPUT);
+    digitalWrite(static_cast<uint8_t>(pin), LOW);
+  }
+  if (STEPPER_STREAM_AXES > 0) {
+    for (const gpio_num_t pin : PIN_STEP_STREAM_DATA) {
+      if (pin != GPIO_NUM_NC) {
+        pinMode(static_cast<uint8_t>(pin), OUTPUT);
+        digitalWrite(static_cast<uint8_t>(pin), LOW);
+      }
+    }
+  }
+}
+
 void stepper_init() {
   pinMode(static_cast<uint8_t>(PIN_S_M_EN), OUTPUT);
   stepper_enable(true);
 
   for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
-    steppers[index].setMaxSpeed(g_maxSpeed);
-    steppers[index].setAcceleration(g_acceleration);
+    apply_axis_profile(index, g_maxSpeed, g_acceleration);
+  }
+  for (uint8_t index = 0; index < STEPPER_GPIO_AXES; ++index) {
     steppers[index].setCurrentPosition(0);
+
+    runtime[index].encoder = encoder_attach(kEncoderPinA[index], kEncoderPinB[index]);
+    const StallDetectorConfig stallConfig = {
+        STEPPER_ENCODER_COUNTS_PER_STEP, STEPPER_FOLLOWING_ERROR_LIMIT, STEPPER_STALL_CONFIRM_SAMPLES,
+    };
+    stall_detector_init(stallDetectors[index], stallConfig);
   }
+  step_stream_init();
 }
 
 void stepper_service() {
-  const uint32_t now = millis();
+  const uint32_t nowUs = micros();
+  bool anyMoving = false;
 
-  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
-    if (runtime[index].timedRunActive && static_cast<int32_t>(now - runtime[index].timedRunEndMs) >= 0) {
-      runtime[index].timedRunActive = false;
-      if (g_noRampMode) {
-        steppers[index].setSpeed(0.0f);
-      } else {
-        steppers[index].stop();
-      }
-    }
+  const uint32_t elapsedUs = nowUs - g_lastServiceUs;
+  if (g_serviceWasMoving && elapsedUs > g_maxServiceGapUs) {
+    g_maxServiceGapUs = elapsedUs;
+  }
+
+  for (uint8_t index = 0; index < STEPPER_GPIO_AXES; ++index) {
+    supervise_encoder(index, nowUs);
+    slew_speed_limit(index, elapsedUs);
+    fold_position(index);
 
     if (runtime[index].stepRunActive) {
       const int32_t currentPosition = steppers[index].currentPosition();
@@ -79,40 +645,52 @@ void stepper_service() {
       } else {
         steppers[index].runSpeed();
       }
-    } else if (runtime[index].infiniteRunActive || (g_noRampMode && runtime[index].timedRunActive)) {
+    } else if (is_velocity_run(index)) {
+      update_velocity(index);
       steppers[index].runSpeed();
     } else {
       steppers[index].run();
     }
-  }
-}
 
-void steppr_set_config(float speed, float acceleration, float deceleration) {
-  if (speed <= 0.0f) {
-    speed = STEPPER_DEFAULT_MAX_SPEED;
-  }
+    const bool moving = !is_motor_motion_complete(index);
+    anyMoving = anyMoving || moving;
 
-  const bool noRampRequested = (acceleration == -1.0f) || (deceleration == -1.0f);
-  if (noRampRequested) {
-    acceleration = STEPPER_DEFAULT_ACCEL;
-    deceleration = STEPPER_DEFAULT_DECEL;
+    if (g_armedTriggers > 0) {
+      check_triggers(index, moving);
+    }
+    if (moving != runtime[index].traceMoving) {
+      runtime[index].traceMoving = moving;
+      const TraceTrack track = static_cast<TraceTrack>(static_cast<uint8_t>(TraceTrack::STEPPER_1) + index);
+      if (moving) {
+        const int32_t target = runtime[index].stepRunActive ? runtime[index].stepRunTarget
+                                                            : steppers[index].targetPosition();
+        trace_begin(TraceEvent::STEPPER_MOVE, track, target);
+      } else {
+        trace_end(TraceEvent::STEPPER_MOVE, track, steppers[index].currentPosition());
+      }
+    }
   }
 
-  if (acceleration <= 0.0f) {
-    acceleration = STEPPER_DEFAULT_ACCEL;
-  }
-  if (deceleration <= 0.0f) {
-    deceleration = STEPPER_DEFAULT_DECEL;
-  }
+  g_serviceWasMoving = anyMoving;
+  g_lastServiceUs = nowUs;
+
+  motion_snapshot_service();
+}
+
+void steppr_set_config(float speed, float acceleration, float deceleration) {
+  const MotionProfile fallback = {
+      STEPPER_DEFAULT_MAX_SPEED, STEPPER_DEFAULT_ACCEL, STEPPER_DEFAULT_DECEL, false,
+  };
+  const MotionProfile profile = motion_profile_from_config(speed, acceleration, deceleration, fallback);
 
-  g_maxSpeed = speed;
-  g_acceleration = acceleration;
-  g_deceleration = deceleration;
-  g_noRampMode = noRampRequested;
+  g_maxSpeed = profile.max_speed;
+  g_acceleration = profile.acceleration;
+  g_deceleration = profile.deceleration;
+  g_noRampMode = profile.no_ramp;
 
+  // Running moves switch to the new speed and acceleration in place.
   for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
-    steppers[index].setMaxSpeed(g_maxSpeed);
-    steppers[index].setAcceleration(g_acceleration);
+    retune_axis(index, g_maxSpeed, g_acceleration);
   }
 }
 
@@ -120,24 +698,29 @@ void stepper_set_config(float speed, float acceleration, float deceleration) {
   steppr_set_config(speed, acceleration, deceleration);
 }
 
+void stepper_set_profile_table(const StepperProfileEntry *table, uint8_t count) {
+  g_profileTable = (count > 0) ? table : nullptr;
+  g_profileTableCount = (table != nullptr) ? count : 0;
+}
+
 void stepper_run_ms(uint8_t motor_number, uint32_t time_ms, Direction direction) {
   if (!is_valid_motor(motor_number) || time_ms == 0) {
     return;
   }
 
   const uint8_t index = idx_from_motor(motor_number);
-  const int32_t farTargetOffset = (direction == Direction::CW) ? 2000000000L : -2000000000L;
-  const float signedSpeed = (direction == Direction::CW) ? g_maxSpeed : -g_maxSpeed;
+  reset_stall_state(index);
+  runtime[index].noRamp = g_noRampMode;
+  apply_axis_profile(index, g_maxSpeed, g_acceleration);
+  if (is_stream_axis(index)) {
+    step_stream_run(stream_axis(index), direction, g_maxSpeed, stream_acceleration(index), time_ms);
+    return;
+  }
 
-  runtime[index].stepRunActive = false;
+  start_velocity_run(index, (direction == Direction::CW) ? g_maxSpeed : -g_maxSpeed);
   runtime[index].infiniteRunActive = false;
-  if (g_noRampMode) {
-    steppers[index].setSpeed(signedSpeed);
-  } else {
-    steppers[index].move(farTargetOffset);
-  }
   runtime[index].timedRunActive = true;
-  runtime[index].timedRunEndMs = millis() + time_ms;
+  runtime[index].timedRunEndUs = esp_timer_get_time() + static_cast<int64_t>(time_ms) * 1000;
 }
 
 void stepper_run_steps(uint8_t motor_number, int32_t steps, Direction direction) {
@@ -146,15 +729,23 @@ void stepper_run_steps(uint8_t motor_number, int32_t steps, Direction direction)
   }
 
   const uint8_t index = idx_from_motor(motor_number);
+  reset_stall_state(index);
+  runtime[index].noRamp = g_noRampMode;
+  select_move_profile(index, steps);
+  const float maxSpeed = runtime[index].maxSpeed;
   const int32_t signedSteps = (direction == Direction::CW) ? steps : -steps;
+  if (is_stream_axis(index)) {
+    step_stream_move(stream_axis(index), signedSteps, maxSpeed, stream_acceleration(index));
+    return;
+  }
 
   runtime[index].infiniteRunActive = false;
   runtime[index].timedRunActive = false;
-  if (g_noRampMode) {
+  if (runtime[index].noRamp) {
     runtime[index].stepRunActive = true;
     runtime[index].stepRunDirection = (signedSteps > 0) ? 1 : -1;
     runtime[index].stepRunTarget = steppers[index].currentPosition() + signedSteps;
-    steppers[index].setSpeed((signedSteps > 0) ? g_maxSpeed : -g_maxSpeed);
+    steppers[index].setSpeed((signedSteps > 0) ? maxSpeed : -maxSpeed);
   } else {
     runtime[index].stepRunActive = false;
     steppers[index].move(signedSteps);
@@ -171,37 +762,16 @@ void stepper_run_steps_blocking(uint8_t motor_number, int32_t steps, Direction d
   const uint8_t index = idx_from_motor(motor_number);
   for (;;) {
     if (g_paused) {
-      // Capture remaining distance before stopping
-      const int32_t remaining = g_noRampMode
-        ? (runtime[index].stepRunTarget - steppers[index].currentPosition())
-        : steppers[index].distanceToGo();
-      // Immediate freeze at current position (no deceleration ramp)
-      steppers[index].setCurrentPosition(steppers[index].currentPosition());
-      runtime[index].stepRunActive = false;
-      runtime[index].timedRunActive = false;
-      runtime[index].infiniteRunActive = false;
-
+      int32_t remaining[STEPPER_MOTOR_COUNT] = {};
+      hold_axes(1U << index, remaining);
       while (g_paused) delay(10);
-
-      // Resume from where we stopped — AccelStepper ramps from 0 to full speed
-      if (remaining != 0) {
-        if (g_noRampMode) {
-          runtime[index].stepRunActive = true;
-          runtime[index].stepRunDirection = (remaining > 0) ? 1 : -1;
-          runtime[index].stepRunTarget = steppers[index].currentPosition() + remaining;
-          steppers[index].setSpeed((remaining > 0) ? g_maxSpeed : -g_maxSpeed);
-        } else {
-          // Re-apply config to guarantee clean accel/decel profile from 0
-          steppers[index].setMaxSpeed(g_maxSpeed);
-          steppers[index].setAcceleration(g_acceleration);
-          steppers[index].move(remaining);
-        }
-      }
+      resume_axis(index, remaining[index]);
     }
 
     stepper_service();
 
-    if (is_motor_motion_complete(index)) {
+    // An axis that gave up stays here until the pause its stall raised is resumed.
+    if (!is_move_pending(index)) {
       break;
     }
 
@@ -228,44 +798,18 @@ void stepper_run_steps_batch_blocking(const StepperMove *moves, uint8_t move_cou
 
   for (;;) {
     if (g_paused) {
-      // Capture remaining steps for each motor before stopping
+      // Every axis stops; only the batch's own axes resume, all in the same pass
       int32_t remaining[STEPPER_MOTOR_COUNT] = {};
-      for (uint8_t moveIndex = 0; moveIndex < move_count; ++moveIndex) {
-        if (!is_valid_motor(moves[moveIndex].motor_number) || moves[moveIndex].steps <= 0) continue;
-        const uint8_t motorIndex = idx_from_motor(moves[moveIndex].motor_number);
-        remaining[motorIndex] = g_noRampMode
-          ? (runtime[motorIndex].stepRunTarget - steppers[motorIndex].currentPosition())
-          : steppers[motorIndex].distanceToGo();
-      }
-      // Immediate freeze at current positions
-      for (uint8_t i = 0; i < STEPPER_MOTOR_COUNT; ++i) {
-        steppers[i].setCurrentPosition(steppers[i].currentPosition());
-        runtime[i].stepRunActive = false;
-        runtime[i].timedRunActive = false;
-        runtime[i].infiniteRunActive = false;
-      }
+      hold_axes(STEPPER_ALL_AXES, remaining);
 
       while (g_paused) delay(10);
 
-      // Resume each motor from where it stopped — AccelStepper ramps from 0 to full speed
+      uint16_t batchMask = 0;
       for (uint8_t moveIndex = 0; moveIndex < move_count; ++moveIndex) {
         if (!is_valid_motor(moves[moveIndex].motor_number) || moves[moveIndex].steps <= 0) continue;
-        const uint8_t motorIndex = idx_from_motor(moves[moveIndex].motor_number);
-        const int32_t rem = remaining[motorIndex];
-        if (rem != 0) {
-          if (g_noRampMode) {
-            runtime[motorIndex].stepRunActive = true;
-            runtime[motorIndex].stepRunDirection = (rem > 0) ? 1 : -1;
-            runtime[motorIndex].stepRunTarget = steppers[motorIndex].currentPosition() + rem;
-            steppers[motorIndex].setSpeed((rem > 0) ? g_maxSpeed : -g_maxSpeed);
-          } else {
-            // Re-apply config to guarantee clean accel/decel profile from 0
-            steppers[motorIndex].setMaxSpeed(g_maxSpeed);
-            steppers[motorIndex].setAcceleration(g_acceleration);
-            steppers[motorIndex].move(rem);
-          }
-        }
+        batchMask |= 1U << idx_from_motor(moves[moveIndex].motor_number);
       }
+      resume_axes(batchMask, remaining);
     }
 
     bool allComplete = true;
@@ -279,7 +823,7 @@ void stepper_run_steps_batch_blocking(const StepperMove *moves, uint8_t move_cou
       }
 
       const uint8_t motorIndex = idx_from_motor(move.motor_number);
-      if (!is_motor_motion_complete(motorIndex)) {
+      if (is_move_pending(motorIndex)) {
         allComplete = false;
         break;
       }
@@ -299,40 +843,126 @@ void stepper_run_infinite(uint8_t motor_number, Direction direction) {
   }
 
   const uint8_t index = idx_from_motor(motor_number);
-  const float signedSpeed = (direction == Direction::CW) ? g_maxSpeed : -g_maxSpeed;
+  reset_stall_state(index);
+  runtime[index].noRamp = g_noRampMode;
+  apply_axis_profile(index, g_maxSpeed, g_acceleration);
+  if (is_stream_axis(index)) {
+    step_stream_run(stream_axis(index), direction, g_maxSpeed, stream_acceleration(index), 0);
+    return;
+  }
 
-  runtime[index].stepRunActive = false;
+  start_velocity_run(index, (direction == Direction::CW) ? g_maxSpeed : -g_maxSpeed);
   runtime[index].timedRunActive = false;
   runtime[index].infiniteRunActive = true;
-  steppers[index].setSpeed(signedSpeed);
 }
 
-void stepper_stop(uint8_t motor_number) {
+void stepper_run_velocity(uint8_t motor_number, float speed) {
   if (!is_valid_motor(motor_number)) {
     return;
   }
 
   const uint8_t index = idx_from_motor(motor_number);
-  runtime[index].stepRunActive = false;
-  runtime[index].infiniteRunActive = false;
-  runtime[index].timedRunActive = false;
-  if (g_noRampMode) {
-    steppers[index].setSpeed(0.0f);
-  } else {
-    steppers[index].stop();
+  if (stepper_get_motion_state(motor_number) != StepperMotionState::CONTINUOUS) {
+    reset_stall_state(index);
+    runtime[index].noRamp = g_noRampMode;
+    apply_axis_profile(index, g_maxSpeed, g_acceleration);
   }
+  const float limit = axis_speed_limit(index);
+  const float target = (speed > limit) ? limit : ((speed < -limit) ? -limit : speed);
+  if (is_stream_axis(index)) {
+    if (target == 0.0f) {
+      step_stream_stop(stream_axis(index), true);
+    } else {
+      step_stream_run(stream_axis(index), (target > 0.0f) ? Direction::CW : Direction::CCW, fabsf(target),
+                      stream_acceleration(index), 0);
+    }
+    return;
+  }
+
+  if (target == 0.0f && is_motor_motion_complete(index)) {
+    return;
+  }
+  start_velocity_run(index, target);
+  runtime[index].timedRunActive = false;
+  runtime[index].infiniteRunActive = true;
 }
 
-void stepper_all_stop() {
-  for (uint8_t index = 0; index < STEPPER_MOTOR_COUNT; ++index) {
-    runtime[index].stepRunActive = false;
-    runtime[index].infiniteRunActive = false;
+bool stepper_move_to(uint8_t motor_number, int32_t position) {
+  if (!is_valid_motor(motor_number)) {
+    return false;
+  }
+
+  const uint8_t index = idx_from_motor(motor_number);
+  if (is_motor_motion_complete(index)) {
+    reset_stall_state(index);
+    runtime[index].noRamp = g_noRampMode;
+    apply_axis_profile(index, g_maxSpeed, g_acceleration);
+  }
+  if (is_stream_axis(index)) {
+    step_stream_move_to(stream_axis(index), position, runtime[index].maxSpeed, stream_acceleration(index));
+    return true;
+  }
+
+  // AccelStepper counts from the last position fold.
+  const int64_t local = position - runtime[index].positionBase;
+  if (local > INT32_MAX || local < INT32_MIN) {
+    return false;
+  }
+  const int32_t target = static_cast<int32_t>(local);
+
+  if (runtime[index].noRamp) {
+    const int32_t current = steppers[index].currentPosition();
     runtime[index].timedRunActive = false;
-    if (g_noRampMode) {
-      steppers[index].setSpeed(0.0f);
-    } else {
-      steppers[index].stop();
+    runtime[index].infiniteRunActive = false;
+    runtime[index].stepRunActive = target != current;
+    if (target == current) {
+      // Also drops a stale AccelStepper target left by speed-driven motion.
+      steppers[index].setCurrentPosition(current);
+      return true;
     }
+    const float limit = axis_speed_limit(index);
+    runtime[index].stepRunDirection = (target > current) ? 1 : -1;
+    runtime[index].stepRunTarget = target;
+    steppers[index].setSpeed((target > current) ? limit : -limit);
+    return true;
+  }
+
+  if (is_velocity_run(index)) {
+    return false;  // off AccelStepper's ramp, which cannot pick up a running speed
+  }
+  // AccelStepper plans from the current speed, decelerating past the target
+  // and coming back when it is too close or behind.
+  steppers[index].moveTo(target);
+  return true;
+}
+
+void stepper_set_move_profile(uint8_t motor_number, float max_speed, float acceleration) {
+  if (!is_valid_motor(motor_number) || max_speed <= 0.0f || acceleration <= 0.0f) {
+    return;
+  }
+
+  retune_axis(idx_from_motor(motor_number), max_speed, acceleration);
+}
+
+void stepper_stop(uint8_t motor_number) {
+  if (!is_valid_motor(motor_number)) {
+    return;
+  }
+
+  const uint8_t index = idx_from_motor(motor_number);
+  if (is_stream_axis(index)) {
+    step_stream_stop(stream_axis(index), true);
+    return;
+  }
+  stop_axis(index);
+}
+
+void stepper_all_stop() {
+  for (uint8_t index = STEPPER_GPIO_AXES; index < STEPPER_MOTOR_COUNT; ++index) {
+    step_stream_stop(stream_axis(index), true);
+  }
+  for (uint8_t index = 0; index < STEPPER_GPIO_AXES; ++index) {
+    stop_axis(index);
   }
 }
 
@@ -341,13 +971,211 @@ int32_t stepper_get_position(uint8_t motor_number) {
     return 0;
   }
 
+  return static_cast<int32_t>(stepper_get_position_64(motor_number));
+}
+
+int64_t stepper_get_position_64(uint8_t motor_number) {
+  if (!is_valid_motor(motor_number)) {
+    return 0;
+  }
+
   const uint8_t index = idx_from_motor(motor_number);
-  const int32_t position = steppers[index].currentPosition();
+  if (is_stream_axis(index)) {
+    return step_stream_position(stream_axis(index));
+  }
+  return position_64(index);
+}
+
+bool stepper_set_position(uint8_t motor_number, int32_t position) {
+  if (!is_valid_motor(motor_number)) {
+    return false;
+  }
+
+  const uint8_t index = idx_from_motor(motor_number);
+  if (is_stream_axis(index)) {
+    return step_stream_set_position(stream_axis(index), position);
+  }
+  if (!is_motor_motion_complete(index)) {
+    return false;
+  }
+  steppers[index].setCurrentPosition(position);
+  runtime[index].positionBase = 0;
+  if (runtime[index].encoder != ENCODER_NONE) {
+    stall_detector_sync(stallDetectors[index], position, encoder_read(runtime[index].encoder));
+  }
+  return true;
+}
+
+float stepper_get_speed(uint8_t motor_number) {
+  if (!is_valid_motor(motor_number)) {
+    return 0.0f;
+  }
+
+  const uint8_t index = idx_from_motor(motor_number);
+  if (is_stream_axis(index)) {
+    return step_stream_speed(stream_axis(index));
+  }
+  if (is_motor_motion_complete(index)) {
+    return 0.0f;
+  }
+  return steppers[index].speed();
+}
+
+StepperMotionState stepper_get_motion_state(uint8_t motor_number) {
+  if (!is_valid_motor(motor_number)) {
+    return StepperMotionState::IDLE;
+  }
+
+  const uint8_t index = idx_from_motor(motor_number);
+  if (is_stream_axis(index)) {
+    return step_stream_state(stream_axis(index));
+  }
+  if (runtime[index].timedRunActive) {
+    return StepperMotionState::TIMED_RUN;
+  }
+  if (runtime[index].infiniteRunActive) {
+    return StepperMotionState::CONTINUOUS;
+  }
+  if (runtime[index].stepRunActive || steppers[index].distanceToGo() != 0) {
+    return StepperMotionState::POSITIONING;
+  }
+  return StepperMotionState::IDLE;
+}
+
+bool stepper_arm_trigger(uint8_t motor_number, StepperTriggerCondition condition, int32_t position,
+                         StepperTriggerCallback callback, void *arg, StepperTriggerCallback release) {
+  if (!is_valid_motor(motor_number) || is_stream_axis(idx_from_motor(motor_number)) || callback == nullptr) {
+    return false;
+  }
+
+  const uint8_t index = idx_from_motor(motor_number);
+  const int64_t current = position_64(index);
+  bool armed = false;
+
+  portENTER_CRITICAL(&g_triggerMux);
+  for (uint8_t slot = 0; slot < STEPPER_MAX_TRIGGERS && !armed; ++slot) {
+    StepperTrigger &trigger = triggers[slot];
+    if (trigger.armed) {
+      continue;
+    }
+    trigger.index = index;
+    trigger.condition = condition;
+    trigger.position = position;
+    trigger.side = (position > current) ? 1 : ((position < current) ? -1 : 0);
+    trigger.callback = callback;
+    trigger.release = release;
+    trigger.arg = arg;
+    trigger.armed = true;
+    ++g_armedTriggers;
+    armed = true;
+  }
+  portEXIT_CRITICAL(&g_triggerMux);
+
+  return armed;
+}
+
+void stepper_disarm_triggers(uint8_t motor_number) {
+  if (!is_valid_motor(motor_number)) {
+    return;
+  }
+
+  const uint8_t index = idx_from_motor(motor_number);
+  StepperTrigger dropped[STEPPER_MAX_TRIGGERS];
+  uint8_t droppedCount = 0;
+  portENTER_CRITICAL(&g_triggerMux);
+  for (uint8_t slot = 0; slot < STEPPER_MAX_TRIGGERS; ++slot) {
+    if (triggers[slot].armed && triggers[slot].index == index) {
+      triggers[slot].armed = false;
+      --g_armedTriggers;
+      dropped[droppedCount++] = triggers[slot];
+    }
+  }
+  portEXIT_CRITICAL(&g_triggerMux);
+
+  for (uint8_t i = 0; i < droppedCount; ++i) {
+    if (dropped[i].release != nullptr) {
+      dropped[i].release(dropped[i].arg);
+    }
+  }
+}
+
+void stepper_hold(uint16_t motor_mask, int32_t remaining[STEPPER_MOTOR_COUNT]) {
+  hold_axes(motor_mask & STEPPER_ALL_AXES, remaining);
+}
+
+void stepper_resume(uint16_t motor_mask, const int32_t remaining[STEPPER_MOTOR_COUNT]) {
+  resume_axes(motor_mask & STEPPER_ALL_AXES, remaining);
+}
+
+uint32_t stepper_take_max_service_gap_us() {
+  const uint32_t gap = g_maxServiceGapUs;
+  g_maxServiceGapUs = 0;
+  return gap;
+}
+
+void stepper_set_stall_callback(StepperStallCallback callback) {
+  g_stallCallback = callback;
+}
+
+bool stepper_has_encoder(uint8_t motor_number) {
+  return is_valid_motor(motor_number) && !is_stream_axis(idx_from_motor(motor_number)) &&
+         runtime[idx_from_motor(motor_number)].encoder != ENCODER_NONE;
+}
+
+int32_t stepper_get_encoder_position(uint8_t motor_number) {
+  if (!stepper_has_encoder(motor_number)) {
+    return stepper_get_position(motor_number);
+  }
 
-  return position;
+  const uint8_t index = idx_from_motor(motor_number);
+  return stall_detector_actual_position(stallDetectors[index], encoder_read(runtime[index].encoder));
+}
+
+int32_t stepper_get_following_error(uint8_t motor_number) {
+  if (!stepper_has_encoder(motor_number)) {
+    return 0;
+  }
+
+  return stallDetectors[idx_from_motor(motor_number)].following_error;
+}
+
+bool stepper_is_faulted(uint8_t motor_number) {
+  return is_valid_motor(motor_number) && runtime[idx_from_motor(motor_number)].faulted;
+}
+
+bool stepper_has_stalled_move(uint8_t motor_number) {
+  return is_valid_motor(motor_number) && runtime[idx_from_motor(motor_number)].faultRemaining != 0;
 }
 
 void stepper_enable(bool enabled) {
   // DM542 EN input is commonly active LOW. Set LOW to enable drivers, HIGH to disable.
   digitalWrite(static_cast<uint8_t>(PIN_S_M_EN), enabled ? LOW : HIGH);
 }
+
+MotionProfile stepper_get_profile() {
+  const MotionProfile profile = {g_maxSpeed, g_acceleration, g_deceleration, g_noRampMode};
+  return profile;
+}
+
+uint32_t stepper_estimate_move_us(uint8_t motor_number, int32_t steps, const MotionProfile &profile) {
+  if (!is_valid_motor(motor_number) || steps <= 0) {
+    return 0;
+  }
+
+  return motion_profile_engine_us(profile, static_cast<uint32_t>(steps));
+}
+
+uint32_t stepper_estimate_batch_us(const StepperMove *moves, uint8_t move_count, const MotionProfile &profile) {
+  if (moves == nullptr) {
+    return 0;
+  }
+
+  uint32_t longest = 0;
+  for (uint8_t moveIndex = 0; moveIndex < move_count; ++moveIndex) {
+    const uint32_t duration = stepper_estimate_move_us(moves[moveIndex].motor_number, moves[moveIndex].steps, profile);
+    if (duration > longest) {
+      longest = duration;
+    }
+  }
+  return longest;
+}
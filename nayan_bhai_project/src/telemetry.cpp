@@ -0,0 +1,177 @@
+#include "telemetry.h"
+
+#include <esp_timer.h>
+
+#include "crc16.h"
+#include "motion_snapshot.h"
+
+namespace {
+static_assert(STEPPER_MOTOR_COUNT >= TELEMETRY_STEPPER_COUNT, "telemetry frames carry the first three steppers");
+
+// frames[g_fillIndex] is written by the sampler only; a frame marked ready is
+// owned by the writer task until it clears the flag.
+TelemetryFrame frames[2];
+volatile uint8_t g_fillIndex = 0;
+volatile bool g_frameReady[2] = {false, false};
+
+uint32_t g_sequence = 0;
+uint16_t g_rateHz = 0;
+volatile uint32_t g_droppedFrames = 0;
+
+esp_timer_handle_t g_timer = nullptr;
+TaskHandle_t g_writerTask = nullptr;
+
+int16_t saturate_speed(float speed) {
+  if (speed > 32767.0f) {
+    return 32767;
+  }
+  if (speed < -32768.0f) {
+    return -32768;
+  }
+  return static_cast<int16_t>(speed);
+}
+
+void reset_frame(TelemetryFrame &frame) {
+  frame.header.magic = TELEMETRY_FRAME_MAGIC;
+  frame.header.version = TELEMETRY_FRAME_VERSION;
+  frame.header.sample_count = 0;
+  frame.header.rate_hz = g_rateHz;
+}
+
+// Reads the published snapshot instead of the motion globals, which the loop()
+// task may be halfway through updating when this timer fires.
+void fill_sample(TelemetrySample &sample) {
+  MotionSnapshot snapshot;
+  if (!motion_snapshot_read(snapshot)) {
+    memset(&sample, 0, sizeof(sample));
+    sample.timestamp_us = static_cast<uint32_t>(esp_timer_get_time());
+    return;
+  }
+
+  sample.timestamp_us = snapshot.timestamp_us;
+
+  sample.stepper_states = 0;
+  for (uint8_t index = 0; index < TELEMETRY_STEPPER_COUNT; ++index) {
+    sample.position[index] = snapshot.position[index];
+    sample.speed[index] = saturate_speed(snapshot.speed[index]);
+    sample.stepper_states |= static_cast<uint8_t>(snapshot.state[index]) << (index * TELEMETRY_STEPPER_STATE_BITS);
+  }
+
+  sample.output_flags = 0;
+  for (uint8_t index = 0; index < TELEMETRY_DC_COUNT; ++index) {
+    const DcStatus &status = snapshot.dc[index];
+    sample.dc_duty[index] = status.duty;
+    sample.dc_current_ma[index] = (status.current_ma < 65535.0f) ? static_cast<uint16_t>(status.current_ma) : 65535;
+    if (status.direction == Direction::CCW) {
+      sample.output_flags |= 1 << (TELEMETRY_FLAG_DC_CCW_SHIFT + index);
+    }
+    if (status.enabled) {
+      sample.output_flags |= 1 << (TELEMETRY_FLAG_DC_EN_SHIFT + index);
+    }
+  }
+  if (snapshot.solenoid == SolenoidState::ON) {
+    sample.output_flags |= TELEMETRY_FLAG_RELAY;
+  }
+  if (snapshot.paused) {
+    sample.output_flags |= TELEMETRY_FLAG_PAUSED;
+  }
+}
+
+// Hands the fill frame to the writer and switches to the other buffer.
+// If the writer still owns the other buffer the samples are discarded instead.
+void publish_fill_frame() {
+  TelemetryFrame &frame = frames[g_fillIndex];
+  const uint8_t next = g_fillIndex ^ 1;
+
+  if (g_frameReady[next]) {
+    ++g_droppedFrames;
+    reset_frame(frame);
+    return;
+  }
+
+  frame.header.sequence = g_sequence++;
+  frame.header.dropped_frames = (g_droppedFrames > 0xFFFF) ? 0xFFFF : static_cast<uint16_t>(g_droppedFrames);
+  frame.crc = crc16_ccitt(reinterpret_cast<const uint8_t *>(&frame), sizeof(frame) - sizeof(frame.crc));
+
+  g_frameReady[g_fillIndex] = true;
+  g_fillIndex = next;
+  reset_frame(frames[next]);
+
+  xTaskNotifyGive(g_writerTask);
+}
+
+void sample_callback(void *arg) {
+  (void)arg;
+
+  TelemetryFrame &frame = frames[g_fillIndex];
+  fill_sample(frame.samples[frame.header.sample_count]);
+
+  if (++frame.header.sample_count >= TELEMETRY_SAMPLES_PER_FRAME) {
+    publish_fill_frame();
+  }
+}
+
+void telemetry_writer_task(void *parameter) {
+  (void)parameter;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    for (uint8_t i = 0; i < 2; ++i) {
+      if (g_frameReady[i]) {
+        Serial.write(reinterpret_cast<const uint8_t *>(&frames[i]), sizeof(frames[i]));
+        g_frameReady[i] = false;
+      }
+    }
+  }
+}
+}  // namespace
+
+bool telemetry_start(uint16_t rate_hz) {
+  if (rate_hz == 0 || rate_hz > TELEMETRY_MAX_RATE_HZ) {
+    return false;
+  }
+
+  telemetry_stop();
+
+  if (g_writerTask == nullptr) {
+    xTaskCreatePinnedToCore(telemetry_writer_task, "telemetry_tx", 3072, nullptr, 1, &g_writerTask, 0);
+  }
+
+  if (g_timer == nullptr) {
+    esp_timer_create_args_t args = {};
+    args.callback = sample_callback;
+    args.name = "telemetry";
+    if (esp_timer_create(&args, &g_timer) != ESP_OK) {
+      g_timer = nullptr;
+      return false;
+    }
+  }
+
+  g_rateHz = rate_hz;
+  g_sequence = 0;
+  g_droppedFrames = 0;
+  reset_frame(frames[g_fillIndex]);
+
+  return esp_timer_start_periodic(g_timer, 1000000ULL / rate_hz) == ESP_OK;
+}
+
+void telemetry_stop() {
+  if (g_timer == nullptr || g_rateHz == 0) {
+    return;
+  }
+
+  esp_timer_stop(g_timer);
+  if (frames[g_fillIndex].header.sample_count > 0) {
+    publish_fill_frame();
+  }
+  g_rateHz = 0;
+}
+
+bool telemetry_is_running() {
+  return g_rateHz != 0;
+}
+
+uint32_t telemetry_dropped_frames() {
+  return g_droppedFrames;
+}
@@ -0,0 +1,116 @@
+#include "trace.h"
+
+#include <esp_timer.h>
+
+#include "defines.h"
+
+namespace {
+static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0, "TRACE_RING_EVENTS must be a power of two");
+
+struct TraceRecord {
+  int64_t timeUs;  // esp_timer_get_time(); the cycle counter wraps every ~18 s at 240 MHz
+  int32_t arg;
+  char phase;
+  uint8_t event;
+  uint8_t track;
+  uint8_t reserved;
+};
+
+struct TraceRing {
+  uint32_t head;  // total events claimed since trace_start()
+  TraceRecord records[TRACE_RING_EVENTS];
+};
+
+const char *const kEventNames[] = {
+  "loop_cycle", "stepper_move", "dc_run", "solenoid_on", "button", "pause", "resume", "stall", "led_show",
+};
+static_assert(sizeof(kEventNames) / sizeof(kEventNames[0]) == static_cast<size_t>(TraceEvent::COUNT),
+              "kEventNames out of sync with TraceEvent");
+
+const char *const kTrackNames[] = {
+  "core", "stepper_1", "stepper_2", "stepper_3", "dc_3000", "dc1_300", "dc2_300", "solenoid",
+};
+static_assert(sizeof(kTrackNames) / sizeof(kTrackNames[0]) == static_cast<size_t>(TraceTrack::COUNT),
+              "kTrackNames out of sync with TraceTrack");
+
+TraceRing g_rings[portNUM_PROCESSORS];
+volatile bool g_running = false;
+
+void IRAM_ATTR record(char phase, TraceEvent event, TraceTrack track, int32_t arg) {
+  if (!g_running) {
+    return;
+  }
+
+  TraceRing &ring = g_rings[xPortGetCoreID()];
+  const uint32_t slot = __atomic_fetch_add(&ring.head, 1, __ATOMIC_RELAXED) & (TRACE_RING_EVENTS - 1);
+  TraceRecord &entry = ring.records[slot];
+  entry.timeUs = esp_timer_get_time();
+  entry.arg = arg;
+  entry.phase = phase;
+  entry.event = static_cast<uint8_t>(event);
+  entry.track = static_cast<uint8_t>(track);
+}
+
+void dump_ring(Print &out, uint8_t core) {
+  const TraceRing &ring = g_rings[core];
+  const uint32_t head = ring.head;
+  const uint32_t count = (head < TRACE_RING_EVENTS) ? head : TRACE_RING_EVENTS;
+
+  out.printf("# core %u events %lu lost %lu\n", core, static_cast<unsigned long>(count),
+             static_cast<unsigned long>(head - count));
+
+  for (uint32_t i = head - count; i != head; ++i) {
+    const TraceRecord &entry = ring.records[i & (TRACE_RING_EVENTS - 1)];
+    out.printf("%u %lld %c %u %u %ld\n", core, static_cast<long long>(entry.timeUs), entry.phase, entry.event,
+               entry.track, static_cast<long>(entry.arg));
+  }
+}
+}  // namespace
+
+void trace_start() {
+  g_running = false;
+  for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core) {
+    g_rings[core].head = 0;
+  }
+  g_running = true;
+}
+
+void trace_stop() {
+  g_running = false;
+}
+
+bool trace_is_running() {
+  return g_running;
+}
+
+void IRAM_ATTR trace_begin(TraceEvent event, TraceTrack track, int32_t arg) {
+  record('B', event, track, arg);
+}
+
+void IRAM_ATTR trace_end(TraceEvent event, TraceTrack track, int32_t arg) {
+  record('E', event, track, arg);
+}
+
+void IRAM_ATTR trace_instant(TraceEvent event, TraceTrack track, int32_t arg) {
+  record('i', event, track, arg);
+}
+
+void trace_dump(Print &out) {
+  const bool wasRunning = g_running;
+  g_running = false;
+  delay(1);  // let a preempted record() finish its store
+
+  out.println("# trace v2");
+  for (uint8_t i = 0; i < static_cast<uint8_t>(TraceEvent::COUNT); ++i) {
+    out.printf("# event %u %s\n", i, kEventNames[i]);
+  }
+  for (uint8_t i = 0; i < static_cast<uint8_t>(TraceTrack::COUNT); ++i) {
+    out.printf("# track %u %s\n", i, kTrackNames[i]);
+  }
+  for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core) {
+    dump_ring(out, core);
+  }
+  out.println("# end");
+
+  g_running = wasRunning;
+}
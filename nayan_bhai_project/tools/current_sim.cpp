@@ -0,0 +1,144 @@
+// Feeds simulated BTS7960 current traces through the DC current monitor
+// (src/current_monitor.cpp) and checks which faults it raises and how fast.
+//
+// Usage: current_sim [--jam-ma <mA>] [--overcurrent-ma <mA>] [--jam-ms <ms>] [--block-us <us>]
+//
+// Defaults are the DC_300_* limits of defines.h and the block period of three
+// sensed motors (DC_CURRENT_BLOCK_SAMPLES conversions of 20 kHz shared three
+// ways). Each block averages noisy samples of a current that follows the
+// scenario's load with the motor's electrical time constant. Exits non-zero
+// if a scenario raises the wrong fault or trips later than its deadline.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "current_monitor.h"
+
+namespace {
+
+constexpr float RUN_MA = 1500.0f;       // steady running current
+constexpr float INRUSH_MA = 9000.0f;    // stalled-rotor current at start, decays as the motor spins up
+constexpr float INRUSH_TAU_MS = 60.0f;
+constexpr float STALL_MA = 9000.0f;     // a jammed motor draws its stall current
+constexpr float SHORT_MA = 30000.0f;
+constexpr float ELECTRICAL_TAU_MS = 2.0f;
+constexpr float RIPPLE = 0.15f;         // PWM ripple seen by single conversions, fraction of the current
+constexpr uint16_t SAMPLES_PER_BLOCK = 20;
+constexpr uint32_t RUN_MS = 1500;
+
+struct Options {
+  CurrentMonitorConfig config = {30.0f, 12000.0f, 5000.0f, 100, 250};
+  uint32_t block_us = 9000;
+};
+
+struct Scenario {
+  const char *name;
+  CurrentFault expected;
+  uint32_t event_ms;      // when the load changes
+  uint32_t event_len_ms;  // 0 = until the end
+  float event_ma;
+  uint32_t deadline_ms;   // latest acceptable trip after event_ms (expected != NONE)
+};
+
+Options g_options;
+
+float load_ma(const Scenario &scenario, float t_ms) {
+  float load = RUN_MA + (INRUSH_MA - RUN_MA) * expf(-t_ms / INRUSH_TAU_MS);
+  const bool inEvent = scenario.event_ma > 0.0f && t_ms >= scenario.event_ms &&
+                       (scenario.event_len_ms == 0 || t_ms < scenario.event_ms + scenario.event_len_ms);
+  if (inEvent) {
+    load = scenario.event_ma;
+  }
+  return load;
+}
+
+float noise() {
+  return static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 2.0f - 1.0f;
+}
+
+// Returns the fault raised, and when, in *trip_ms.
+CurrentFault run_scenario(const Scenario &scenario, uint32_t *trip_ms) {
+  CurrentMonitor monitor;
+  current_monitor_init(monitor, g_options.config);
+  current_monitor_start(monitor);
+
+  const float sample_ms = g_options.block_us / 1000.0f / SAMPLES_PER_BLOCK;
+  float current = 0.0f;
+  float t_ms = 0.0f;
+  while (t_ms < RUN_MS) {
+    float sum = 0.0f;
+    for (uint16_t i = 0; i < SAMPLES_PER_BLOCK; ++i) {
+      current += (load_ma(scenario, t_ms) - current) * (1.0f - expf(-sample_ms / ELECTRICAL_TAU_MS));
+      sum += current * (1.0f + RIPPLE * noise());
+      t_ms += sample_ms;
+    }
+    const CurrentFault fault = current_monitor_update(monitor, sum / SAMPLES_PER_BLOCK, g_options.block_us);
+    if (fault != CurrentFault::NONE) {
+      *trip_ms = static_cast<uint32_t>(t_ms);
+      return fault;
+    }
+  }
+  return CurrentFault::NONE;
+}
+
+bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (strcmp(argv[i], "--jam-ma") == 0) {
+      g_options.config.jam_ma = static_cast<float>(atof(argv[++i]));
+    } else if (strcmp(argv[i], "--overcurrent-ma") == 0) {
+      g_options.config.overcurrent_ma = static_cast<float>(atof(argv[++i]));
+    } else if (strcmp(argv[i], "--jam-ms") == 0) {
+      g_options.config.jam_ms = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--block-us") == 0) {
+      g_options.block_us = static_cast<uint32_t>(atoi(argv[++i]));
+    } else {
+      return false;
+    }
+  }
+  return g_options.block_us > 0;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    fprintf(stderr, "usage: current_sim [--jam-ma <mA>] [--overcurrent-ma <mA>] [--jam-ms <ms>] [--block-us <us>]\n");
+    return 2;
+  }
+
+  // Deadlines: a short must go within two blocks; a jam within jam_ms plus
+  // the filter's rise to the limit and two blocks.
+  const uint32_t blocks2 = 2 * g_options.block_us / 1000 + 1;
+  const uint32_t jamDeadline = g_options.config.jam_ms + 50 + blocks2;
+  const Scenario scenarios[] = {
+    {"normal run with inrush", CurrentFault::NONE, 0, 0, 0.0f, 0},
+    {"load peak shorter than jam_ms", CurrentFault::NONE, 600, g_options.config.jam_ms / 2, 7000.0f, 0},
+    {"jam after 500 ms", CurrentFault::JAM, 500, 0, STALL_MA, jamDeadline},
+    {"jammed from the start", CurrentFault::JAM, 0, 0, STALL_MA, g_options.config.inrush_ms + jamDeadline},
+    {"short after 300 ms", CurrentFault::OVERCURRENT, 300, 0, SHORT_MA, blocks2},
+  };
+
+  srand(1);
+  bool ok = true;
+  for (const Scenario &scenario : scenarios) {
+    uint32_t tripMs = 0;
+    const CurrentFault fault = run_scenario(scenario, &tripMs);
+    bool pass = fault == scenario.expected;
+    if (fault != CurrentFault::NONE) {
+      const uint32_t latency = tripMs - scenario.event_ms;
+      pass = pass && latency <= scenario.deadline_ms;
+      printf("%-32s %-11s after %4u ms (deadline %u ms) %s\n", scenario.name, current_fault_name(fault), latency,
+             scenario.deadline_ms, pass ? "ok" : "FAIL");
+    } else {
+      printf("%-32s %-11s %s\n", scenario.name, "no fault", pass ? "ok" : "FAIL");
+    }
+    ok = ok && pass;
+  }
+
+  puts(ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
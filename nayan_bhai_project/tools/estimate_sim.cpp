@@ -0,0 +1,141 @@
+// Checks the stepper move-duration estimate (motion_profile_engine_us() in
+// src/motion_profile.cpp) against a step loop that replays AccelStepper's
+// computeNewSpeed() and runSpeed() timing.
+//
+// Usage: estimate_sim [--tolerance <percent>] [--min-steps <steps>]
+//
+// Sweeps the loop() settings and a spread of other profiles over move lengths
+// from --min-steps up, triangle and trapezoid alike, and the no-ramp mode. Exits
+// non-zero if any estimate is further off than the tolerance (default 0.6%).
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "motion_profile.h"
+
+namespace {
+
+struct Options {
+  double tolerance_pct = 0.6;
+  uint32_t min_steps = 100;
+};
+
+Options g_options;
+
+// AccelStepper 1.6x moveTo() + run() from rest, polled without delay: returns
+// the time from the first step to the last, in microseconds.
+uint64_t engine_move_us(const MotionProfile &profile, uint32_t steps) {
+  if (steps == 0) {
+    return 0;
+  }
+  if (profile.no_ramp) {
+    // setSpeed() + runSpeed(): one fixed interval per step after the first.
+    const unsigned long interval = static_cast<unsigned long>(fabs(1000000.0 / profile.max_speed));
+    return static_cast<uint64_t>(interval) * (steps - 1);
+  }
+
+  const double acceleration = profile.acceleration;
+  const double c0 = 0.676 * sqrt(2.0 / acceleration) * 1000000.0;
+  const double cmin = 1000000.0 / profile.max_speed;
+  // moveTo() already ran computeNewSpeed() once: n = 1, interval c0.
+  double cn = c0;
+  double speed = 1000000.0 / c0;
+  long n = 1;
+  long position = 0;
+  const long target = static_cast<long>(steps);
+  uint64_t now = 0;
+
+  for (;;) {
+    // runSpeed() steps, then computeNewSpeed() picks the next interval.
+    ++position;
+    const long distanceTo = target - position;
+    const long stepsToStop = static_cast<long>((speed * speed) / (2.0 * acceleration));
+    if (distanceTo == 0 && stepsToStop <= 1) {
+      return now;
+    }
+    if (distanceTo > 0) {
+      if (n > 0 && stepsToStop >= distanceTo) {
+        n = -stepsToStop;
+      } else if (n < 0 && stepsToStop < distanceTo) {
+        n = -n;
+      }
+    } else if (n > 0) {
+      // Overshot; AccelStepper turns around, which a planned move never needs.
+      n = -stepsToStop;
+    }
+    if (n == 0) {
+      cn = c0;
+    } else {
+      cn = cn - (2.0 * cn) / (4.0 * n + 1);
+      cn = cn > cmin ? cn : cmin;
+    }
+    ++n;
+    speed = 1000000.0 / cn;
+    now += static_cast<unsigned long>(cn);
+    if (distanceTo <= 0) {
+      return now;
+    }
+  }
+}
+
+bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (strcmp(argv[i], "--tolerance") == 0) {
+      g_options.tolerance_pct = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--min-steps") == 0) {
+      g_options.min_steps = static_cast<uint32_t>(atoi(argv[++i]));
+    } else {
+      return false;
+    }
+  }
+  return g_options.tolerance_pct > 0.0 && g_options.min_steps > 1;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    fprintf(stderr, "usage: estimate_sim [--tolerance <percent>] [--min-steps <steps>]\n");
+    return 2;
+  }
+
+  // {max_speed, acceleration, deceleration, no_ramp}; the first is loop()'s.
+  const MotionProfile profiles[] = {
+    {12000.0f, 8000.0f, 8000.0f, false},
+    {12000.0f, 8000.0f, 4000.0f, false},
+    {2000.0f, 1000.0f, 1000.0f, false},
+    {6000.0f, 30000.0f, 30000.0f, false},
+    {800.0f, 400.0f, 400.0f, false},
+    {12000.0f, 8000.0f, 8000.0f, true},
+  };
+  const uint32_t lengths[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 20000, 50000};
+
+  bool ok = true;
+  for (const MotionProfile &profile : profiles) {
+    double worst = 0.0;
+    uint32_t worstSteps = 0;
+    for (const uint32_t steps : lengths) {
+      if (steps < g_options.min_steps) {
+        continue;
+      }
+      const double engine = static_cast<double>(engine_move_us(profile, steps));
+      const double estimate = static_cast<double>(motion_profile_engine_us(profile, steps));
+      const double error = engine > 0.0 ? 100.0 * (estimate - engine) / engine : 0.0;
+      if (fabs(error) > fabs(worst)) {
+        worst = error;
+        worstSteps = steps;
+      }
+    }
+    const bool pass = fabs(worst) <= g_options.tolerance_pct;
+    printf("v %6.0f a %6.0f%s worst %+6.3f%% at %5u steps %s\n", profile.max_speed, profile.acceleration,
+           profile.no_ramp ? " no-ramp" : "        ", worst, worstSteps, pass ? "ok" : "FAIL");
+    ok = ok && pass;
+  }
+
+  puts(ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,331 @@
+// Runs two station link nodes (src/link_protocol.cpp) against each other over a
+// Linux pty pair and checks time sync, a remotely scheduled batch, a barrier and
+// the rejection of a batch with an item kind the peer does not know.
+//
+// Usage: link_sim [--seconds <s>] [--drop <n>] [--skew <ppm>] [--baud <bps>]
+//
+// The master's clock is the host's monotonic clock; the follower's runs from an
+// arbitrary offset and `--skew` ppm fast, like a second board that booted
+// earlier on a different crystal. A pty has no airtime; with `--baud` a write
+// holds its frame back for the time the bytes would take on the wire, as a
+// UART would deliver it, and the nodes back that out of their receive stamps.
+// `--drop n` loses every n-th frame to exercise resends. Without `--skew` or
+// `--baud` it runs the CASES below in turn. Exits non-zero if the skew misses
+// the injected one by SKEW_LIMIT_PPM, or the sync error after convergence or
+// the start error of the scheduled batch reaches LIMIT_US.
+
+#define _XOPEN_SOURCE 600
+
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "link_protocol.h"
+
+namespace {
+
+constexpr int64_t LIMIT_US = 100;
+constexpr double SKEW_LIMIT_PPM = 10.0;                  // pty wake-up jitter over a 5 s fit; the target fits over 26 s
+constexpr uint64_t FOLLOWER_OFFSET_US = 3600000000ULL;  // booted an hour earlier
+constexpr uint64_t SETTLE_US = 3000000;                  // sync error counts from here
+constexpr uint64_t BATCH_LEAD_US = 50000;
+constexpr uint64_t BATCH_RUN_US = 30000;                 // simulated run time on the follower
+constexpr uint64_t BARRIER_DELAY_US = 20000;             // follower reaches the barrier this much later
+constexpr uint8_t STEPPER_MOTORS = 3;
+
+struct Station {
+  const char *name;
+  int fd;
+  LinkNode node;
+  uint32_t written;
+  uint32_t dropped;
+};
+
+struct Case {
+  double skew_ppm;
+  uint32_t baud;
+};
+
+const Case CASES[] = {{50.0, 0}, {0.0, 0}, {-50.0, 921600}};  // the last at LINK_BAUD
+
+struct Options {
+  double seconds = 6.0;
+  uint32_t drop = 0;
+  bool single = false;  // --skew or --baud given: run only that case
+  Case only = {50.0, 0};
+};
+
+Options g_options;
+Case g_case;
+uint64_t g_start = 0;
+
+uint64_t true_us() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
+uint64_t master_local(uint64_t truth) {
+  return truth;
+}
+
+uint64_t follower_local(uint64_t truth) {
+  const double elapsed = static_cast<double>(truth - g_start);
+  return FOLLOWER_OFFSET_US + truth + static_cast<uint64_t>(elapsed * g_case.skew_ppm * 1e-6);
+}
+
+uint64_t local_time(const Station &station, uint64_t truth) {
+  return station.node.config.clock_master ? master_local(truth) : follower_local(truth);
+}
+
+void write_fd(const uint8_t *data, size_t length, void *context) {
+  Station &station = *static_cast<Station *>(context);
+  ++station.written;
+  if (g_options.drop > 0 && station.written % g_options.drop == 0) {
+    ++station.dropped;
+    return;
+  }
+  if (g_case.baud > 0) {
+    const uint64_t sent = true_us() + static_cast<uint64_t>(length) * 10000000ULL / g_case.baud;
+    while (true_us() < sent) {
+    }
+  }
+  while (length > 0) {
+    const ssize_t count = write(station.fd, data, length);
+    if (count <= 0) {
+      perror("write");
+      exit(2);
+    }
+    data += count;
+    length -= static_cast<size_t>(count);
+  }
+}
+
+bool open_pty_pair(int &master, int &slave) {
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    return false;
+  }
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0) {
+    return false;
+  }
+  // Raw on both ends: no echo, no line discipline touching the bytes.
+  const int fds[] = {master, slave};
+  for (int fd : fds) {
+    termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  return true;
+}
+
+void init_station(Station &station, const char *name, int fd, bool clock_master) {
+  station.name = name;
+  station.fd = fd;
+  station.written = 0;
+  station.dropped = 0;
+  // Faster requests than on target so the skew converges within a short run.
+  const LinkConfig config = {clock_master, g_case.baud, 20000, 20000, STEPPER_MOTORS, write_fd, &station};
+  link_init(station.node, config);
+}
+
+// Waits for input on either end for at most timeout_us, then feeds it in
+// stamped with each station's local time at wake-up.
+void pump(Station *stations, uint64_t timeout_us) {
+  pollfd fds[2] = {{stations[0].fd, POLLIN, 0}, {stations[1].fd, POLLIN, 0}};
+  const timespec timeout = {static_cast<time_t>(timeout_us / 1000000), static_cast<long>(timeout_us % 1000000) * 1000};
+  if (ppoll(fds, 2, &timeout, nullptr) < 0) {
+    perror("ppoll");
+    exit(2);
+  }
+  const uint64_t truth = true_us();
+  for (int i = 0; i < 2; ++i) {
+    if ((fds[i].revents & POLLIN) == 0) {
+      continue;
+    }
+    uint8_t buffer[512];
+    const ssize_t count = read(stations[i].fd, buffer, sizeof(buffer));
+    if (count > 0) {
+      link_receive(stations[i].node, buffer, static_cast<size_t>(count), local_time(stations[i], truth));
+    }
+  }
+  for (int i = 0; i < 2; ++i) {
+    link_service(stations[i].node, local_time(stations[i], true_us()));
+  }
+}
+
+int64_t sync_error_us(const Station &follower) {
+  const uint64_t truth = true_us();
+  return static_cast<int64_t>(link_shared_time(follower.node, follower_local(truth)) - master_local(truth));
+}
+
+bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (strcmp(argv[i], "--seconds") == 0) {
+      g_options.seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--drop") == 0) {
+      g_options.drop = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--skew") == 0) {
+      g_options.only.skew_ppm = atof(argv[++i]);
+      g_options.single = true;
+    } else if (strcmp(argv[i], "--baud") == 0) {
+      g_options.only.baud = static_cast<uint32_t>(atoi(argv[++i]));
+      g_options.single = true;
+    } else {
+      return false;
+    }
+  }
+  return g_options.seconds * 1e6 > SETTLE_US + 1000000;
+}
+
+// Runs one case on a fresh pty pair and prints its results.
+bool run_case(const Case &run) {
+  g_case = run;
+  printf("skew %.1f ppm, baud %u\n", run.skew_ppm, run.baud);
+  int masterFd = -1;
+  int slaveFd = -1;
+  if (!open_pty_pair(masterFd, slaveFd)) {
+    perror("pty");
+    exit(2);
+  }
+
+  g_start = true_us();
+  Station stations[2];
+  init_station(stations[0], "master", masterFd, true);
+  init_station(stations[1], "follower", slaveFd, false);
+  Station &master = stations[0];
+  Station &follower = stations[1];
+
+  // Phase 1: converge, then track the sync error for the rest of the run.
+  const uint64_t end = g_start + static_cast<uint64_t>(g_options.seconds * 1e6);
+  int64_t worstSync = 0;
+  uint32_t samples = 0;
+  while (true_us() < end) {
+    pump(stations, 1000);
+    if (true_us() - g_start >= SETTLE_US && link_is_synced(follower.node)) {
+      const int64_t error = llabs(sync_error_us(follower));
+      worstSync = (error > worstSync) ? error : worstSync;
+      ++samples;
+    }
+  }
+
+  // Phase 2: the master schedules a batch on the follower; the follower starts
+  // it by its own clock and both compare against true time.
+  LinkBatchItem item = {};
+  item.kind = LINK_ITEM_STEPPER;
+  item.motor = 1;
+  item.amount = 1000;
+  const uint64_t startShared = link_shared_time(master.node, master_local(true_us())) + BATCH_LEAD_US;
+  const uint16_t id = link_send_batch(master.node, startShared, &item, 1, master_local(true_us()));
+
+  int64_t startError = -1;
+  uint64_t runEnd = 0;
+  const uint64_t deadline = true_us() + 1000000;
+  while (!link_batch_done(master.node, id) && !link_batch_failed(master.node, id) && true_us() < deadline) {
+    const LinkBatch *batch = link_peek_batch(follower.node);
+    if (batch == nullptr || runEnd != 0) {
+      pump(stations, 1000);
+      if (runEnd != 0 && true_us() >= runEnd) {
+        link_complete_batch(follower.node);
+        runEnd = 0;
+      }
+      continue;
+    }
+    const uint64_t startLocal = link_local_time(follower.node, batch->start_us);
+    const uint64_t now = follower_local(true_us());
+    if (now + 2000 < startLocal) {
+      pump(stations, startLocal - now - 2000);
+      continue;
+    }
+    while (follower_local(true_us()) < startLocal) {
+    }
+    const uint64_t truth = true_us();
+    startError = llabs(static_cast<int64_t>(truth - startShared));
+    runEnd = truth + BATCH_RUN_US;
+  }
+  const bool batchDone = link_batch_done(master.node, id);
+
+  // Phase 3: barrier 1, reached by the follower BARRIER_DELAY_US after the master.
+  const uint64_t masterArrive = true_us();
+  link_barrier_arrive(master.node, 1, master_local(masterArrive));
+  uint64_t followerArrive = 0;
+  uint64_t masterPassed = 0;
+  const uint64_t barrierDeadline = masterArrive + 1000000;
+  while ((masterPassed == 0 || !link_barrier_passed(follower.node, 1)) && true_us() < barrierDeadline) {
+    pump(stations, 1000);
+    if (followerArrive == 0 && true_us() - masterArrive >= BARRIER_DELAY_US) {
+      followerArrive = true_us();
+      link_barrier_arrive(follower.node, 1, follower_local(followerArrive));
+    }
+    if (masterPassed == 0 && link_barrier_passed(master.node, 1)) {
+      masterPassed = true_us();
+    }
+  }
+  const bool barrierOk = masterPassed != 0 && followerArrive != 0 && masterPassed >= followerArrive &&
+                         link_barrier_passed(follower.node, 1);
+
+  // Phase 4: a batch with an item kind the follower does not know is rejected, not queued.
+  LinkBatchItem unknown = item;
+  unknown.kind = LINK_ITEM_SOLENOID + 1;
+  const uint16_t badId = link_send_batch(master.node, startShared, &unknown, 1, master_local(true_us()));
+  const uint64_t rejectDeadline = true_us() + 1000000;
+  while (!link_batch_failed(master.node, badId) && true_us() < rejectDeadline) {
+    pump(stations, 1000);
+  }
+  const bool rejected = link_batch_failed(master.node, badId) && link_peek_batch(follower.node) == nullptr;
+
+  // The follower runs fast, so master - follower shrinks by skew_ppm.
+  const double skewError = fabs(follower.node.skew * 1e6 + run.skew_ppm);
+  printf("sync: offset %lld us, skew %.2f ppm (expected %.2f), error bound %u us, %u updates\n",
+         static_cast<long long>(follower.node.offset_us), follower.node.skew * 1e6, -run.skew_ppm,
+         follower.node.error_bound_us, follower.node.stats.sync_updates);
+  printf("sync error after %.1f s: worst %lld us over %u samples\n", SETTLE_US / 1e6,
+         static_cast<long long>(worstSync), samples);
+  printf("batch %u: %s, start error %lld us\n", id, batchDone ? "done" : "not done",
+         static_cast<long long>(startError));
+  printf("barrier: %s, master waited %lld us\n", barrierOk ? "passed" : "failed",
+         static_cast<long long>(masterPassed - masterArrive));
+  printf("batch %u with an unknown item kind: %s\n", badId, rejected ? "rejected" : "not rejected");
+  for (const Station &station : stations) {
+    printf("%s: %u frames, %u crc errors, %u resends, %u of %u writes dropped\n", station.name,
+           station.node.stats.frames, station.node.stats.crc_errors, station.node.stats.resends, station.dropped,
+           station.written);
+  }
+
+  const bool ok = samples > 0 && skewError < SKEW_LIMIT_PPM && worstSync < LIMIT_US && batchDone && startError >= 0 &&
+                  startError < LIMIT_US && barrierOk && rejected;
+  puts(ok ? "ok" : "FAIL");
+  close(slaveFd);
+  close(masterFd);
+  return ok;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    fprintf(stderr, "usage: link_sim [--seconds <s> (over 4)] [--drop <n>] [--skew <ppm>] [--baud <bps>]\n");
+    return 2;
+  }
+
+  bool ok = true;
+  if (g_options.single) {
+    ok = run_case(g_options.only);
+  } else {
+    for (const Case &run : CASES) {
+      ok = run_case(run) && ok;
+    }
+  }
+  puts(ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
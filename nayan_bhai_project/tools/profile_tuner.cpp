@@ -0,0 +1,336 @@
+// Searches per-move stepper speed/acceleration that minimize cycle time
+// within per-axis limits, and writes them as a profile table for
+// stepper_set_profile_table().
+//
+// Usage: profile_tuner <file.seq> <axes.cfg> [-o stepper_profile_table.h]
+//
+// Every stepper move in the sequence is tuned on its own: a move's duration
+// only depends on its own profile and every schedule of the sequence gets
+// shorter when any move does, so the per-move optimum is also the cycle
+// optimum. For each candidate max speed the move gets the highest
+// acceleration the axis allows up to that speed (torque curve and jerk cap,
+// see machine_axes.cfg); durations come from the same AccelStepper model the
+// sequence analyzer uses.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sequence_model.h"
+
+namespace {
+
+struct TorquePoint {
+  float speed;
+  float fraction;
+};
+
+struct AxisLimits {
+  bool present = false;
+  float max_speed = 0.0f;
+  float max_accel = 0.0f;
+  float jerk = 0.0f;  // 0 = no jerk cap
+  std::vector<TorquePoint> torque;
+};
+
+struct TunedMove {
+  uint8_t motor;
+  uint32_t steps;
+  float max_speed;
+  float acceleration;
+  uint32_t tuned_us;
+  uint32_t config_us;
+  std::vector<std::string> tasks;
+};
+
+double ms(uint64_t us) {
+  return static_cast<double>(us) / 1000.0;
+}
+
+float torque_fraction(const AxisLimits &axis, float speed) {
+  if (axis.torque.empty()) {
+    return 1.0f;
+  }
+  if (speed <= axis.torque.front().speed) {
+    return axis.torque.front().fraction;
+  }
+  for (size_t i = 1; i < axis.torque.size(); ++i) {
+    const TorquePoint &low = axis.torque[i - 1];
+    const TorquePoint &high = axis.torque[i];
+    if (speed <= high.speed) {
+      const float t = (speed - low.speed) / (high.speed - low.speed);
+      return low.fraction + t * (high.fraction - low.fraction);
+    }
+  }
+  return axis.torque.back().fraction;
+}
+
+// A ramp to peak passes through every lower speed, so the weakest point on
+// [0, peak] bounds its acceleration.
+float acceleration_limit(const AxisLimits &axis, float peak) {
+  float fraction = torque_fraction(axis, peak);
+  for (const TorquePoint &point : axis.torque) {
+    if (point.speed < peak) {
+      fraction = std::min(fraction, point.fraction);
+    }
+  }
+  float limit = axis.max_accel * fraction;
+  if (axis.jerk > 0.0f) {
+    limit = std::min(limit, sqrtf(axis.jerk * peak));
+  }
+  return limit;
+}
+
+uint32_t move_us(float maxSpeed, float acceleration, uint32_t steps) {
+  const MotionProfile profile = {maxSpeed, acceleration, acceleration, false};
+  return motion_profile_engine_us(profile, steps);
+}
+
+TunedMove tune_move(const AxisLimits &axis, uint8_t motor, uint32_t steps) {
+  TunedMove best = {motor, steps, 0.0f, 0.0f, UINT32_MAX, 0, {}};
+
+  auto consider = [&](float speed) {
+    if (speed <= 0.0f || speed > axis.max_speed) {
+      return;
+    }
+    const float accel = acceleration_limit(axis, speed);
+    if (accel <= 0.0f) {
+      return;
+    }
+    const uint32_t duration = move_us(speed, accel, steps);
+    // Ties go to the lower speed: same cycle time, gentler move.
+    if (duration < best.tuned_us || (duration == best.tuned_us && speed < best.max_speed)) {
+      best.max_speed = speed;
+      best.acceleration = accel;
+      best.tuned_us = duration;
+    }
+  };
+
+  for (int i = 1; i <= 400; ++i) {
+    consider(axis.max_speed * static_cast<float>(i) / 400.0f);
+  }
+  const float coarse = best.max_speed;
+  for (int i = -25; i <= 25; ++i) {
+    consider(coarse + axis.max_speed * static_cast<float>(i) / 10000.0f);
+  }
+
+  // Round for a readable table; the limits stay respected.
+  best.max_speed = floorf(best.max_speed);
+  best.acceleration = floorf(best.acceleration);
+  best.tuned_us = move_us(best.max_speed, best.acceleration, steps);
+  return best;
+}
+
+bool parse_float(const std::string &text, float &value) {
+  char *end = nullptr;
+  value = strtof(text.c_str(), &end);
+  return end != text.c_str() && *end == '\0';
+}
+
+bool load_axes(const std::string &path, std::map<uint8_t, AxisLimits> &axes, std::string &error) {
+  std::ifstream file(path);
+  if (!file) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  std::string raw;
+  int lineNumber = 0;
+  while (std::getline(file, raw)) {
+    ++lineNumber;
+    std::istringstream line(raw.substr(0, raw.find('#')));
+    std::vector<std::string> words;
+    for (std::string word; line >> word;) {
+      words.push_back(word);
+    }
+    if (words.empty()) {
+      continue;
+    }
+
+    const std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+    const int motor = (words.size() > 1) ? atoi(words[1].c_str()) : 0;
+    if (motor < 1 || motor > 3) {
+      error = where + "expected an axis number 1..3";
+      return false;
+    }
+    AxisLimits &axis = axes[static_cast<uint8_t>(motor)];
+
+    if (words[0] == "axis") {
+      if (words.size() != 8 || words[2] != "max_speed" || words[4] != "max_accel" || words[6] != "jerk" ||
+          !parse_float(words[3], axis.max_speed) || !parse_float(words[5], axis.max_accel) ||
+          !parse_float(words[7], axis.jerk) || axis.max_speed <= 0.0f || axis.max_accel <= 0.0f) {
+        error = where + "expected: axis <n> max_speed <v> max_accel <a> jerk <j>";
+        return false;
+      }
+      axis.present = true;
+    } else if (words[0] == "torque") {
+      axis.torque.clear();
+      for (size_t i = 2; i < words.size(); ++i) {
+        const size_t colon = words[i].find(':');
+        TorquePoint point = {};
+        if (colon == std::string::npos || !parse_float(words[i].substr(0, colon), point.speed) ||
+            !parse_float(words[i].substr(colon + 1), point.fraction) ||
+            (!axis.torque.empty() && point.speed <= axis.torque.back().speed)) {
+          error = where + "expected increasing <speed>:<fraction> points";
+          return false;
+        }
+        axis.torque.push_back(point);
+      }
+    } else {
+      error = where + "unknown directive " + words[0];
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t serial_cycle_us(MachineSequence &sequence) {
+  sequence_compute_durations(sequence);
+  uint64_t total = sequence.cycle_gap_us;
+  for (const SequenceTask &task : sequence.tasks) {
+    total += task.duration_us;
+  }
+  return total;
+}
+
+bool write_header(const char *path, const std::vector<TunedMove> &moves, const std::string &seqPath,
+                  const std::string &axesPath) {
+  FILE *out = fopen(path, "w");
+  if (out == nullptr) {
+    return false;
+  }
+
+  fprintf(out, "#pragma once\n\n");
+  fprintf(out, "// Generated by tools/profile_tuner from %s and %s.\n", seqPath.c_str(), axesPath.c_str());
+  fprintf(out, "// Do not edit; rerun the tuner after changing the sequence or the axis limits.\n\n");
+  fprintf(out, "#include \"stepper_motor.h\"\n\n");
+  fprintf(out, "const StepperProfileEntry kStepperProfileTable[] = {\n");
+  for (const TunedMove &move : moves) {
+    std::string tasks;
+    for (const std::string &task : move.tasks) {
+      tasks += (tasks.empty() ? "" : ", ") + task;
+    }
+    fprintf(out, "  {%u, %u, %.1ff, %.1ff},  // %s: %.1f ms (config %.1f ms)\n", move.motor, move.steps,
+            move.max_speed, move.acceleration, tasks.c_str(), ms(move.tuned_us), ms(move.config_us));
+  }
+  fprintf(out, "};\n\n");
+  fprintf(out, "constexpr uint8_t kStepperProfileTableCount =\n");
+  fprintf(out, "    static_cast<uint8_t>(sizeof(kStepperProfileTable) / sizeof(kStepperProfileTable[0]));\n");
+
+  fclose(out);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *seqPath = nullptr;
+  const char *axesPath = nullptr;
+  const char *outputPath = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (seqPath == nullptr) {
+      seqPath = argv[i];
+    } else if (axesPath == nullptr) {
+      axesPath = argv[i];
+    }
+  }
+
+  if (seqPath == nullptr || axesPath == nullptr) {
+    fprintf(stderr, "usage: %s <file.seq> <axes.cfg> [-o stepper_profile_table.h]\n", argv[0]);
+    return 2;
+  }
+
+  MachineSequence sequence;
+  std::map<uint8_t, AxisLimits> axes;
+  std::string error;
+  if (!sequence_load(seqPath, sequence, error) || !load_axes(axesPath, axes, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  if (sequence.stepper_profile.no_ramp) {
+    fprintf(stderr, "sequence uses no-ramp mode; there is no acceleration to tune\n");
+    return 1;
+  }
+
+  const MotionProfile config = motion_profile_engine(sequence.stepper_profile);
+  const uint64_t configCycle = serial_cycle_us(sequence);
+
+  // One table row per distinct (motor, steps); direction does not change the timing.
+  std::vector<TunedMove> moves;
+  std::map<std::pair<uint8_t, uint32_t>, size_t> rowOf;
+  for (SequenceTask &task : sequence.tasks) {
+    for (SequenceItem &item : task.items) {
+      if (item.kind != ItemKind::STEPPER) {
+        continue;
+      }
+      const AxisLimits &axis = axes[item.motor];
+      if (!axis.present) {
+        fprintf(stderr, "no limits for axis %u in %s\n", item.motor, axesPath);
+        return 1;
+      }
+
+      const std::pair<uint8_t, uint32_t> key(item.motor, item.steps);
+      auto found = rowOf.find(key);
+      if (found == rowOf.end()) {
+        TunedMove tuned = tune_move(axis, item.motor, item.steps);
+        tuned.config_us = move_us(config.max_speed, config.acceleration, item.steps);
+        found = rowOf.emplace(key, moves.size()).first;
+        moves.push_back(tuned);
+      }
+      TunedMove &row = moves[found->second];
+      row.tasks.push_back(task.name);
+      item.profile = {row.max_speed, row.acceleration, row.acceleration, false};
+    }
+  }
+
+  const uint64_t tunedCycle = serial_cycle_us(sequence);
+
+  printf("Config profile: %.0f steps/s, accel %.0f\n\n", config.max_speed, config.acceleration);
+  printf("  %-5s %7s %10s %10s %10s %10s  %s\n", "axis", "steps", "speed", "accel", "tuned ms", "config ms", "tasks");
+  for (const TunedMove &move : moves) {
+    std::string tasks;
+    for (const std::string &task : move.tasks) {
+      tasks += (tasks.empty() ? "" : " ") + task;
+    }
+    printf("  %-5u %7u %10.0f %10.0f %10.1f %10.1f  %s\n", move.motor, move.steps, move.max_speed, move.acceleration,
+           ms(move.tuned_us), ms(move.config_us), tasks.c_str());
+
+    // Flag when the hand-picked config asks for more than the axis can give.
+    const AxisLimits &axis = axes[move.motor];
+    const MoveTiming timing = motion_profile_plan(config, move.steps);
+    if (config.max_speed > axis.max_speed || config.acceleration > acceleration_limit(axis, timing.peak_speed)) {
+      printf("        config exceeds axis %u limits on this move (accel limit %.0f at %.0f steps/s)\n", move.motor,
+             acceleration_limit(axis, timing.peak_speed), timing.peak_speed);
+    }
+  }
+
+  printf("\nCycle time as written, config profile: %10.1f ms\n", ms(configCycle));
+  printf("Cycle time as written, tuned profiles: %10.1f ms\n", ms(tunedCycle));
+  if (tunedCycle <= configCycle) {
+    printf("Saving:                                %10.1f ms (%.1f%%)\n", ms(configCycle - tunedCycle),
+           configCycle ? 100.0 * (configCycle - tunedCycle) / configCycle : 0.0);
+  } else {
+    printf("Tuned cycle is %.1f ms longer: the config profile exceeds the axis limits\n",
+           ms(tunedCycle - configCycle));
+  }
+
+  if (outputPath != nullptr) {
+    if (!write_header(outputPath, moves, seqPath, axesPath)) {
+      fprintf(stderr, "cannot write %s\n", outputPath);
+      return 1;
+    }
+    printf("\nProfile table written to %s\n", outputPath);
+  }
+
+  return 0;
+}
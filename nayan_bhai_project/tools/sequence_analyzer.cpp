@@ -0,0 +1,276 @@
+// Offline critical-path and resource-conflict analyzer for machine sequences.
+//
+// Usage: sequence_analyzer <file.seq> [--gantt out.csv]
+//
+// Every task depends on the previous task that used the same actuator and on
+// its explicit "after" dependencies; nothing else. The earliest-start schedule
+// of that graph gives the theoretical minimum cycle time, the critical path and
+// the task pairs that are free to overlap, compared against the as-written
+// (strictly sequential) schedule of loop().
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sequence_model.h"
+
+namespace {
+
+struct Schedule {
+  std::vector<uint64_t> start_us;
+  std::vector<uint64_t> end_us;
+  uint64_t makespan_us;
+};
+
+double ms(uint64_t us) {
+  return static_cast<double>(us) / 1000.0;
+}
+
+// preds[j] lists every task j has to wait for.
+std::vector<std::vector<int>> build_dependencies(const MachineSequence &sequence) {
+  const size_t count = sequence.tasks.size();
+  std::vector<std::vector<int>> preds(count);
+  std::map<std::string, int> lastUser;
+
+  for (size_t j = 0; j < count; ++j) {
+    const SequenceTask &task = sequence.tasks[j];
+    for (const std::string &dep : task.after) {
+      preds[j].push_back(sequence_find_task(sequence, dep));
+    }
+    for (const SequenceItem &item : task.items) {
+      const auto found = lastUser.find(item.resource);
+      if (found != lastUser.end()) {
+        preds[j].push_back(found->second);
+      }
+    }
+    for (const SequenceItem &item : task.items) {
+      lastUser[item.resource] = static_cast<int>(j);
+    }
+    std::sort(preds[j].begin(), preds[j].end());
+    preds[j].erase(std::unique(preds[j].begin(), preds[j].end()), preds[j].end());
+  }
+  return preds;
+}
+
+Schedule serial_schedule(const MachineSequence &sequence) {
+  Schedule schedule{};
+  uint64_t now = 0;
+  for (const SequenceTask &task : sequence.tasks) {
+    schedule.start_us.push_back(now);
+    now += task.duration_us;
+    schedule.end_us.push_back(now);
+  }
+  schedule.makespan_us = now;
+  return schedule;
+}
+
+Schedule earliest_schedule(const MachineSequence &sequence, const std::vector<std::vector<int>> &preds,
+                           std::vector<int> &criticalPred) {
+  Schedule schedule{};
+  criticalPred.assign(sequence.tasks.size(), -1);
+
+  for (size_t j = 0; j < sequence.tasks.size(); ++j) {
+    uint64_t start = 0;
+    for (int p : preds[j]) {
+      if (schedule.end_us[p] >= start) {
+        start = schedule.end_us[p];
+        criticalPred[j] = p;
+      }
+    }
+    schedule.start_us.push_back(start);
+    schedule.end_us.push_back(start + sequence.tasks[j].duration_us);
+    schedule.makespan_us = std::max(schedule.makespan_us, schedule.end_us.back());
+  }
+  return schedule;
+}
+
+// Latest start that does not stretch the makespan; slack = latest - earliest.
+std::vector<uint64_t> latest_starts(const MachineSequence &sequence, const std::vector<std::vector<int>> &preds,
+                                    uint64_t makespan) {
+  const size_t count = sequence.tasks.size();
+  std::vector<uint64_t> latestEnd(count, makespan);
+  std::vector<uint64_t> latestStart(count, 0);
+
+  for (size_t k = count; k-- > 0;) {
+    latestStart[k] = latestEnd[k] - sequence.tasks[k].duration_us;
+    for (int p : preds[k]) {
+      latestEnd[p] = std::min(latestEnd[p], latestStart[k]);
+    }
+  }
+  return latestStart;
+}
+
+// reach[i][j] is true when task j transitively waits for task i.
+std::vector<std::vector<bool>> reachability(const std::vector<std::vector<int>> &preds) {
+  const size_t count = preds.size();
+  std::vector<std::vector<bool>> reach(count, std::vector<bool>(count, false));
+  for (size_t j = 0; j < count; ++j) {
+    for (int p : preds[j]) {
+      reach[p][j] = true;
+      for (size_t i = 0; i < count; ++i) {
+        if (reach[i][p]) {
+          reach[i][j] = true;
+        }
+      }
+    }
+  }
+  return reach;
+}
+
+void print_utilization(const MachineSequence &sequence, uint64_t serialCycle, uint64_t minCycle) {
+  std::map<std::string, uint64_t> busy;
+  for (const SequenceTask &task : sequence.tasks) {
+    for (const SequenceItem &item : task.items) {
+      busy[item.resource] += item.duration_us;
+    }
+  }
+
+  printf("\nPer-actuator utilization (busy time / cycle time):\n");
+  printf("  %-10s %10s %12s %12s\n", "actuator", "busy ms", "as-written", "minimum");
+  for (const auto &entry : busy) {
+    printf("  %-10s %10.1f %11.1f%% %11.1f%%\n", entry.first.c_str(), ms(entry.second),
+           serialCycle ? 100.0 * entry.second / serialCycle : 0.0,
+           minCycle ? 100.0 * entry.second / minCycle : 0.0);
+  }
+}
+
+bool write_gantt(const char *path, const MachineSequence &sequence, const Schedule &serial, const Schedule &earliest,
+                 const std::vector<uint64_t> &latestStart, const std::vector<bool> &critical) {
+  FILE *csv = fopen(path, "w");
+  if (csv == nullptr) {
+    return false;
+  }
+
+  fprintf(csv, "schedule,task,resource,start_ms,end_ms,duration_ms,slack_ms,critical\n");
+  const Schedule *schedules[] = {&serial, &earliest};
+  const char *names[] = {"as_written", "earliest"};
+  for (int s = 0; s < 2; ++s) {
+    for (size_t t = 0; t < sequence.tasks.size(); ++t) {
+      const SequenceTask &task = sequence.tasks[t];
+      const uint64_t slack = latestStart[t] - earliest.start_us[t];
+      for (const SequenceItem &item : task.items) {
+        const uint64_t start = schedules[s]->start_us[t];
+        fprintf(csv, "%s,%s,%s,%.3f,%.3f,%.3f,%.3f,%d\n", names[s], task.name.c_str(), item.resource.c_str(),
+                ms(start), ms(start + item.duration_us), ms(item.duration_us), ms(slack), critical[t] ? 1 : 0);
+      }
+    }
+  }
+
+  fclose(csv);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *seqPath = nullptr;
+  const char *ganttPath = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--gantt") == 0 && i + 1 < argc) {
+      ganttPath = argv[++i];
+    } else if (seqPath == nullptr && argv[i][0] != '-') {
+      seqPath = argv[i];
+    } else {
+      seqPath = nullptr;
+      break;
+    }
+  }
+
+  if (seqPath == nullptr) {
+    fprintf(stderr, "usage: %s <file.seq> [--gantt out.csv]\n", argv[0]);
+    return 2;
+  }
+
+  MachineSequence sequence;
+  std::string error;
+  if (!sequence_load(seqPath, sequence, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  const std::vector<std::vector<int>> preds = build_dependencies(sequence);
+  std::vector<int> criticalPred;
+  const Schedule serial = serial_schedule(sequence);
+  const Schedule earliest = earliest_schedule(sequence, preds, criticalPred);
+  const std::vector<uint64_t> latestStart = latest_starts(sequence, preds, earliest.makespan_us);
+  const std::vector<std::vector<bool>> reach = reachability(preds);
+
+  const MotionProfile engine = motion_profile_engine(sequence.stepper_profile);
+  printf("Stepper profile: %.0f steps/s, accel %.0f, decel %.0f%s (engine decel follows accel)\n",
+         engine.max_speed, engine.acceleration, sequence.stepper_profile.deceleration,
+         engine.no_ramp ? ", no ramp" : "");
+
+  printf("\n  %-8s %9s %9s %9s %9s %8s  %s\n", "task", "dur ms", "serial@", "earliest@", "latest@", "slack", "waits for");
+  std::vector<bool> critical(sequence.tasks.size(), false);
+  for (size_t t = 0; t < sequence.tasks.size(); ++t) {
+    critical[t] = (latestStart[t] == earliest.start_us[t]);
+    std::string waits;
+    for (int p : preds[t]) {
+      waits += (waits.empty() ? "" : " ") + sequence.tasks[p].name;
+    }
+    printf("%c %-8s %9.1f %9.1f %9.1f %9.1f %8.1f  %s\n", critical[t] ? '*' : ' ', sequence.tasks[t].name.c_str(),
+           ms(sequence.tasks[t].duration_us), ms(serial.start_us[t]), ms(earliest.start_us[t]), ms(latestStart[t]),
+           ms(latestStart[t] - earliest.start_us[t]), waits.empty() ? "-" : waits.c_str());
+  }
+
+  // Walk back from the task that finishes last along the binding predecessors.
+  int last = -1;
+  for (size_t t = 0; t < sequence.tasks.size(); ++t) {
+    if (last < 0 || earliest.end_us[t] >= earliest.end_us[last]) {
+      last = static_cast<int>(t);
+    }
+  }
+  std::vector<int> path;
+  for (int t = last; t >= 0; t = criticalPred[t]) {
+    path.push_back(t);
+  }
+  std::reverse(path.begin(), path.end());
+
+  printf("\nCritical path:");
+  for (size_t i = 0; i < path.size(); ++i) {
+    printf("%s%s", i ? " -> " : " ", sequence.tasks[path[i]].name.c_str());
+  }
+  printf("\n");
+
+  const uint64_t serialCycle = serial.makespan_us + sequence.cycle_gap_us;
+  const uint64_t minCycle = earliest.makespan_us + sequence.cycle_gap_us;
+  printf("\nCycle time as written:      %10.1f ms (incl. %.1f ms gap)\n", ms(serialCycle), ms(sequence.cycle_gap_us));
+  printf("Theoretical minimum cycle:  %10.1f ms\n", ms(minCycle));
+  printf("Potential saving:           %10.1f ms (%.1f%%)\n", ms(serialCycle - minCycle),
+         serialCycle ? 100.0 * (serialCycle - minCycle) / serialCycle : 0.0);
+
+  print_utilization(sequence, serialCycle, minCycle);
+
+  printf("\nTasks that could overlap (no dependency path between them):\n");
+  bool anyOverlap = false;
+  for (size_t i = 0; i < sequence.tasks.size(); ++i) {
+    std::string partners;
+    for (size_t j = i + 1; j < sequence.tasks.size(); ++j) {
+      if (!reach[i][j]) {
+        partners += " " + sequence.tasks[j].name;
+      }
+    }
+    if (!partners.empty()) {
+      anyOverlap = true;
+      printf("  %-8s with%s\n", sequence.tasks[i].name.c_str(), partners.c_str());
+    }
+  }
+  if (!anyOverlap) {
+    printf("  none - every task already waits for its predecessor\n");
+  }
+
+  if (ganttPath != nullptr) {
+    if (!write_gantt(ganttPath, sequence, serial, earliest, latestStart, critical)) {
+      fprintf(stderr, "cannot write %s\n", ganttPath);
+      return 1;
+    }
+    printf("\nGantt CSV written to %s\n", ganttPath);
+  }
+
+  return 0;
+}
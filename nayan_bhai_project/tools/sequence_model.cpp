@@ -0,0 +1,265 @@
+#include "sequence_model.h"
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+// Mirrors STEPPER_DEFAULT_* in include/defines.h.
+constexpr MotionProfile kFirmwareDefaults = {1200.0f, 800.0f, 800.0f, false};
+
+std::string trim(const std::string &text) {
+  const size_t first = text.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    return "";
+  }
+  const size_t last = text.find_last_not_of(" \t\r\n");
+  return text.substr(first, last - first + 1);
+}
+
+std::vector<std::string> split_words(const std::string &text) {
+  std::vector<std::string> words;
+  std::istringstream stream(text);
+  std::string word;
+  while (stream >> word) {
+    words.push_back(word);
+  }
+  return words;
+}
+
+// Remainder of a line after its first `count` whitespace-separated words.
+std::string skip_words(const std::string &text, size_t count) {
+  size_t pos = 0;
+  for (size_t i = 0; i < count; ++i) {
+    pos = text.find_first_not_of(" \t", pos);
+    pos = text.find_first_of(" \t", pos);
+    if (pos == std::string::npos) {
+      return "";
+    }
+  }
+  return text.substr(pos);
+}
+
+bool parse_uint(const std::string &text, uint32_t &value) {
+  char *end = nullptr;
+  const unsigned long parsed = strtoul(text.c_str(), &end, 10);
+  if (text.empty() || end == nullptr || *end != '\0') {
+    return false;
+  }
+  value = static_cast<uint32_t>(parsed);
+  return true;
+}
+
+bool parse_float(const std::string &text, float &value) {
+  char *end = nullptr;
+  value = strtof(text.c_str(), &end);
+  return !text.empty() && end != nullptr && *end == '\0';
+}
+
+bool parse_direction(const std::string &text, bool &ccw) {
+  if (text == "CW") {
+    ccw = false;
+    return true;
+  }
+  if (text == "CCW") {
+    ccw = true;
+    return true;
+  }
+  return false;
+}
+
+bool parse_item(const std::vector<std::string> &words, SequenceItem &item, std::string &error) {
+  item = SequenceItem{};
+
+  if (words.empty()) {
+    error = "empty item";
+    return false;
+  }
+
+  if (words[0] == "stepper") {
+    uint32_t motor = 0;
+    if (words.size() != 4 || !parse_uint(words[1], motor) || motor < 1 || motor > 3 ||
+        !parse_uint(words[2], item.steps) || !parse_direction(words[3], item.ccw)) {
+      error = "expected: stepper <1..3> <steps> <CW|CCW>";
+      return false;
+    }
+    item.kind = ItemKind::STEPPER;
+    item.motor = static_cast<uint8_t>(motor);
+    item.resource = "stepper" + words[1];
+    return true;
+  }
+
+  if (words[0] == "dc") {
+    uint32_t speed = 0;
+    if (words.size() != 5 || !parse_uint(words[2], item.time_ms) || !parse_uint(words[3], speed) ||
+        speed > 255 || !parse_direction(words[4], item.ccw)) {
+      error = "expected: dc <M3000|M1_300|M2_300> <time_ms> <speed> <CW|CCW>";
+      return false;
+    }
+    if (words[1] == "M3000") {
+      item.resource = "dc_3000";
+    } else if (words[1] == "M1_300") {
+      item.resource = "dc1_300";
+    } else if (words[1] == "M2_300") {
+      item.resource = "dc2_300";
+    } else {
+      error = "unknown DC motor " + words[1];
+      return false;
+    }
+    item.kind = ItemKind::DC;
+    item.speed = static_cast<uint8_t>(speed);
+    return true;
+  }
+
+  if (words[0] == "solenoid") {
+    if (words.size() != 2 || (words[1] != "ON" && words[1] != "OFF")) {
+      error = "expected: solenoid <ON|OFF>";
+      return false;
+    }
+    item.kind = ItemKind::SOLENOID;
+    item.on = (words[1] == "ON");
+    item.resource = "solenoid";
+    return true;
+  }
+
+  error = "unknown item kind " + words[0];
+  return false;
+}
+}  // namespace
+
+bool sequence_load(const std::string &path, MachineSequence &sequence, std::string &error) {
+  std::ifstream file(path);
+  if (!file) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  sequence = MachineSequence{};
+  sequence.stepper_profile = kFirmwareDefaults;
+
+  std::string raw;
+  int lineNumber = 0;
+  while (std::getline(file, raw)) {
+    ++lineNumber;
+    const std::string line = trim(raw.substr(0, raw.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+
+    const std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+    const std::vector<std::string> words = split_words(line);
+
+    if (words[0] == "config") {
+      float speed = 0.0f;
+      float accel = 0.0f;
+      float decel = 0.0f;
+      if (words.size() != 4 || !parse_float(words[1], speed) || !parse_float(words[2], accel) ||
+          !parse_float(words[3], decel)) {
+        error = where + "expected: config <speed> <accel> <decel>";
+        return false;
+      }
+      sequence.stepper_profile = motion_profile_from_config(speed, accel, decel, kFirmwareDefaults);
+    } else if (words[0] == "relay_settle_ms" || words[0] == "cycle_gap_ms") {
+      uint32_t ms = 0;
+      if (words.size() != 2 || !parse_uint(words[1], ms)) {
+        error = where + "expected: " + words[0] + " <ms>";
+        return false;
+      }
+      (words[0] == "relay_settle_ms" ? sequence.relay_settle_us : sequence.cycle_gap_us) = ms * 1000U;
+    } else if (words[0] == "task") {
+      if (words.size() < 3) {
+        error = where + "expected: task <name> <item>[, <item>...]";
+        return false;
+      }
+      if (sequence_find_task(sequence, words[1]) >= 0) {
+        error = where + "duplicate task " + words[1];
+        return false;
+      }
+
+      SequenceTask task{};
+      task.name = words[1];
+      task.line = lineNumber;
+
+      std::istringstream items(skip_words(line, 2));
+      std::string itemText;
+      while (std::getline(items, itemText, ',')) {
+        SequenceItem item;
+        std::string itemError;
+        if (!parse_item(split_words(itemText), item, itemError)) {
+          error = where + itemError;
+          return false;
+        }
+        for (const SequenceItem &other : task.items) {
+          if (other.resource == item.resource) {
+            error = where + "task uses " + item.resource + " twice";
+            return false;
+          }
+        }
+        task.items.push_back(item);
+      }
+      sequence.tasks.push_back(task);
+    } else if (words[0] == "after") {
+      if (words.size() < 3) {
+        error = where + "expected: after <task> <dependency>...";
+        return false;
+      }
+      const int taskIndex = sequence_find_task(sequence, words[1]);
+      if (taskIndex < 0) {
+        error = where + "unknown task " + words[1];
+        return false;
+      }
+      for (size_t i = 2; i < words.size(); ++i) {
+        const int depIndex = sequence_find_task(sequence, words[i]);
+        if (depIndex < 0 || depIndex >= taskIndex) {
+          error = where + "dependency " + words[i] + " must be an earlier task";
+          return false;
+        }
+        sequence.tasks[taskIndex].after.push_back(words[i]);
+      }
+    } else {
+      error = where + "unknown directive " + words[0];
+      return false;
+    }
+  }
+
+  for (SequenceTask &task : sequence.tasks) {
+    for (SequenceItem &item : task.items) {
+      item.profile = sequence.stepper_profile;
+    }
+  }
+
+  sequence_compute_durations(sequence);
+  return true;
+}
+
+void sequence_compute_durations(MachineSequence &sequence) {
+  for (SequenceTask &task : sequence.tasks) {
+    task.duration_us = 0;
+    for (SequenceItem &item : task.items) {
+      switch (item.kind) {
+        case ItemKind::STEPPER:
+          item.duration_us = motion_profile_engine_us(item.profile, item.steps);
+          break;
+        case ItemKind::DC:
+          item.duration_us = item.time_ms * 1000U;
+          break;
+        case ItemKind::SOLENOID:
+          item.duration_us = sequence.relay_settle_us;
+          break;
+      }
+      if (item.duration_us > task.duration_us) {
+        task.duration_us = item.duration_us;
+      }
+    }
+  }
+}
+
+int sequence_find_task(const MachineSequence &sequence, const std::string &name) {
+  for (size_t i = 0; i < sequence.tasks.size(); ++i) {
+    if (sequence.tasks[i].name == name) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Host-side model of a machine sequence (the Task1..TaskN script in loop()).
+// Shared by the offline tools in this directory.
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "motion_profile.h"
+
+enum class ItemKind : uint8_t {
+  STEPPER,
+  DC,
+  SOLENOID,
+};
+
+struct SequenceItem {
+  ItemKind kind;
+  std::string resource;   // "stepper1", "dc_3000", "solenoid", ...
+  uint8_t motor;          // stepper number 1..3 (STEPPER only)
+  uint32_t steps;         // STEPPER only
+  uint32_t time_ms;       // DC only
+  uint8_t speed;          // DC only
+  bool ccw;               // STEPPER / DC direction
+  bool on;                // SOLENOID only
+  MotionProfile profile;  // STEPPER only, profile the move runs with
+  uint32_t duration_us;
+};
+
+struct SequenceTask {
+  std::string name;
+  std::vector<SequenceItem> items;
+  std::vector<std::string> after;  // explicit process dependencies
+  uint32_t duration_us;            // longest item (items start together)
+  int line;
+};
+
+struct MachineSequence {
+  MotionProfile stepper_profile;   // as passed to stepper_set_config()
+  uint32_t relay_settle_us;
+  uint32_t cycle_gap_us;           // delay() at the end of loop()
+  std::vector<SequenceTask> tasks;
+};
+
+/**
+ * Parses a .seq file (see machine_loop.seq for the format).
+ * Returns false and fills error on the first malformed line.
+ */
+bool sequence_load(const std::string &path, MachineSequence &sequence, std::string &error);
+
+/**
+ * Fills duration_us on every item and task from the current profiles.
+ */
+void sequence_compute_durations(MachineSequence &sequence);
+
+/**
+ * Index of a task by name, or -1.
+ */
+int sequence_find_task(const MachineSequence &sequence, const std::string &name);
@@ -0,0 +1,197 @@
+// Runs the DC speed loop (src/dc_speed_loop.cpp) against a first-order motor
+// model with a quantizing encoder and checks hold-RPM settling and the
+// count-mode approach and stop.
+//
+// Usage: speed_loop_sim [--window-counts <counts>] [--window-periods <periods>]
+//
+// Gains, encoder resolutions and approach settings are the DC_* defaults of
+// defines.h. The model's gain is off from the feed-forward by GAIN_ERROR and
+// loads slow it down, so the PID has work to do. Exits non-zero if a run
+// settles too late, ripples too much or arrives too fast or too slow.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dc_speed_loop.h"
+
+namespace {
+
+constexpr float PERIOD_S = 1.0f / 500.0f;     // DC_SPEED_LOOP_HZ
+constexpr float SUBSTEP_S = 0.0001f;          // model integration step
+constexpr float MAX_DUTY = 255.0f;
+constexpr float GAIN_ERROR = 0.9f;            // motor reaches 90% of the speed the feed-forward expects
+constexpr float SETTLE_BAND = 0.05f;          // hold: within 5% of target
+constexpr float RIPPLE_BAND = 0.05f;          // hold: steady-state excursion of the true speed
+
+struct MotorModel {
+  const char *name;
+  float counts_per_rev;
+  float kff;                 // duty per RPM, as configured
+  float tau_s;               // mechanical time constant
+  float decel_rpm_per_s;
+  float min_rpm;
+  float kp;                  // DC_<motor>_SPEED_KP
+  float ki;                  // DC_<motor>_SPEED_KI
+};
+
+const MotorModel kMotor3000 = {"3000", 48.0f, 255.0f / 3000.0f, 0.05f, 15000.0f, 200.0f, 0.3f, 2.0f};
+const MotorModel kMotor300 = {"300", 600.0f, 255.0f / 300.0f, 0.03f, 1500.0f, 20.0f, 1.0f, 20.0f};
+
+struct Options {
+  int32_t window_counts = 32;
+  uint8_t window_periods = 25;
+};
+
+Options g_options;
+
+struct Plant {
+  const MotorModel *motor;
+  float rpm;
+  double revs;
+  float load;                // fraction of no-load speed lost to load
+};
+
+int32_t plant_count(const Plant &plant) {
+  return static_cast<int32_t>(floor(plant.revs * plant.motor->counts_per_rev));
+}
+
+// Advances the plant one loop period at duty.
+void plant_step(Plant &plant, float duty) {
+  const float noLoadRpm = duty / plant.motor->kff * GAIN_ERROR;
+  const float steady = noLoadRpm * (1.0f - plant.load);
+  for (float t = 0.0f; t < PERIOD_S - 1e-7f; t += SUBSTEP_S) {
+    plant.rpm += (steady - plant.rpm) * SUBSTEP_S / plant.motor->tau_s;
+    plant.revs += plant.rpm / 60.0f * SUBSTEP_S;
+  }
+}
+
+DcSpeedLoop make_loop(const MotorModel &motor) {
+  const DcSpeedLoopConfig config = {
+      motor.counts_per_rev, motor.kp, motor.ki, 0.0f, motor.kff, MAX_DUTY,
+      motor.decel_rpm_per_s, motor.min_rpm, PERIOD_S, g_options.window_counts, g_options.window_periods,
+  };
+  DcSpeedLoop loop;
+  dc_speed_loop_init(loop, config);
+  return loop;
+}
+
+// Holds rpm for 2 s with a load step at 1 s; checks settling after the start
+// and after the step, and the ripple over the last 0.5 s.
+bool check_hold(const MotorModel &motor, float rpm, float loadStep) {
+  DcSpeedLoop loop = make_loop(motor);
+  Plant plant = {&motor, 0.0f, 0.0, 0.1f};
+  dc_speed_loop_start(loop, plant_count(plant), rpm, 1);
+
+  const uint32_t periods = static_cast<uint32_t>(2.0f / PERIOD_S);
+  const uint32_t stepAt = periods / 2;
+  float settledMs = -1.0f;
+  float resettledMs = -1.0f;
+  float low = 1e9f;
+  float high = 0.0f;
+  float dutyLow = MAX_DUTY;
+  float dutyHigh = 0.0f;
+  for (uint32_t i = 0; i < periods; ++i) {
+    if (i == stepAt) {
+      plant.load += loadStep;
+    }
+    const DcSpeedLoopOutput output = dc_speed_loop_update(loop, plant_count(plant));
+    plant_step(plant, output.duty);
+
+    const bool inBand = fabsf(plant.rpm - rpm) <= SETTLE_BAND * rpm;
+    const float ms = i * PERIOD_S * 1000.0f;
+    if (i < stepAt) {
+      settledMs = inBand ? (settledMs < 0.0f ? ms : settledMs) : -1.0f;
+    } else {
+      resettledMs = inBand ? (resettledMs < 0.0f ? ms - stepAt * PERIOD_S * 1000.0f : resettledMs) : -1.0f;
+    }
+    if (i >= periods * 3 / 4) {
+      low = fminf(low, plant.rpm);
+      high = fmaxf(high, plant.rpm);
+      dutyLow = fminf(dutyLow, output.duty);
+      dutyHigh = fmaxf(dutyHigh, output.duty);
+    }
+  }
+
+  const float ripple = fmaxf(high - rpm, rpm - low) / rpm;
+  const bool pass = settledMs >= 0.0f && settledMs <= 300.0f && resettledMs >= 0.0f && resettledMs <= 300.0f &&
+                    ripple <= RIPPLE_BAND;
+  printf("hold %-4s %5.0f rpm  settled %5.0f ms, after load %5.0f ms, ripple %4.1f%%, duty %3.0f..%3.0f %s\n",
+         motor.name, rpm, settledMs, resettledMs, 100.0f * ripple, dutyLow, dutyHigh, pass ? "ok" : "FAIL");
+  return pass;
+}
+
+// Runs counts at up to rpm; checks the loop reports done on the count, arrives
+// near min_rpm, and takes no longer than the ideal profile plus a margin.
+bool check_counts(const MotorModel &motor, int32_t counts, float rpm) {
+  DcSpeedLoop loop = make_loop(motor);
+  Plant plant = {&motor, 0.0f, 0.0, 0.1f};
+  const int32_t start = plant_count(plant);
+  dc_speed_loop_start_counts(loop, start, counts, rpm, 1);
+
+  // Ideal: accelerate with tau_s, cruise, brake along decel_rpm_per_s.
+  const float revs = counts / motor.counts_per_rev;
+  const float decelRevs = rpm * rpm / (2.0f * motor.decel_rpm_per_s * 60.0f);
+  const float idealS = 3.0f * motor.tau_s + (revs - decelRevs) / (rpm / 60.0f) + rpm / motor.decel_rpm_per_s;
+
+  uint32_t periods = 0;
+  float arrivalRpm = 0.0f;
+  bool done = false;
+  while (!done && periods < static_cast<uint32_t>(20.0f / PERIOD_S)) {
+    const DcSpeedLoopOutput output = dc_speed_loop_update(loop, plant_count(plant));
+    done = output.done;
+    if (done) {
+      arrivalRpm = plant.rpm;
+      break;
+    }
+    plant_step(plant, output.duty);
+    ++periods;
+  }
+
+  const float seconds = periods * PERIOD_S;
+  const int32_t reached = plant_count(plant) - start;
+  const bool pass = done && reached >= counts && reached <= counts + 2 && arrivalRpm <= 3.0f * motor.min_rpm &&
+                    seconds <= 1.5f * idealS;
+  printf("count %-4s %5ld counts at %5.0f rpm  done after %5.0f ms (ideal %5.0f), at %4.0f rpm, +%ld counts %s\n",
+         motor.name, static_cast<long>(counts), rpm, seconds * 1000.0f, idealS * 1000.0f, arrivalRpm,
+         static_cast<long>(reached - counts), pass ? "ok" : "FAIL");
+  return pass;
+}
+
+bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (strcmp(argv[i], "--window-counts") == 0) {
+      g_options.window_counts = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--window-periods") == 0) {
+      g_options.window_periods = static_cast<uint8_t>(atoi(argv[++i]));
+    } else {
+      return false;
+    }
+  }
+  return g_options.window_counts > 0 && g_options.window_periods > 0;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    fprintf(stderr, "usage: speed_loop_sim [--window-counts <counts>] [--window-periods <periods>]\n");
+    return 2;
+  }
+
+  bool ok = true;
+  ok = check_hold(kMotor3000, 2000.0f, 0.15f) && ok;
+  ok = check_hold(kMotor3000, 800.0f, 0.15f) && ok;
+  ok = check_hold(kMotor300, 200.0f, 0.15f) && ok;
+  ok = check_hold(kMotor300, 60.0f, 0.15f) && ok;
+  ok = check_counts(kMotor3000, 2400, 2500.0f) && ok;
+  ok = check_counts(kMotor3000, 240, 2500.0f) && ok;
+  ok = check_counts(kMotor300, 3000, 250.0f) && ok;
+  ok = check_counts(kMotor300, 300, 250.0f) && ok;
+
+  puts(ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+// Feeds simulated encoder counts of a stepper axis through the stall detector
+// (src/stall_detector.cpp) and checks which runs it flags as stalled and how fast.
+//
+// Usage: stall_sim [--limit <steps>] [--confirm <checks>] [--counts-per-step <counts>]
+//
+// Defaults are the STEPPER_* stall settings of defines.h and the loop() move
+// profile. Each scenario commands a 5000-step trapezoid move checked every
+// CHECK_US; the rotor trails the command by a load-dependent lag and the
+// encoder adds quantization and a count of jitter. Exits non-zero if a
+// scenario is flagged wrongly or later than its deadline.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stall_detector.h"
+
+namespace {
+
+constexpr float MAX_SPEED = 12000.0f;   // steps/second
+constexpr float ACCEL = 8000.0f;        // steps/second^2
+constexpr int32_t MOVE_STEPS = 5000;
+constexpr uint32_t CHECK_US = 1000;
+constexpr float LAG_S = 0.0002f;        // rotor lag behind the command at speed, seconds
+
+struct Options {
+  StallDetectorConfig config = {1.0f, 20, 3};
+};
+
+enum class Fault : uint8_t {
+  NONE = 0,
+  JAM = 1,      // rotor stops at event_step
+  SLIP = 2,     // rotor loses slip_steps once at event_step and keeps turning
+  GLITCH = 3,   // encoder reads slip_steps off for a single check at event_step
+};
+
+struct Scenario {
+  const char *name;
+  Fault fault;
+  int32_t event_step;
+  int32_t slip_steps;
+  bool expect_stall;
+};
+
+Options g_options;
+
+// Commanded position of the trapezoid move at t seconds.
+float commanded_at(float t) {
+  const float accelTime = MAX_SPEED / ACCEL;
+  const float accelSteps = 0.5f * ACCEL * accelTime * accelTime;
+  const float cruiseSteps = MOVE_STEPS - 2.0f * accelSteps;
+  const float cruiseTime = cruiseSteps / MAX_SPEED;
+  if (t <= accelTime) {
+    return 0.5f * ACCEL * t * t;
+  }
+  if (t <= accelTime + cruiseTime) {
+    return accelSteps + MAX_SPEED * (t - accelTime);
+  }
+  const float tDecel = t - accelTime - cruiseTime;
+  if (tDecel >= accelTime) {
+    return static_cast<float>(MOVE_STEPS);
+  }
+  return accelSteps + cruiseSteps + MAX_SPEED * tDecel - 0.5f * ACCEL * tDecel * tDecel;
+}
+
+float speed_at(float t) {
+  const float dt = 0.0001f;
+  return (commanded_at(t + dt) - commanded_at(t)) / dt;
+}
+
+float noise() {
+  return static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 2.0f - 1.0f;
+}
+
+// Returns true if the detector flagged a stall, and when, in *stall_ms after the event.
+bool run_scenario(const Scenario &scenario, float *stall_ms, float *event_ms) {
+  StallDetector detector;
+  stall_detector_init(detector, g_options.config);
+  stall_detector_sync(detector, 0, 0);
+
+  const float cps = g_options.config.counts_per_step;
+  const float total_s = 2.0f * MAX_SPEED / ACCEL + MOVE_STEPS / MAX_SPEED + 0.2f;
+  float jammedAt = -1.0f;
+  float offset = 0.0f;
+  *event_ms = -1.0f;
+
+  for (uint32_t t_us = CHECK_US; t_us * 1e-6f < total_s; t_us += CHECK_US) {
+    const float t = t_us * 1e-6f;
+    const float commanded = commanded_at(t);
+    float actual = commanded - speed_at(t) * LAG_S;
+    bool glitch = false;
+
+    if (scenario.fault != Fault::NONE && commanded >= scenario.event_step) {
+      if (*event_ms < 0.0f) {
+        *event_ms = t * 1000.0f;
+        if (scenario.fault == Fault::SLIP) {
+          offset = static_cast<float>(scenario.slip_steps);
+        }
+        glitch = scenario.fault == Fault::GLITCH;
+      }
+      if (scenario.fault == Fault::JAM) {
+        if (jammedAt < 0.0f) {
+          jammedAt = actual;
+        }
+        actual = jammedAt;
+      }
+    }
+    actual -= offset;
+
+    float counts = floorf(actual * cps) + roundf(noise());
+    if (glitch) {
+      counts -= scenario.slip_steps * cps;
+    }
+    const StallCheck check =
+        stall_detector_update(detector, static_cast<int32_t>(lroundf(commanded)), static_cast<int32_t>(counts));
+    if (check == StallCheck::STALLED) {
+      *stall_ms = t * 1000.0f - *event_ms;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool check_resync() {
+  // After a stall the firmware syncs the command onto the encoder; the axis
+  // position read back must then follow the encoder exactly.
+  StallDetector detector;
+  stall_detector_init(detector, g_options.config);
+  const float cps = g_options.config.counts_per_step;
+  stall_detector_sync(detector, 1234, static_cast<int32_t>(5678 * cps));
+  const int32_t actual = stall_detector_actual_position(detector, static_cast<int32_t>((5678 + 100) * cps));
+  const StallCheck check = stall_detector_update(detector, 1334, static_cast<int32_t>((5678 + 100) * cps));
+  const bool pass = actual == 1334 && check == StallCheck::OK && detector.following_error == 0;
+  printf("%-34s position %ld after 100 steps %s\n", "resync after correction", static_cast<long>(actual),
+         pass ? "ok" : "FAIL");
+  return pass;
+}
+
+bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (strcmp(argv[i], "--limit") == 0) {
+      g_options.config.following_error_limit = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--confirm") == 0) {
+      g_options.config.confirm_samples = static_cast<uint8_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--counts-per-step") == 0) {
+      g_options.config.counts_per_step = static_cast<float>(atof(argv[++i]));
+    } else {
+      return false;
+    }
+  }
+  return g_options.config.following_error_limit > 0 && g_options.config.confirm_samples > 0 &&
+         g_options.config.counts_per_step > 0.0f;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    fprintf(stderr, "usage: stall_sim [--limit <steps>] [--confirm <checks>] [--counts-per-step <counts>]\n");
+    return 2;
+  }
+
+  // A jam must be flagged once the command has run limit steps ahead at cruise
+  // speed, plus the confirming checks and one more for jitter.
+  const int32_t limit = g_options.config.following_error_limit;
+  const float deadlineMs = 1000.0f * limit / MAX_SPEED + (g_options.config.confirm_samples + 1) * CHECK_US / 1000.0f;
+  const Scenario scenarios[] = {
+    {"healthy move", Fault::NONE, 0, 0, false},
+    {"jam at cruise", Fault::JAM, 2500, 0, true},
+    {"jam during acceleration", Fault::JAM, 300, 0, true},
+    {"slip under the limit", Fault::SLIP, 2500, limit / 2, false},
+    {"slip over the limit", Fault::SLIP, 2500, 2 * limit, true},
+    {"one-check encoder glitch", Fault::GLITCH, 2500, 2 * limit, false},
+  };
+
+  srand(1);
+  bool ok = true;
+  for (const Scenario &scenario : scenarios) {
+    float stallMs = 0.0f;
+    float eventMs = 0.0f;
+    const bool stalled = run_scenario(scenario, &stallMs, &eventMs);
+    bool pass = stalled == scenario.expect_stall;
+    if (stalled) {
+      // A jam during acceleration builds error slower than at cruise; allow for it.
+      const float deadline = (scenario.event_step < 1000) ? 3.0f * deadlineMs : deadlineMs;
+      pass = pass && stallMs <= deadline;
+      printf("%-34s stall after %5.1f ms (deadline %.1f ms) %s\n", scenario.name, stallMs, deadline,
+             pass ? "ok" : "FAIL");
+    } else {
+      printf("%-34s %-36s %s\n", scenario.name, "no stall", pass ? "ok" : "FAIL");
+    }
+    ok = ok && pass;
+  }
+  ok = check_resync() && ok;
+
+  puts(ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,317 @@
+// Runs the step stream's buffer fill (src/step_stream_fill.cpp) on the host and
+// decodes the bus words it writes, checking STEP pulse widths, DIR setup, step
+// counts, move durations and what the status reports as left to go.
+//
+// Usage: step_stream_sim [--sample-hz <hz>] [--pulse <words>] [--buffer <words>] [--bus-width <8|16>]
+//
+// Defaults are the STEP_STREAM_* settings of defines.h. The fill runs
+// AccelStepper's ramp, so move durations are compared against
+// motion_profile_engine_us(). Exits
+// non-zero if a pulse is too short, a step goes missing or a run reports
+// steps left to go.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "motion_profile.h"
+#include "step_stream_fill.h"
+
+namespace {
+
+constexpr uint8_t AXES = 2;
+constexpr float DURATION_TOLERANCE = 0.02f;  // of the engine estimate
+
+struct Options {
+  StreamTiming timing = {2000000, 4000, 10, 10, 8};
+};
+
+Options g_options;
+
+// What the pins of one axis did, decoded from consecutive buffers.
+struct Decoded {
+  int64_t steps = 0;           // signed, by the DIR level at each rising edge
+  uint32_t shortest_high = UINT32_MAX;
+  uint32_t shortest_low = UINT32_MAX;  // between two pulses
+  uint32_t shortest_dir_setup = UINT32_MAX;
+  uint32_t crossing_pulses = 0;  // pulses split over two buffers
+  uint32_t first_rise = 0;
+  uint32_t last_fall = 0;
+  float fastest_rate = 0.0f;   // steps/second between two rising edges
+};
+
+struct Bench {
+  StreamAxis axes[AXES] = {};
+  StreamCommand commands[AXES] = {};
+  std::vector<uint8_t> buffer;
+  uint32_t start = 0;
+  Decoded decoded[AXES];
+  bool high[AXES] = {};
+  bool dir[AXES] = {};
+  bool seenRise[AXES] = {};
+  uint32_t riseAt[AXES] = {};
+  uint32_t fallAt[AXES] = {};
+  uint32_t dirChangeAt[AXES] = {};
+  bool dirChanged[AXES] = {};
+
+  Bench() : buffer(g_options.timing.buffer_samples * (g_options.timing.bus_width / 8)) {
+    for (uint8_t index = 0; index < AXES; ++index) {
+      axes[index].direction = 1;
+      dir[index] = true;
+    }
+  }
+
+  uint16_t word(uint32_t sample) const {
+    if (g_options.timing.bus_width == 8) {
+      return buffer[sample];
+    }
+    uint16_t value;
+    memcpy(&value, &buffer[sample * 2], sizeof(value));
+    return value;
+  }
+
+  // One buffer as the fill task does it, then decoded word by word.
+  void step() {
+    const StreamTiming &timing = g_options.timing;
+    for (uint8_t index = 0; index < AXES; ++index) {
+      step_stream_fill_command(axes[index], commands[index], timing, start);
+    }
+    step_stream_fill_clear(axes, AXES, timing, buffer.data());
+    for (uint8_t index = 0; index < AXES; ++index) {
+      step_stream_fill_axis(axes[index], index, timing, start, buffer.data());
+    }
+
+    for (uint32_t sample = 0; sample < timing.buffer_samples; ++sample) {
+      const uint16_t bits = word(sample);
+      const uint32_t now = start + sample;
+      for (uint8_t index = 0; index < AXES; ++index) {
+        Decoded &d = decoded[index];
+        const bool step = bits & (1U << index);
+        const bool dirBit = bits & (1U << (timing.bus_width / 2 + index));
+        if (dirBit != dir[index]) {
+          dir[index] = dirBit;
+          dirChangeAt[index] = now;
+          dirChanged[index] = true;
+        }
+        if (step && !high[index]) {
+          if (seenRise[index]) {
+            const uint32_t low = now - fallAt[index];
+            d.shortest_low = (low < d.shortest_low) ? low : d.shortest_low;
+            const float rate = static_cast<float>(timing.sample_hz) / static_cast<float>(now - riseAt[index]);
+            d.fastest_rate = fmaxf(d.fastest_rate, rate);
+          } else {
+            d.first_rise = now;
+          }
+          if (dirChanged[index]) {
+            const uint32_t setup = now - dirChangeAt[index];
+            d.shortest_dir_setup = (setup < d.shortest_dir_setup) ? setup : d.shortest_dir_setup;
+            dirChanged[index] = false;
+          }
+          seenRise[index] = true;
+          riseAt[index] = now;
+          d.steps += dirBit ? 1 : -1;
+        } else if (!step && high[index]) {
+          const uint32_t width = now - riseAt[index];
+          d.shortest_high = (width < d.shortest_high) ? width : d.shortest_high;
+          if (riseAt[index] < start) {
+            ++d.crossing_pulses;
+          }
+          fallAt[index] = now;
+          d.last_fall = now;
+        }
+        high[index] = step;
+      }
+    }
+    start += timing.buffer_samples;
+  }
+
+  StreamStatus status(uint8_t index) const {
+    return step_stream_fill_status(axes[index], g_options.timing);
+  }
+
+  bool idle(uint8_t index) const {
+    return !commands[index].pending && axes[index].state == StreamState::IDLE && !high[index];
+  }
+
+  // Fills buffers until the axis is at rest, or max_buffers have gone by.
+  bool run_until_idle(uint8_t index, uint32_t max_buffers) {
+    for (uint32_t count = 0; count < max_buffers; ++count) {
+      step();
+      if (idle(index)) {
+        step();  // let the last pulse fall
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+StreamCommand move_command(int32_t steps, float maxSpeed, float acceleration) {
+  StreamCommand command = {};
+  command.pending = true;
+  command.state = StreamState::POSITIONING;
+  command.steps = steps;
+  command.direction = (steps > 0) ? 1 : -1;
+  command.max_speed = maxSpeed;
+  command.acceleration = acceleration;
+  return command;
+}
+
+StreamCommand run_command(int8_t direction, float maxSpeed, float acceleration, uint32_t timeMs) {
+  StreamCommand command = {};
+  command.pending = true;
+  command.state = (timeMs > 0) ? StreamState::TIMED_RUN : StreamState::CONTINUOUS;
+  command.direction = direction;
+  command.max_speed = maxSpeed;
+  command.acceleration = acceleration;
+  command.time_ms = timeMs;
+  return command;
+}
+
+StreamCommand stop_command() {
+  StreamCommand command = {};
+  command.pending = true;
+  command.state = StreamState::IDLE;
+  command.ramp = true;
+  return command;
+}
+
+bool pulses_ok(const Decoded &d) {
+  const uint16_t pulse = g_options.timing.pulse_samples;
+  return d.shortest_high >= pulse && (d.shortest_low == UINT32_MAX || d.shortest_low >= pulse);
+}
+
+bool check_move(const char *name, int32_t steps, float maxSpeed, float acceleration) {
+  Bench bench;
+  bench.commands[0] = move_command(steps, maxSpeed, acceleration);
+  const bool finished = bench.run_until_idle(0, 100000);
+  const Decoded &d = bench.decoded[0];
+
+  const MotionProfile profile = {maxSpeed, acceleration, acceleration, acceleration <= 0.0f};
+  const float idealUs = static_cast<float>(motion_profile_engine_us(profile, static_cast<uint32_t>(abs(steps))));
+  const float tookUs = 1e6f * static_cast<float>(d.last_fall - d.first_rise) / g_options.timing.sample_hz;
+  const float error = (tookUs - idealUs) / idealUs;
+  const bool pass = finished && d.steps == steps && bench.status(0).position == steps && pulses_ok(d) &&
+                    bench.status(0).remaining == 0 && d.fastest_rate <= 1.01f * maxSpeed &&
+                    fabsf(error) <= DURATION_TOLERANCE;
+  printf("%-30s %7lld steps, high >= %u, low >= %u, %u split, %.0f/s peak, %+5.2f%% of estimate %s\n", name,
+         static_cast<long long>(d.steps), d.shortest_high, d.shortest_low, d.crossing_pulses, d.fastest_rate,
+         100.0f * error, pass ? "ok" : "FAIL");
+  return pass;
+}
+
+// A reversal mid-move ramps to rest, flips DIR on a buffer boundary and keeps
+// the DIR setup time before the first step the other way.
+bool check_reversal() {
+  Bench bench;
+  bench.commands[0] = move_command(20000, 20000.0f, 100000.0f);
+  for (uint8_t i = 0; i < 20; ++i) {
+    bench.step();
+  }
+  bench.commands[0] = move_command(-5000, 20000.0f, 100000.0f);
+  const int64_t before = bench.status(0).position;
+  const bool finished = bench.run_until_idle(0, 100000);
+  const Decoded &d = bench.decoded[0];
+  const bool pass = finished && bench.status(0).position == d.steps && d.steps < before &&
+                    d.shortest_dir_setup >= g_options.timing.dir_setup_samples && pulses_ok(d);
+  printf("%-30s at %lld, DIR setup >= %u words, high >= %u, low >= %u %s\n", "reversal mid-move",
+         static_cast<long long>(d.steps), d.shortest_dir_setup, d.shortest_high, d.shortest_low,
+         pass ? "ok" : "FAIL");
+  return pass;
+}
+
+bool check_runs() {
+  Bench bench;
+  bench.commands[0] = run_command(1, 10000.0f, 50000.0f, 0);
+  bench.commands[1] = run_command(-1, 10000.0f, 50000.0f, 300);
+  bool zero = true;
+  // Past the end of the timed run.
+  const uint32_t buffers = static_cast<uint32_t>(400ULL * g_options.timing.sample_hz / 1000 /
+                                                 g_options.timing.buffer_samples);
+  for (uint32_t i = 0; i < buffers; ++i) {
+    bench.step();
+    zero = zero && bench.status(0).remaining == 0 && bench.status(1).remaining == 0;
+  }
+  const bool timedDone = bench.idle(1);
+  const uint32_t timedMs =
+      static_cast<uint32_t>(1000ULL * (bench.decoded[1].last_fall - bench.decoded[1].first_rise) /
+                            g_options.timing.sample_hz);
+
+  bench.commands[0] = stop_command();
+  const bool stopped = bench.run_until_idle(0, 1000);
+  zero = zero && bench.status(0).remaining == 0 && bench.status(1).remaining == 0;
+
+  const bool pass = zero && timedDone && timedMs <= 300 && timedMs >= 280 && stopped &&
+                    pulses_ok(bench.decoded[0]) && pulses_ok(bench.decoded[1]) &&
+                    bench.status(0).position == bench.decoded[0].steps &&
+                    bench.status(1).position == bench.decoded[1].steps;
+  printf("%-30s remaining 0 throughout: %s, timed run %u ms of 300, stopped %s %s\n", "continuous and timed runs",
+         zero ? "yes" : "no", timedMs, stopped ? "yes" : "no", pass ? "ok" : "FAIL");
+  return pass;
+}
+
+// A ramped stop mid-move leaves the steps it did not take as remaining.
+bool check_stop_remaining() {
+  Bench bench;
+  bench.commands[0] = move_command(50000, 20000.0f, 50000.0f);
+  for (uint8_t i = 0; i < 50; ++i) {
+    bench.step();
+  }
+  bench.commands[0] = stop_command();
+  const bool stopped = bench.run_until_idle(0, 1000);
+  const StreamStatus status = bench.status(0);
+  const bool pass = stopped && status.remaining > 0 && status.position + status.remaining == 50000 &&
+                    status.position == bench.decoded[0].steps && pulses_ok(bench.decoded[0]);
+  printf("%-30s at %lld, %ld left %s\n", "ramped stop mid-move", static_cast<long long>(status.position),
+         static_cast<long>(status.remaining), pass ? "ok" : "FAIL");
+  return pass;
+}
+
+bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    StreamTiming &timing = g_options.timing;
+    if (strcmp(argv[i], "--sample-hz") == 0) {
+      timing.sample_hz = static_cast<uint32_t>(atol(argv[++i]));
+    } else if (strcmp(argv[i], "--pulse") == 0) {
+      timing.pulse_samples = static_cast<uint16_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--buffer") == 0) {
+      timing.buffer_samples = static_cast<uint16_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--bus-width") == 0) {
+      timing.bus_width = static_cast<uint8_t>(atoi(argv[++i]));
+    } else {
+      return false;
+    }
+  }
+  const StreamTiming &timing = g_options.timing;
+  return timing.sample_hz > 0 && timing.pulse_samples > 0 && timing.buffer_samples > timing.pulse_samples &&
+         (timing.bus_width == 8 || timing.bus_width == 16);
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    fprintf(stderr, "usage: step_stream_sim [--sample-hz <hz>] [--pulse <words>] [--buffer <words>] "
+                    "[--bus-width <8|16>]\n");
+    return 2;
+  }
+
+  const float fastest = static_cast<float>(g_options.timing.sample_hz) / (2.0f * g_options.timing.pulse_samples);
+  bool ok = true;
+  ok = check_move("trapezoid 20000 at 20 kHz", 20000, 20000.0f, 50000.0f) && ok;
+  ok = check_move("triangle 300 at 20 kHz", 300, 20000.0f, 50000.0f) && ok;
+  ok = check_move("no ramp 5000 at 8 kHz", 5000, 8000.0f, 0.0f) && ok;
+  ok = check_move("fastest the pulse allows", 40000, fastest, 400000.0f) && ok;
+  ok = check_move("slow 200 at 500 Hz", -200, 500.0f, 2000.0f) && ok;
+  ok = check_reversal() && ok;
+  ok = check_runs() && ok;
+  ok = check_stop_remaining() && ok;
+
+  puts(ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+// Decodes a captured telemetry stream (see include/telemetry_frame.h) into CSV.
+//
+// Usage: telemetry_decode <capture.bin | -> [-o out.csv]
+//
+// Capture the raw USB CDC bytes, e.g. `cat /dev/ttyACM0 > capture.bin`. Text
+// log lines interleaved with the frames are skipped: the decoder resynchronizes
+// on the frame magic and only accepts frames whose CRC matches.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "crc16.h"
+#include "telemetry_frame.h"
+
+namespace {
+
+const char *kStateNames[] = {"idle", "positioning", "timed", "continuous"};
+const char *kDcNames[TELEMETRY_DC_COUNT] = {"dc3000", "dc1_300", "dc2_300"};
+
+std::vector<uint8_t> read_all(FILE *input) {
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t count = 0;
+  while ((count = fread(chunk, 1, sizeof(chunk), input)) > 0) {
+    data.insert(data.end(), chunk, chunk + count);
+  }
+  return data;
+}
+
+bool frame_at(const std::vector<uint8_t> &data, size_t offset, TelemetryFrame &frame) {
+  if (offset + sizeof(TelemetryFrame) > data.size()) {
+    return false;
+  }
+  memcpy(&frame, &data[offset], sizeof(frame));
+  if (frame.header.magic != TELEMETRY_FRAME_MAGIC || frame.header.version != TELEMETRY_FRAME_VERSION ||
+      frame.header.sample_count > TELEMETRY_SAMPLES_PER_FRAME) {
+    return false;
+  }
+  return crc16_ccitt(&data[offset], sizeof(frame) - sizeof(frame.crc)) == frame.crc;
+}
+
+void write_header(FILE *out) {
+  fprintf(out, "frame,time_s");
+  for (int i = 1; i <= TELEMETRY_STEPPER_COUNT; ++i) {
+    fprintf(out, ",s%d_pos,s%d_speed,s%d_state", i, i, i);
+  }
+  for (int i = 0; i < TELEMETRY_DC_COUNT; ++i) {
+    fprintf(out, ",%s_duty,%s_dir,%s_en,%s_ma", kDcNames[i], kDcNames[i], kDcNames[i], kDcNames[i]);
+  }
+  fprintf(out, ",relay,paused\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *inputPath = nullptr;
+  const char *outputPath = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (inputPath == nullptr) {
+      inputPath = argv[i];
+    }
+  }
+
+  if (inputPath == nullptr) {
+    fprintf(stderr, "usage: %s <capture.bin | -> [-o out.csv]\n", argv[0]);
+    return 2;
+  }
+
+  FILE *input = (strcmp(inputPath, "-") == 0) ? stdin : fopen(inputPath, "rb");
+  if (input == nullptr) {
+    fprintf(stderr, "cannot open %s\n", inputPath);
+    return 1;
+  }
+  const std::vector<uint8_t> data = read_all(input);
+  if (input != stdin) {
+    fclose(input);
+  }
+
+  FILE *out = (outputPath == nullptr) ? stdout : fopen(outputPath, "w");
+  if (out == nullptr) {
+    fprintf(stderr, "cannot write %s\n", outputPath);
+    return 1;
+  }
+
+  write_header(out);
+
+  size_t frames = 0;
+  size_t skippedBytes = 0;
+  size_t lostFrames = 0;
+  uint32_t lastSequence = 0;
+  uint16_t deviceDropped = 0;
+  uint32_t lastTimestamp = 0;
+  int64_t timeUs = 0;
+  bool haveTime = false;
+  size_t backSteps = 0;
+
+  size_t offset = 0;
+  TelemetryFrame frame;
+  while (offset + sizeof(TelemetryFrame) <= data.size()) {
+    if (!frame_at(data, offset, frame)) {
+      ++offset;
+      ++skippedBytes;
+      continue;
+    }
+    offset += sizeof(TelemetryFrame);
+
+    if (frames > 0 && frame.header.sequence > lastSequence + 1) {
+      lostFrames += frame.header.sequence - lastSequence - 1;
+    }
+    lastSequence = frame.header.sequence;
+    deviceDropped = frame.header.dropped_frames;
+    ++frames;
+
+    for (uint8_t s = 0; s < frame.header.sample_count; ++s) {
+      const TelemetrySample &sample = frame.samples[s];
+
+      // Unwrap the 32-bit microsecond clock. Samples are far less than 2^31 us
+      // apart, so the signed difference tells a wrap, which moves forward, from
+      // a sample stamped slightly before the one ahead of it.
+      if (haveTime) {
+        const int32_t delta = static_cast<int32_t>(sample.timestamp_us - lastTimestamp);
+        if (delta < 0) {
+          ++backSteps;
+        }
+        timeUs += delta;
+      } else {
+        timeUs = sample.timestamp_us;
+      }
+      lastTimestamp = sample.timestamp_us;
+      haveTime = true;
+
+      fprintf(out, "%u,%.6f", frame.header.sequence, static_cast<double>(timeUs) / 1e6);
+      for (int i = 0; i < TELEMETRY_STEPPER_COUNT; ++i) {
+        const uint8_t state = (sample.stepper_states >> (i * TELEMETRY_STEPPER_STATE_BITS)) & 0x3;
+        fprintf(out, ",%d,%d,%s", sample.position[i], sample.speed[i], kStateNames[state]);
+      }
+      for (int i = 0; i < TELEMETRY_DC_COUNT; ++i) {
+        const bool ccw = sample.output_flags & (1 << (TELEMETRY_FLAG_DC_CCW_SHIFT + i));
+        const bool en = sample.output_flags & (1 << (TELEMETRY_FLAG_DC_EN_SHIFT + i));
+        fprintf(out, ",%u,%s,%d,%u", sample.dc_duty[i], ccw ? "CCW" : "CW", en ? 1 : 0, sample.dc_current_ma[i]);
+      }
+      fprintf(out, ",%d,%d\n", (sample.output_flags & TELEMETRY_FLAG_RELAY) ? 1 : 0,
+              (sample.output_flags & TELEMETRY_FLAG_PAUSED) ? 1 : 0);
+    }
+  }
+
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  fprintf(stderr, "%zu frames decoded, %zu lost in transit, %u dropped on device, %zu bytes skipped\n", frames,
+          lostFrames, deviceDropped, skippedBytes);
+  if (backSteps > 0) {
+    fprintf(stderr, "%zu samples stamped before the one ahead of them\n", backSteps);
+  }
+  return 0;
+}
@@ -0,0 +1,138 @@
+// Drives the DC thermal model (src/dc_thermal.cpp) the way dc_service() does and
+// checks its budget predictions and derating.
+//
+// Usage: thermal_sim [--continuous-ma <mA>] [--full-duty-ma <mA>] [--tau-s <s>]
+//
+// Defaults are the DC_3000_* ratings of defines.h. The model is fed the applied
+// duty every SERVICE_US and stepped every DC_THERMAL_PERIOD_US, and the duty
+// limit it returns is applied to the next passes. Exits non-zero if a check fails.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dc_thermal.h"
+
+namespace {
+
+constexpr uint8_t MAX_DUTY = 255;
+constexpr uint32_t SERVICE_US = 500;    // control loop period
+constexpr uint32_t PERIOD_US = 10000;   // model step
+constexpr float DERATE_START = 0.8f;
+constexpr float BOOT_LOAD = 0.5f;
+
+struct Options {
+  DcThermalConfig config = {3000.0f, 6000.0f, 20.0f, DERATE_START};
+};
+
+Options g_options;
+
+struct Sim {
+  DcThermalModel model;
+  uint8_t limit;
+  uint32_t since_step_us;
+  float peak_load;
+};
+
+void sim_init(Sim &sim) {
+  dc_thermal_init(sim.model, g_options.config, BOOT_LOAD);
+  sim.limit = dc_thermal_duty_limit(sim.model, MAX_DUTY);
+  sim.since_step_us = 0;
+  sim.peak_load = sim.model.load;
+}
+
+// Runs at `duty` (0 = stopped) for ms; returns the ms at which the limit first
+// fell below duty, or UINT32_MAX if it did not.
+uint32_t sim_run(Sim &sim, uint8_t duty, uint32_t ms) {
+  uint32_t derated = UINT32_MAX;
+  for (uint32_t t_us = 0; t_us < ms * 1000; t_us += SERVICE_US) {
+    const uint8_t applied = duty < sim.limit ? duty : sim.limit;
+    dc_thermal_accumulate(sim.model, dc_thermal_heat_from_duty(sim.model, applied, MAX_DUTY), SERVICE_US);
+    sim.since_step_us += SERVICE_US;
+    if (sim.since_step_us >= PERIOD_US) {
+      sim.since_step_us = 0;
+      dc_thermal_step(sim.model);
+      sim.limit = dc_thermal_duty_limit(sim.model, MAX_DUTY);
+      if (sim.model.load > sim.peak_load) {
+        sim.peak_load = sim.model.load;
+      }
+      if (sim.limit < duty && derated == UINT32_MAX) {
+        derated = t_us / 1000;
+      }
+    }
+  }
+  return derated;
+}
+
+bool check(const char *name, bool pass, const char *detail) {
+  printf("%-40s %s %s\n", name, detail, pass ? "ok" : "FAIL");
+  return pass;
+}
+
+bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (strcmp(argv[i], "--continuous-ma") == 0) {
+      g_options.config.continuous_ma = static_cast<float>(atof(argv[++i]));
+    } else if (strcmp(argv[i], "--full-duty-ma") == 0) {
+      g_options.config.full_duty_ma = static_cast<float>(atof(argv[++i]));
+    } else if (strcmp(argv[i], "--tau-s") == 0) {
+      g_options.config.tau_s = static_cast<float>(atof(argv[++i]));
+    } else {
+      return false;
+    }
+  }
+  return g_options.config.continuous_ma > 0.0f && g_options.config.full_duty_ma > g_options.config.continuous_ma &&
+         g_options.config.tau_s > 0.0f;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    fprintf(stderr, "usage: thermal_sim [--continuous-ma <mA>] [--full-duty-ma <mA>] [--tau-s <s>]\n"
+                    "       (full duty current must exceed the continuous rating)\n");
+    return 2;
+  }
+
+  bool ok = true;
+  char detail[96];
+  const uint32_t runMs = static_cast<uint32_t>(g_options.config.tau_s * 10000.0f);
+  const float ratio = g_options.config.continuous_ma / g_options.config.full_duty_ma;
+  const uint8_t continuousDuty = static_cast<uint8_t>(MAX_DUTY * ratio);
+
+  // Full duty from boot: derating starts when the budget said it would.
+  Sim sim;
+  sim_init(sim);
+  const uint32_t budget = dc_thermal_budget_ms(sim.model, MAX_DUTY, MAX_DUTY);
+  const uint32_t derated = sim_run(sim, MAX_DUTY, runMs);
+  const uint32_t error = derated > budget ? derated - budget : budget - derated;
+  snprintf(detail, sizeof(detail), "budget %u ms, derated after %u ms", budget, derated);
+  ok = check("full duty budget matches", error <= 2 * PERIOD_US / 1000, detail) && ok;
+
+  // Held at full duty for ten time constants: derating holds the load at the rating.
+  snprintf(detail, sizeof(detail), "peak load %.3f, duty limit %u (continuous %u)", sim.peak_load, sim.limit,
+           continuousDuty);
+  ok = check("held at full duty stays within rating", sim.peak_load <= 1.001f && sim.limit + 1 >= continuousDuty,
+             detail) && ok;
+
+  // Cooling down restores the budget.
+  sim_run(sim, 0, static_cast<uint32_t>(g_options.config.tau_s * 3000.0f));
+  snprintf(detail, sizeof(detail), "load %.3f, duty limit %u", sim.model.load, sim.limit);
+  ok = check("cools down to full duty", sim.limit == MAX_DUTY, detail) && ok;
+
+  // Task8 boosted: 210 ms at 100 becomes 83 ms at full duty, once per 12 s cycle, for an hour.
+  sim_init(sim);
+  uint32_t cycleDerated = UINT32_MAX;
+  for (uint32_t cycle = 0; cycle < 300 && cycleDerated == UINT32_MAX; ++cycle) {
+    cycleDerated = sim_run(sim, MAX_DUTY, (210 * 100 + MAX_DUTY - 1) / MAX_DUTY);
+    sim_run(sim, 0, 12000);
+  }
+  snprintf(detail, sizeof(detail), "peak load %.3f", sim.peak_load);
+  ok = check("boosted Task8 for an hour never derates", cycleDerated == UINT32_MAX, detail) && ok;
+
+  puts(ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
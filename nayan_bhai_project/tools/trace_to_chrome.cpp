@@ -0,0 +1,209 @@
+// Converts a `trace dump` console capture (see include/trace.h) into Chrome
+// trace event JSON for chrome://tracing or ui.perfetto.dev.
+//
+// Usage: trace_to_chrome <dump.txt | -> [-o out.json]
+//
+// Core-track events appear under the "cores" process with one thread per CPU;
+// actuator-track events appear under "actuators" with one thread per track.
+// Timestamps are the 64-bit esp_timer microseconds recorded with each event,
+// shared by both cores, and are shown relative to the oldest event.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct RawEvent {
+  unsigned core;
+  long long timeUs;
+  char phase;
+  unsigned event;
+  unsigned track;
+  long arg;
+};
+
+struct TimedEvent {
+  long long ts;
+  size_t order;
+  RawEvent raw;
+};
+
+std::string json_escape(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+void write_metadata(FILE *out, bool &first, unsigned pid, long tid, const char *kind, const std::string &name) {
+  fprintf(out, "%s\n  {\"ph\":\"M\",\"pid\":%u,", first ? "" : ",", pid);
+  if (tid >= 0) {
+    fprintf(out, "\"tid\":%ld,", tid);
+  }
+  fprintf(out, "\"name\":\"%s\",\"args\":{\"name\":\"%s\"}}", kind, json_escape(name).c_str());
+  first = false;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *inputPath = nullptr;
+  const char *outputPath = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (inputPath == nullptr) {
+      inputPath = argv[i];
+    }
+  }
+
+  if (inputPath == nullptr) {
+    fprintf(stderr, "usage: %s <dump.txt | -> [-o out.json]\n", argv[0]);
+    return 2;
+  }
+
+  FILE *input = (strcmp(inputPath, "-") == 0) ? stdin : fopen(inputPath, "r");
+  if (input == nullptr) {
+    fprintf(stderr, "cannot open %s\n", inputPath);
+    return 1;
+  }
+
+  bool found = false;
+  std::map<unsigned, std::string> eventNames;
+  std::map<unsigned, std::string> trackNames;
+  std::map<unsigned, unsigned long> lostPerCore;
+  std::map<unsigned, std::vector<RawEvent>> perCore;
+  bool inDump = false;
+
+  // Log lines printed before or after the dump are ignored.
+  char line[256];
+  while (fgets(line, sizeof(line), input) != nullptr) {
+    unsigned id = 0;
+    char name[64];
+    unsigned long events = 0;
+    unsigned long lost = 0;
+    RawEvent raw = {};
+
+    if (strncmp(line, "# trace v1", 10) == 0) {
+      // Cycle-counter stamps wrap every ~18 s and cannot be placed reliably.
+      fprintf(stderr, "v1 dump ignored, capture it again with current firmware\n");
+      inDump = false;
+    } else if (strncmp(line, "# trace v2", 10) == 0) {
+      found = true;
+      eventNames.clear();
+      trackNames.clear();
+      lostPerCore.clear();
+      perCore.clear();
+      inDump = true;
+    } else if (!inDump) {
+      continue;
+    } else if (strncmp(line, "# end", 5) == 0) {
+      inDump = false;
+    } else if (sscanf(line, "# event %u %63s", &id, name) == 2) {
+      eventNames[id] = name;
+    } else if (sscanf(line, "# track %u %63s", &id, name) == 2) {
+      trackNames[id] = name;
+    } else if (sscanf(line, "# core %u events %lu lost %lu", &id, &events, &lost) == 3) {
+      lostPerCore[id] = lost;
+    } else if (sscanf(line, "%u %lld %c %u %u %ld", &raw.core, &raw.timeUs, &raw.phase, &raw.event, &raw.track,
+                      &raw.arg) == 6) {
+      perCore[raw.core].push_back(raw);
+    }
+  }
+  if (input != stdin) {
+    fclose(input);
+  }
+
+  if (!found || perCore.empty()) {
+    fprintf(stderr, "no trace dump found in %s\n", inputPath);
+    return 1;
+  }
+
+  std::vector<TimedEvent> timed;
+  for (const auto &entry : perCore) {
+    const unsigned long lost = lostPerCore[entry.first];
+    if (lost > 0) {
+      fprintf(stderr, "core %u: %lu older events were overwritten\n", entry.first, lost);
+    }
+    for (const RawEvent &raw : entry.second) {
+      timed.push_back(TimedEvent{raw.timeUs, timed.size(), raw});
+    }
+  }
+
+  // Ties keep ring order, so a begin and end in the same microsecond stay paired.
+  std::sort(timed.begin(), timed.end(), [](const TimedEvent &a, const TimedEvent &b) {
+    return (a.ts != b.ts) ? a.ts < b.ts : a.order < b.order;
+  });
+
+  FILE *out = (outputPath == nullptr) ? stdout : fopen(outputPath, "w");
+  if (out == nullptr) {
+    fprintf(stderr, "cannot write %s\n", outputPath);
+    return 1;
+  }
+
+  const unsigned kCorePid = 1;
+  const unsigned kActuatorPid = 2;
+  bool first = true;
+
+  fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  write_metadata(out, first, kCorePid, -1, "process_name", "cores");
+  write_metadata(out, first, kActuatorPid, -1, "process_name", "actuators");
+  for (const auto &entry : perCore) {
+    write_metadata(out, first, kCorePid, entry.first, "thread_name", "core " + std::to_string(entry.first));
+  }
+  for (const auto &entry : trackNames) {
+    if (entry.first != 0) {
+      write_metadata(out, first, kActuatorPid, entry.first, "thread_name", entry.second);
+    }
+  }
+
+  // Spans whose begin fell off the ring would close a slice that never opened.
+  std::map<std::pair<unsigned, unsigned>, int> openSpans;
+  const long long origin = timed.empty() ? 0 : timed.front().ts;
+  size_t written = 0;
+  for (const TimedEvent &event : timed) {
+    const RawEvent &raw = event.raw;
+    const bool onCore = raw.track == 0;
+    const unsigned pid = onCore ? kCorePid : kActuatorPid;
+    const unsigned tid = onCore ? raw.core : raw.track;
+
+    int &open = openSpans[std::make_pair(pid, tid)];
+    if (raw.phase == 'B') {
+      ++open;
+    } else if (raw.phase == 'E') {
+      if (open == 0) {
+        continue;
+      }
+      --open;
+    }
+
+    const auto nameIt = eventNames.find(raw.event);
+    const std::string name = (nameIt != eventNames.end()) ? nameIt->second : "event_" + std::to_string(raw.event);
+    fprintf(out, ",\n  {\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u,", json_escape(name).c_str(),
+            raw.phase, static_cast<double>(event.ts - origin), pid, tid);
+    if (raw.phase == 'i') {
+      fprintf(out, "\"s\":\"t\",");
+    }
+    fprintf(out, "\"args\":{\"arg\":%ld,\"core\":%u}}", raw.arg, raw.core);
+    ++written;
+  }
+  fprintf(out, "\n]}\n");
+
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  fprintf(stderr, "%zu events\n", written);
+  return 0;
+}